@@ -1,11 +1,30 @@
 #pragma once
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <asm/termbits.h>
+#else
+#include <termios.h>
+#endif
+#endif
 #include <memory>
 #include <string>
 #include <cstdint>
+#include <cstring>
 #include <sstream>
 #include <vector>
 #include <functional>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
 
 namespace RX784 {
     enum class Status : uint8_t {
@@ -186,6 +205,8 @@ namespace RX784 {
     };
 #pragma pack(pop)
 
+    // Timing follows cubic-bezier(a1, b1, a2, b2); the trajectory is a cubic Bezier from the
+    // start to the target whose control points (p1x, p1y), (p2x, p2y) are fractions of the move.
     struct LinearPath {
         double a1;
         double b1;
@@ -197,21 +218,274 @@ namespace RX784 {
         double p2y;
     };
 
+    // Closed-loop settings for movePathAbs. The pointer is read back every `interval`
+    // ticks, or never on a schedule when it is 0, and sooner once the error expected
+    // from how far it has gone passes `errorBudget` pixels. What a read finds is worked
+    // into the rest of the path a few pixels per tick.
+    struct PathFeedback {
+        uint32_t interval;
+        uint32_t errorBudget;
+    };
+
+    struct PathFeedbackStats {
+        uint32_t roundTrips;   // getPos calls, counting the one at the start
+        uint32_t corrections;  // reads that found the pointer off the path
+        int32_t maxError;      // largest error found, in pixels along either axis
+        int32_t finalError;    // after the last tick and its fix-up
+    };
+
+    inline int16_t saturateInt16(int32_t value) {
+        return static_cast<int16_t>(std::max<int32_t>(INT16_MIN, std::min<int32_t>(INT16_MAX, value)));
+    }
+
+    class PathSampler {
+    public:
+        PathSampler(int32_t x, int32_t y, uint32_t duration, uint32_t pollingRate, const LinearPath& path)
+            : x(x), y(y), duration(duration), path(path) {
+            uint64_t count = (static_cast<uint64_t>(duration) * pollingRate + 500) / 1000;
+            tickCount = static_cast<uint32_t>(std::max<uint64_t>(1, std::min<uint64_t>(count, UINT32_MAX)));
+        }
+
+        uint32_t ticks() const { return tickCount; }
+
+        std::chrono::nanoseconds elapsed(uint32_t tick) const {
+            return std::chrono::nanoseconds(static_cast<uint64_t>(duration) * 1000000u * tick / tickCount);
+        }
+
+        void at(uint32_t tick, int32_t& posX, int32_t& posY) const {
+            double progress = bezier(path.b1, path.b2, solveTiming(static_cast<double>(tick) / tickCount));
+            posX = static_cast<int32_t>(std::lround(x * bezier(path.p1x, path.p2x, progress)));
+            posY = static_cast<int32_t>(std::lround(y * bezier(path.p1y, path.p2y, progress)));
+        }
+
+    private:
+        int32_t x;
+        int32_t y;
+        uint32_t duration;
+        uint32_t tickCount;
+        LinearPath path;
+
+        static double bezier(double c1, double c2, double t) {
+            double u = 1 - t;
+            return 3 * u * u * t * c1 + 3 * u * t * t * c2 + t * t * t;
+        }
+
+        double solveTiming(double time) const {
+            double lo = 0, hi = 1, t = time;
+            for (int i = 0; i < 32; ++i) {
+                double value = bezier(path.a1, path.a2, t);
+                if (std::fabs(value - time) < 1e-7) break;
+                if (value < time) lo = t; else hi = t;
+                t = (lo + hi) / 2;
+            }
+            return t;
+        }
+    };
+
+    // Time source for everything in the library that runs on a schedule: path pacing,
+    // queue holds and poll alignment, retry intervals, pollers and timers. Waits go
+    // through the clock, and so do the notifications that end them, so a VirtualClock
+    // (rx784_clock.hpp) knows which of its threads are busy.
+    //
+    // Serial timeouts and spin budgets stay on the steady clock, since they bound real
+    // kernel waits, as do the simulated board and the ImpairedTransport, which stand in
+    // for hardware.
+    class Clock {
+    public:
+        using duration = std::chrono::steady_clock::duration;
+        using time_point = std::chrono::steady_clock::time_point;
+
+        virtual ~Clock() {}
+
+        virtual time_point now() = 0;
+        virtual void sleepUntil(time_point deadline) = 0;
+        virtual void notifyOne(std::condition_variable& condition) = 0;
+        virtual void notifyAll(std::condition_variable& condition) = 0;
+
+        // False where busy-waiting for the clock to move would never end.
+        virtual bool isRealTime() const = 0;
+
+        // A thread that will wait on the clock; see VirtualClock.
+        virtual void attach() {}
+        virtual void detach() {}
+
+        void sleepFor(duration length) { sleepUntil(now() + length); }
+
+        void spinUntil(time_point deadline) {
+            if (!isRealTime()) return sleepUntil(deadline);
+            while (now() < deadline) {}
+        }
+
+        // condition.wait_until, for a condition that is notified through this clock.
+        // time_point::max() waits for as long as it takes. Returns isReady().
+        template <typename Predicate>
+        bool waitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& condition, time_point deadline,
+                       Predicate isReady) {
+            return block(lock, condition, deadline, [](const void* context) {
+                return (*static_cast<const Predicate*>(context))();
+            }, &isReady);
+        }
+
+        template <typename Predicate>
+        void wait(std::unique_lock<std::mutex>& lock, std::condition_variable& condition, Predicate isReady) {
+            waitUntil(lock, condition, time_point::max(), isReady);
+        }
+
+    protected:
+        virtual bool block(std::unique_lock<std::mutex>& lock, std::condition_variable& condition, time_point deadline,
+                           bool (*isReady)(const void* context), const void* context) = 0;
+    };
+
+    class SteadyClock : public Clock {
+    public:
+        time_point now() override { return std::chrono::steady_clock::now(); }
+        void sleepUntil(time_point deadline) override { std::this_thread::sleep_until(deadline); }
+        void notifyOne(std::condition_variable& condition) override { condition.notify_one(); }
+        void notifyAll(std::condition_variable& condition) override { condition.notify_all(); }
+        bool isRealTime() const override { return true; }
+
+    protected:
+        bool block(std::unique_lock<std::mutex>& lock, std::condition_variable& condition, time_point deadline,
+                   bool (*isReady)(const void* context), const void* context) override {
+            auto predicate = [&] { return isReady(context); };
+            if (deadline == time_point::max()) {
+                condition.wait(lock, predicate);
+                return true;
+            }
+            return condition.wait_until(lock, deadline, predicate);
+        }
+    };
+
+    // What every class uses unless given another clock.
+    inline Clock& steadyClock() {
+        static SteadyClock clock;
+        return clock;
+    }
+
+    // Where movePathRel looks for a path already expanded into per-tick moves, set with
+    // Device::setPathCache. PathCache (rx784_cache.hpp) keeps recent ones.
+    class PathSource {
+    public:
+        struct Delta {
+            int16_t x;
+            int16_t y;
+        };
+
+        using Deltas = std::vector<Delta>;
+
+        virtual ~PathSource() {}
+
+        // The moves of each tick of the path, or nullptr to have the caller sample it.
+        virtual std::shared_ptr<const Deltas> lookup(int16_t x, int16_t y, uint32_t duration, uint32_t pollingRate,
+                                                     const LinearPath& path) = 0;
+    };
+
+    // Sees every frame a Device sends or receives, once set with Device::setTracer.
+    // Tracer (rx784_trace.hpp) records them to a file.
+    class TraceSink {
+    public:
+        enum class Direction : uint8_t { kSend, kRecv };
+
+        // How much of a received frame a Device keeps for record(); frameSize is still
+        // the whole of it.
+        static constexpr size_t maxCaptureSize() { return 48; }
+
+        virtual ~TraceSink() {}
+
+        virtual void record(Direction direction, uint8_t channel, uint8_t cmd, const void* frame, size_t frameSize,
+                            bool isFailed) = 0;
+    };
+
+#ifndef _WIN32
+    // Opens `port` raw 8N1 at `baudRate` with non-blocking reads (VMIN = VTIME = 0).
+    // 250000 is not one of the Bxxx constants, so Linux goes through termios2.
+    inline int openSerialPort(const char* port, uint32_t baudRate) {
+        int fd = ::open(port, O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if (fd < 0) return -1;
+
+#ifdef __linux__
+        struct termios2 tio{};
+        if (ioctl(fd, TCGETS2, &tio) != 0) goto Error;
+        tio.c_cflag &= ~(CBAUD | CSIZE | PARENB | CSTOPB | CRTSCTS);
+        tio.c_cflag |= BOTHER | CS8 | CLOCAL | CREAD;
+        tio.c_ispeed = tio.c_ospeed = baudRate;
+#else
+        struct termios tio{};
+        if (tcgetattr(fd, &tio) != 0) goto Error;
+        tio.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CRTSCTS);
+        tio.c_cflag |= CS8 | CLOCAL | CREAD;
+        cfsetspeed(&tio, baudRate);
+#endif
+        tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF);
+        tio.c_oflag &= ~OPOST;
+        tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+        tio.c_cc[VMIN]  = 0;
+        tio.c_cc[VTIME] = 0;
+#ifdef __linux__
+        if (ioctl(fd, TCSETS2, &tio) != 0) goto Error;
+#else
+        if (tcsetattr(fd, TCSANOW, &tio) != 0) goto Error;
+#endif
+        return fd;
+    Error:
+        ::close(fd);
+        return -1;
+    }
+#endif
+
+    // Byte pipe underneath a Device. By default a Device talks to its own serial port;
+    // open(Transport&) runs the same methods over anything else that carries the frames.
+    class Transport {
+    public:
+        virtual ~Transport() {}
+
+        virtual bool send(const void* buffer, size_t size) = 0;
+        // Returns how many bytes arrived before timing out, like a serial read.
+        virtual size_t recv(void* buffer, size_t size) = 0;
+        virtual bool close() { return true; }
+    };
+
     class Device {
     public:
         static constexpr size_t maxManufacturerStringSize() { return 30; }
         static constexpr size_t maxProductStringSize()      { return 30; }
 
-        Device() : hSerial(INVALID_HANDLE_VALUE) {}
+        Device() : hSerial(invalidSerial()), transport(nullptr), pathCache(nullptr), clock(&steadyClock()), tracer(nullptr),
+                   traceChannel(0), traceSize(0), spinBudget(0) {}
 
         Status open(const std::string& port) {
             return serialOpen(port.c_str(), 250000) ? Status::kSuccess : Status::kSerialError;
         }
 
+        // Talks through `transport` instead of a local serial port until close().
+        // The transport is owned by the caller and must outlive the Device's use of it.
+        Status open(Transport& transport) {
+            this->transport = &transport;
+            return Status::kSuccess;
+        }
+
         Status close() {
+            if (transport) {
+                bool ok = transport->close();
+                transport = nullptr;
+                return ok ? Status::kSuccess : Status::kSerialError;
+            }
             return serialClose() ? Status::kSuccess : Status::kSerialError;
         }
 
+        // Reads on the device's own serial port first poll the port without blocking for up
+        // to `budget`, and only then sleep until data arrives. Trades a core for not waiting
+        // on a scheduler wakeup per response; zero (the default) always blocks.
+        void setSpinBudget(std::chrono::nanoseconds budget) {
+            spinBudget = budget;
+        }
+
+        // Records every frame sent and received under `channel`; nullptr stops tracing.
+        void setTracer(TraceSink* tracer, uint8_t channel = 0) {
+            this->tracer = tracer;
+            traceChannel = channel;
+        }
+
         Status reboot() {
             Status status, cmdStatus{};
             status = sendPacket(Command::kReboot);
@@ -419,6 +693,13 @@ namespace RX784 {
             return movePathRel(x, y, duration, 250, false, path, callback);
         }
 
+        // Lets movePathRel replay expanded paths from `cache`; nullptr turns caching off.
+        void setPathCache(PathSource* cache) { pathCache = cache; }
+
+        // Paces the movePath* calls by `clock`, which must outlive the Device's use of it.
+        void setClock(Clock& clock) { this->clock = &clock; }
+        Clock& getClock() const { return *clock; }
+
         Status scrollRel(int16_t w) {
             Status status, cmdStatus{};
 
@@ -510,6 +791,12 @@ namespace RX784 {
             return movePathAbs(x, y, duration, 250, false, path, callback);
         }
 
+        // Closed loop: see PathFeedback. A target the board cannot reach, such as one
+        // beyond the screen, shows up as finalError rather than as a failure.
+        Status movePathAbs(int16_t x, int16_t y, uint32_t duration, uint32_t pollingRate, bool isIgnoreErrors,
+                           const LinearPath& path, const PathFeedback& feedback, PathFeedbackStats& stats,
+                           std::function<void()> callback = []{});
+
         Status scrollAbs(int16_t w) {
             Status status, cmdStatus{};
 
@@ -667,12 +954,14 @@ namespace RX784 {
 
         Status configHIDManufacturerString(const std::string& manufacturerString) {
             Status status, cmdStatus{};
-            std::wstring data = strToWstr(manufacturerString);
-            if (data.size() * sizeof(wchar_t) > UINT8_MAX) return Status::kInvalidSize;
+            uint8_t packet[4 + maxManufacturerStringSize() * sizeof(char16_t)];
+            size_t dataSize = 0;
 
-            status = sendPacket(Command::kConfigManufacturerString,
-                                data.c_str(),
-                                static_cast<uint8_t>(data.size() * sizeof(wchar_t)));
+            if (!utf8ToUtf16LE(manufacturerString.data(), manufacturerString.size(),
+                               &packet[3], maxManufacturerStringSize() * sizeof(char16_t), dataSize))
+                return Status::kInvalidSize;
+
+            status = sendPacketInPlace(Command::kConfigManufacturerString, packet, static_cast<uint8_t>(dataSize));
             if (status != Status::kSuccess) return status;
 
             status = recvPacket(Command::kConfigManufacturerString, &cmdStatus, sizeof(cmdStatus));
@@ -683,12 +972,14 @@ namespace RX784 {
 
         Status configHIDProductString(const std::string& productString) {
             Status status, cmdStatus{};
-            std::wstring data = strToWstr(productString);
-            if (data.size() * sizeof(wchar_t) > UINT8_MAX) return Status::kInvalidSize;
+            uint8_t packet[4 + maxProductStringSize() * sizeof(char16_t)];
+            size_t dataSize = 0;
+
+            if (!utf8ToUtf16LE(productString.data(), productString.size(),
+                               &packet[3], maxProductStringSize() * sizeof(char16_t), dataSize))
+                return Status::kInvalidSize;
 
-            status = sendPacket(Command::kConfigProductString,
-                                data.c_str(),
-                                static_cast<uint8_t>(data.size() * sizeof(wchar_t)));
+            status = sendPacketInPlace(Command::kConfigProductString, packet, static_cast<uint8_t>(dataSize));
             if (status != Status::kSuccess) return status;
 
             status = recvPacket(Command::kConfigProductString, &cmdStatus, sizeof(cmdStatus));
@@ -763,9 +1054,11 @@ namespace RX784 {
         Status getHIDManufacturerString(std::string& manufacturerString) {
             Status status;
             uint8_t dataSize;
+            char str[maxManufacturerStringSize() * 3];
+            size_t strSize = 0;
 
 #pragma pack(push, 1)
-            struct { Status status; wchar_t manufacturerString[maxManufacturerStringSize()+1]; } data{};
+            struct { Status status; uint8_t manufacturerString[(maxManufacturerStringSize() + 1) * sizeof(char16_t)]; } data{};
 #pragma pack(pop)
 
             status = sendPacket(Command::kGetManufacturerString);
@@ -777,16 +1070,21 @@ namespace RX784 {
             if (dataSize == 1) return data.status;
             if (data.status != Status::kSuccess) return Status::kInvalidResponsePacket;
 
-            manufacturerString = wstrToStr(data.manufacturerString);
+            if (!utf16LEToUtf8(data.manufacturerString, dataSize - 1u, str, sizeof(str), strSize))
+                return Status::kInvalidResponsePacket;
+
+            manufacturerString.assign(str, strSize);
             return Status::kSuccess;
         }
 
         Status getHIDProductString(std::string& productString) {
             Status status;
             uint8_t dataSize;
+            char str[maxProductStringSize() * 3];
+            size_t strSize = 0;
 
 #pragma pack(push, 1)
-            struct { Status status; wchar_t productString[maxProductStringSize() + 1]; } data{};
+            struct { Status status; uint8_t productString[(maxProductStringSize() + 1) * sizeof(char16_t)]; } data{};
 #pragma pack(pop)
 
             status = sendPacket(Command::kGetProductString);
@@ -798,7 +1096,10 @@ namespace RX784 {
             if (dataSize == 1) return data.status;
             if (data.status != Status::kSuccess) return Status::kInvalidResponsePacket;
 
-            productString = wstrToStr(data.productString);
+            if (!utf16LEToUtf8(data.productString, dataSize - 1u, str, sizeof(str), strSize))
+                return Status::kInvalidResponsePacket;
+
+            productString.assign(str, strSize);
             return Status::kSuccess;
         }
 
@@ -830,7 +1131,21 @@ namespace RX784 {
             return Status::kSuccess;
         }
 
+        struct Request;
+
+        Status sendRequest(const Request& request);
+        // Sends a frame built by Request::encode, e.g. one encoded once for many devices,
+        // or several such frames back to back in one write.
+        Status sendFrame(const uint8_t* frame, size_t frameSize);
+        Status recvResponse(Request& request);
+        Status transact(Request& request);
+
     private:
+        friend class CommandQueue;
+        friend class CommandFuser;
+        friend class SupervisedTransport;
+        friend class ImpairedTransport;
+
         enum class Command : uint8_t {
             kAny = 0,
             kReboot = 1,
@@ -946,9 +1261,26 @@ namespace RX784 {
             kOSRight
         };
 
-        HANDLE hSerial;
-
-        bool serialOpen(LPCSTR port, DWORD baudRate) {
+#ifdef _WIN32
+        using SerialHandle = HANDLE;
+        static SerialHandle invalidSerial() { return INVALID_HANDLE_VALUE; }
+#else
+        using SerialHandle = int;
+        static SerialHandle invalidSerial() { return -1; }
+#endif
+
+        SerialHandle hSerial;
+        Transport* transport;
+        PathSource* pathCache;
+        Clock* clock;
+        TraceSink* tracer;
+        uint8_t traceChannel;
+        size_t traceSize;
+        uint8_t traceFrame[TraceSink::maxCaptureSize()];
+        std::chrono::nanoseconds spinBudget;
+
+#ifdef _WIN32
+        bool serialOpen(const char* port, uint32_t baudRate) {
             DCB dcb{};
             COMMTIMEOUTS timeouts{};
 
@@ -990,27 +1322,113 @@ namespace RX784 {
             return ok;
         }
 
-        bool serialSend(LPCVOID buffer, DWORD bufferSize) {
+        bool serialWrite(const void* buffer, size_t bufferSize) {
             DWORD writeSize;
-            return WriteFile(hSerial, buffer, bufferSize, &writeSize, NULL) && writeSize == bufferSize;
+            return WriteFile(hSerial, buffer, static_cast<DWORD>(bufferSize), &writeSize, NULL) && writeSize == bufferSize;
+        }
+
+        size_t serialRead(void* buffer, size_t bufferSize) {
+            if (spinBudget.count() > 0) {
+                std::chrono::steady_clock::time_point spinEnd = std::chrono::steady_clock::now() + spinBudget;
+                COMSTAT comStat{};
+                DWORD errors;
+                while (ClearCommError(hSerial, &errors, &comStat) && comStat.cbInQue < bufferSize &&
+                       std::chrono::steady_clock::now() < spinEnd) {}
+            }
+
+            DWORD readSize = 0;
+            ReadFile(hSerial, buffer, static_cast<DWORD>(bufferSize), &readSize, NULL);
+            return readSize;
+        }
+#else
+        bool serialOpen(const char* port, uint32_t baudRate) {
+            hSerial = openSerialPort(port, baudRate);
+            return hSerial >= 0;
         }
 
-        bool serialRecv(LPVOID buffer, DWORD bufferSize) {
-            DWORD readSize;
-            return ReadFile(hSerial, buffer, bufferSize, &readSize, NULL) && readSize == bufferSize;
+        bool serialClose() {
+            bool ok = ::close(hSerial) == 0;
+            if (ok) hSerial = -1;
+            return ok;
+        }
+
+        bool serialWrite(const void* buffer, size_t bufferSize) {
+            const uint8_t* bytes = static_cast<const uint8_t*>(buffer);
+            while (bufferSize != 0) {
+                ssize_t writeSize = ::write(hSerial, bytes, bufferSize);
+                if (writeSize <= 0) return false;
+                bytes += writeSize;
+                bufferSize -= static_cast<size_t>(writeSize);
+            }
+            return true;
+        }
+
+        // Same timeouts as the Windows COMMTIMEOUTS: 50 ms between bytes, 50 ms + 10 ms/byte in total.
+        size_t serialRead(void* buffer, size_t bufferSize) {
+            using Clock = std::chrono::steady_clock;
+            Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(50 + 10 * bufferSize);
+            size_t readSize = 0;
+
+            // With VMIN = 0 and VTIME = 0 a read returns at once, so this is a plain busy poll.
+            if (spinBudget.count() > 0) {
+                Clock::time_point spinEnd = Clock::now() + spinBudget;
+                do {
+                    ssize_t n = ::read(hSerial, static_cast<uint8_t*>(buffer) + readSize, bufferSize - readSize);
+                    if (n < 0) break;
+                    readSize += static_cast<size_t>(n);
+                } while (readSize < bufferSize && Clock::now() < spinEnd);
+            }
+
+            while (readSize < bufferSize) {
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+                pollfd pfd = { hSerial, POLLIN, 0 };
+                if (remaining <= 0 || poll(&pfd, 1, static_cast<int>(std::min<long long>(remaining, 50))) <= 0) break;
+
+                ssize_t n = ::read(hSerial, static_cast<uint8_t*>(buffer) + readSize, bufferSize - readSize);
+                if (n <= 0) break;
+                readSize += static_cast<size_t>(n);
+            }
+            return readSize;
+        }
+#endif
+
+        bool serialSend(const void* buffer, size_t bufferSize) {
+            return transport ? transport->send(buffer, bufferSize) : serialWrite(buffer, bufferSize);
+        }
+
+        // Returns how many bytes arrived before timing out.
+        size_t serialRecvSome(void* buffer, size_t bufferSize) {
+            return transport ? transport->recv(buffer, bufferSize) : serialRead(buffer, bufferSize);
+        }
+
+        bool serialRecv(void* buffer, size_t bufferSize) {
+            size_t readSize = serialRecvSome(buffer, bufferSize);
+
+            if (tracer) {
+                if (traceSize < sizeof(traceFrame)) {
+                    memcpy(&traceFrame[traceSize], buffer, std::min<size_t>(readSize, sizeof(traceFrame) - traceSize));
+                }
+                traceSize += readSize;
+            }
+            return readSize == bufferSize;
+        }
+
+        Status sendPacket(Command cmd, const void* data = nullptr, uint8_t dataSize = 0) {
+            uint8_t packet[4 + UINT8_MAX];
+
+            if (dataSize != 0) memcpy(&packet[3], data, dataSize);
+            return sendPacketInPlace(cmd, packet, dataSize);
         }
 
-        Status sendPacket(Command cmd, LPCVOID data = NULL, uint8_t dataSize = 0) {
-            DWORD packetSize = 4u + dataSize;  // 0xBE cmd size [data] 0xED
-            std::unique_ptr<uint8_t[]> packet(new uint8_t[packetSize]);
+        // `packet` holds 4 + dataSize bytes with the data already at packet[3].
+        Status sendPacketInPlace(Command cmd, uint8_t* packet, uint8_t dataSize) {
+            size_t packetSize = 4u + dataSize;  // 0xBE cmd size [data] 0xED
 
             packet[0] = 0xBE;
             packet[1] = static_cast<uint8_t>(cmd);
             packet[2] = dataSize;
-            memcpy(&packet[3], data, dataSize);
-            packet[static_cast<size_t>(packetSize) - 1] = 0xED;
-
-            return serialSend(packet.get(), packetSize) ? Status::kSuccess : Status::kSerialError;
+            packet[packetSize - 1] = 0xED;
+            return sendFrame(packet, packetSize);
         }
 
         Status recvPacketHead() {
@@ -1023,7 +1441,17 @@ namespace RX784 {
             return Status::kInvalidResponsePacket;
         }
 
-        Status recvPacket(Command cmd, LPVOID buffer, size_t bufferSize, uint8_t* dataSize = NULL) {
+        Status recvPacket(Command cmd, void* buffer, size_t bufferSize, uint8_t* dataSize = nullptr) {
+            if (!tracer) return readPacket(cmd, buffer, bufferSize, dataSize);
+
+            traceSize = 0;
+            Status status = readPacket(cmd, buffer, bufferSize, dataSize);
+            tracer->record(TraceSink::Direction::kRecv, traceChannel, static_cast<uint8_t>(cmd),
+                           traceFrame, traceSize, status != Status::kSuccess);
+            return status;
+        }
+
+        Status readPacket(Command cmd, void* buffer, size_t bufferSize, uint8_t* dataSize) {
             uint8_t packetDataSize = 0, packetTail = 0;
             Command packetCmd{};
             Status status;
@@ -1048,7 +1476,7 @@ namespace RX784 {
             return Status::kSuccess;
         }
 
-        VirtualKeyCode HIDKeyCodeToVirtualKeyCode(HIDKeyCode code) {
+        static VirtualKeyCode HIDKeyCodeToVirtualKeyCode(HIDKeyCode code) {
             switch (code)
             {
             case HIDKeyCode::kKeyA:           return VirtualKeyCode::kKeyA;
@@ -1160,7 +1588,7 @@ namespace RX784 {
             }
         }
 
-        HIDKeyCode virtualKeyCodeToHIDKeyCode(VirtualKeyCode code) {
+        static HIDKeyCode virtualKeyCodeToHIDKeyCode(VirtualKeyCode code) {
             switch (code)
             {
             case VirtualKeyCode::kBackspace:      return HIDKeyCode::kBackspace;
@@ -1275,21 +1703,510 @@ namespace RX784 {
             }
         }
 
-        std::wstring strToWstr(const std::string& str) {
-            int size = MultiByteToWideChar(CP_ACP, 0, str.c_str(), -1, NULL, 0);
-            std::unique_ptr<wchar_t[]> wstr(new wchar_t[static_cast<size_t>(size)]);
-            MultiByteToWideChar(CP_ACP, 0, str.c_str(), -1, wstr.get(), size);
-            return std::wstring(wstr.get());
+        // The HID string descriptors travel as UTF-16LE regardless of the host's wchar_t.
+        // Malformed input is replaced with U+FFFD; false means `dst` is too small.
+        static constexpr bool utf8ToUtf16LE(const char* src, size_t srcSize,
+                                            uint8_t* dst, size_t dstSize, size_t& written) {
+            written = 0;
+            for (size_t i = 0; i < srcSize;) {
+                uint8_t lead = static_cast<uint8_t>(src[i]);
+                uint32_t codePoint = 0xFFFD;
+                size_t length = lead < 0x80 ? 1 : lead < 0xC2 ? 0 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : lead < 0xF5 ? 4 : 0;
+                uint8_t lower = lead == 0xE0 ? 0xA0 : lead == 0xF0 ? 0x90 : 0x80;
+                uint8_t upper = lead == 0xED ? 0x9F : lead == 0xF4 ? 0x8F : 0xBF;
+
+                size_t consumed = 1;
+                if (length == 1) {
+                    codePoint = lead;
+                } else if (length != 0) {
+                    uint32_t value = lead & (0x7Fu >> length);
+                    for (; consumed < length && i + consumed < srcSize; ++consumed) {
+                        uint8_t trail = static_cast<uint8_t>(src[i + consumed]);
+                        if (trail < (consumed == 1 ? lower : 0x80) || trail > (consumed == 1 ? upper : 0xBF)) break;
+                        value = (value << 6) | (trail & 0x3Fu);
+                    }
+                    if (consumed == length) codePoint = value;
+                }
+                i += consumed;
+
+                if (codePoint < 0x10000) {
+                    if (dstSize - written < 2) return false;
+                    dst[written++] = static_cast<uint8_t>(codePoint);
+                    dst[written++] = static_cast<uint8_t>(codePoint >> 8);
+                } else {
+                    uint32_t high = 0xD800 + ((codePoint - 0x10000) >> 10);
+                    uint32_t low  = 0xDC00 + (codePoint & 0x3FF);
+                    if (dstSize - written < 4) return false;
+                    dst[written++] = static_cast<uint8_t>(high);
+                    dst[written++] = static_cast<uint8_t>(high >> 8);
+                    dst[written++] = static_cast<uint8_t>(low);
+                    dst[written++] = static_cast<uint8_t>(low >> 8);
+                }
+            }
+            return true;
         }
 
-        std::string wstrToStr(const std::wstring& wstr) {
-            int size = WideCharToMultiByte(CP_ACP, 0, wstr.c_str(), -1, NULL, 0, NULL, NULL);
-            std::unique_ptr<char[]> str(new char[static_cast<size_t>(size)]);
-            WideCharToMultiByte(CP_ACP, 0, wstr.c_str(), -1, str.get(), size, NULL, NULL);
-            return std::string(str.get());
+        // Decodes up to the first NUL code unit; unpaired surrogates become U+FFFD.
+        static constexpr bool utf16LEToUtf8(const uint8_t* src, size_t srcSize,
+                                            char* dst, size_t dstSize, size_t& written) {
+            written = 0;
+            for (size_t i = 0; i + 1 < srcSize;) {
+                uint32_t codePoint = src[i] | (src[i + 1] << 8);
+                i += 2;
+                if (codePoint == 0) break;
+
+                if (codePoint >= 0xD800 && codePoint < 0xDC00 && i + 1 < srcSize) {
+                    uint32_t low = src[i] | (src[i + 1] << 8);
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                        i += 2;
+                    }
+                }
+                if (codePoint >= 0xD800 && codePoint < 0xE000) codePoint = 0xFFFD;
+
+                size_t length = codePoint < 0x80 ? 1 : codePoint < 0x800 ? 2 : codePoint < 0x10000 ? 3 : 4;
+                if (dstSize - written < length) return false;
+                if (length == 1) {
+                    dst[written++] = static_cast<char>(codePoint);
+                    continue;
+                }
+                dst[written++] = static_cast<char>((0xF00u >> length) | (codePoint >> (6 * (length - 1))));
+                for (size_t shift = 6 * (length - 1); shift != 0; shift -= 6) {
+                    dst[written++] = static_cast<char>(0x80 | ((codePoint >> (shift - 6)) & 0x3F));
+                }
+            }
+            return true;
         }
     };
 
+    // One command/response exchange, for callers that queue or pipeline commands
+    // instead of going through the blocking Device methods.
+    struct Device::Request {
+        Command cmd;
+        uint8_t dataSize;
+        uint8_t responseSize;
+        bool    isVariableResponse;
+        uint8_t data[64];
+        uint8_t response[64];
+
+        Status result() const { return static_cast<Status>(response[0]); }
+
+        KeyboardState keyboardState() const {
+            KeyboardState keyboardState{};
+            memcpy(&keyboardState.modifierKeys, &response[0], sizeof(keyboardState.modifierKeys));
+            for (size_t i = 0; i < sizeof(keyboardState.regularKeys); ++i) {
+                keyboardState.regularKeys[i] = HIDKeyCodeToVirtualKeyCode(static_cast<HIDKeyCode>(response[1 + i]));
+            }
+            return keyboardState;
+        }
+
+        ButtonsState buttonsState() const {
+            ButtonsState buttonsState{};
+            memcpy(&buttonsState, response, sizeof(buttonsState));
+            return buttonsState;
+        }
+
+        KeyboardLEDsState keyboardLEDsState() const {
+            KeyboardLEDsState keyboardLEDsState{};
+            memcpy(&keyboardLEDsState, response, sizeof(keyboardLEDsState));
+            return keyboardLEDsState;
+        }
+
+        static Request reboot()                           { return make(Command::kReboot); }
+
+        static Request keyDown(VirtualKeyCode key)        { return make(Command::kKeyDown, hidKeyCode(key)); }
+        static Request keyUp(VirtualKeyCode key)          { return make(Command::kKeyUp, hidKeyCode(key)); }
+        static Request releaseAllKeys()                   { return make(Command::kReleaseAllKeys); }
+        static Request getKeyState(VirtualKeyCode key)    { return make(Command::kGetKeyState, hidKeyCode(key)); }
+        static Request getKeyboardLEDsState()             { return query(Command::kGetKeyboardLEDsState, sizeof(KeyboardLEDsState)); }
+        static Request getKeyboardState()                 { return query(Command::kGetKeyboardState, 1 + sizeof(KeyboardState::regularKeys)); }
+
+        static Request sendKeyboardState(const KeyboardState& keyboardState, const KeyboardStateMask& keyboardStateMask) {
+            uint8_t regularKeysMask = 0;
+            for (size_t i = 0; i < sizeof(keyboardStateMask.regularKeys); ++i) {
+                regularKeysMask |= keyboardStateMask.regularKeys[i] << i;
+            }
+
+#pragma pack(push, 1)
+            struct {
+                KeyboardStateMask::ModifierKeys modifierKeysMask;
+                uint8_t regularKeysMask;
+                KeyboardState::ModifierKeys modifierKeys;
+                HIDKeyCode regularKeys[sizeof(keyboardState.regularKeys)];
+            } state = { keyboardStateMask.modifierKeys,
+                        regularKeysMask,
+                        keyboardState.modifierKeys,
+                        {} };
+#pragma pack(pop)
+
+            for (size_t i = 0; i < sizeof(state.regularKeys); ++i) {
+                state.regularKeys[i] = virtualKeyCodeToHIDKeyCode(keyboardState.regularKeys[i]);
+            }
+            return make(Command::kSendKeyboardState, state);
+        }
+
+        static Request buttonDown(Button button)          { return make(Command::kButtonDown, button); }
+        static Request buttonUp(Button button)            { return make(Command::kButtonUp, button); }
+        static Request releaseAllButtons()                { return make(Command::kReleaseAllButtons); }
+        static Request getButtonsState()                  { return query(Command::kGetButtonsState, sizeof(ButtonsState)); }
+
+        static Request moveRel(int16_t x, int16_t y)      { return make(Command::kMoveRel, pair(x, y)); }
+        static Request scrollRel(int16_t w)               { return make(Command::kScrollRel, w); }
+
+        static Request sendRelMouseState(const MouseState& mouseState, MouseStateMask mouseStateMask) {
+#pragma pack(push, 1)
+            struct { MouseStateMask mask; MouseState mouseState; } state = { mouseStateMask, mouseState };
+#pragma pack(pop)
+            return make(Command::kSendRelMouseState, state);
+        }
+
+        static Request moveAbs(int16_t x, int16_t y)      { return make(Command::kMoveAbs, pair(x, y)); }
+        static Request scrollAbs(int16_t w)               { return make(Command::kScrollAbs, w); }
+        static Request getPos()                           { return query(Command::kGetPos, 4); }
+        static Request setPos(int16_t x, int16_t y)       { return make(Command::kSetPos, pair(x, y)); }
+        static Request getAxes()                          { return query(Command::kGetAxes, 6); }
+        static Request setAxes(int16_t x, int16_t y, int16_t w) { return make(Command::kSetAxes, MouseState::Axes{ x, y, w }); }
+
+        static Request sendAbsMouseState(const MouseState& mouseState, MouseStateMask mouseStateMask) {
+#pragma pack(push, 1)
+            struct { MouseStateMask mask; MouseState mouseState; } state = { mouseStateMask, mouseState };
+#pragma pack(pop)
+            return make(Command::kSendAbsMouseState, state);
+        }
+
+        static Request configHIDVendorID(uint16_t vendorID)           { return make(Command::kConfigVendorID, vendorID); }
+        static Request configHIDProductID(uint16_t productID)         { return make(Command::kConfigProductID, productID); }
+        static Request configHIDVersionNumber(uint16_t versionNumber) { return make(Command::kConfigVersionNumber, versionNumber); }
+
+        // False if the string does not fit.
+        static bool configHIDManufacturerString(const std::string& manufacturerString, Request& request) {
+            return configHIDManufacturerString(manufacturerString.data(), manufacturerString.size(), request);
+        }
+
+        static bool configHIDManufacturerString(const char* str, size_t strSize, Request& request) {
+            return configString(Command::kConfigManufacturerString, str, strSize, maxManufacturerStringSize(), request);
+        }
+
+        static bool configHIDProductString(const std::string& productString, Request& request) {
+            return configHIDProductString(productString.data(), productString.size(), request);
+        }
+
+        static bool configHIDProductString(const char* str, size_t strSize, Request& request) {
+            return configString(Command::kConfigProductString, str, strSize, maxProductStringSize(), request);
+        }
+
+        // Answered by a status byte alone on failure; decode with hidNumber() or hidString().
+        static Request getHIDVendorID()           { return reply(Command::kGetVendorID); }
+        static Request getHIDProductID()          { return reply(Command::kGetProductID); }
+        static Request getHIDVersionNumber()      { return reply(Command::kGetVersionNumber); }
+        static Request getHIDManufacturerString() { return reply(Command::kGetManufacturerString); }
+        static Request getHIDProductString()      { return reply(Command::kGetProductString); }
+
+        static Request getDeviceSerialNumber()    { return query(Command::kGetDeviceSerialNumber, 20); }
+
+        Status hidNumber(uint16_t& value) const {
+            if (responseSize == 1 && result() != Status::kSuccess) return result();
+            if (responseSize != 3 || result() != Status::kSuccess) return Status::kInvalidResponsePacket;
+            memcpy(&value, &response[1], sizeof(value));
+            return Status::kSuccess;
+        }
+
+        Status hidString(std::string& value) const {
+            char str[maxHIDStringSize()];
+            size_t strSize = 0;
+            Status status = hidString(str, sizeof(str), strSize);
+            if (status == Status::kSuccess) value.assign(str, strSize);
+            return status;
+        }
+
+        // Decodes into `str` without allocating; kInvalidSize if it does not fit.
+        Status hidString(char* str, size_t strCapacity, size_t& strSize) const {
+            if (responseSize == 1) return result();
+            if (responseSize == 0 || result() != Status::kSuccess) return Status::kInvalidResponsePacket;
+            if (!utf16LEToUtf8(&response[1], responseSize - 1u, str, strCapacity, strSize)) return Status::kInvalidSize;
+            return Status::kSuccess;
+        }
+
+        // UTF-8 bytes the longest string response can decode to.
+        static constexpr size_t maxHIDStringSize() { return sizeof(response) / 2 * 3; }
+
+        static constexpr size_t maxFrameSize() { return 4 + sizeof(data); }
+        // Most frames a single sendFrame carries back to back; CommandQueue coalesces no more.
+        static constexpr size_t maxBatchFrames() { return 16; }
+
+        // Writes the request's wire frame, at most maxFrameSize() bytes, and returns its size.
+        size_t encode(uint8_t* frame) const {
+            frame[0] = 0xBE;
+            frame[1] = static_cast<uint8_t>(cmd);
+            frame[2] = dataSize;
+            memcpy(&frame[3], data, dataSize);
+            frame[3 + dataSize] = 0xED;
+            return 4u + dataSize;
+        }
+
+        // Any frame as it is on the wire, with whatever response comes back. Used to relay
+        // frames for another Device; false if `dataSize` does not fit.
+        static bool relay(uint8_t cmd, const void* data, size_t dataSize, Request& request) {
+            if (dataSize > sizeof(request.data)) return false;
+            request = Request{};
+            request.cmd = static_cast<Command>(cmd);
+            request.dataSize = static_cast<uint8_t>(dataSize);
+            request.isVariableResponse = true;
+            if (dataSize != 0) memcpy(request.data, data, dataSize);
+            return true;
+        }
+
+    private:
+        struct Pair { int16_t x; int16_t y; };
+
+        static HIDKeyCode hidKeyCode(VirtualKeyCode key) { return virtualKeyCodeToHIDKeyCode(key); }
+        static Pair pair(int16_t x, int16_t y) { return { x, y }; }
+
+        static Request query(Command cmd, uint8_t responseSize) {
+            Request request{};
+            request.cmd = cmd;
+            request.responseSize = responseSize;
+            return request;
+        }
+
+        static Request make(Command cmd) { return query(cmd, sizeof(Status)); }
+
+        static Request reply(Command cmd) {
+            Request request = query(cmd, 0);
+            request.isVariableResponse = true;
+            return request;
+        }
+
+        static bool configString(Command cmd, const char* str, size_t strSize, size_t maxSize, Request& request) {
+            size_t dataSize = 0;
+            request = make(cmd);
+            if (!utf8ToUtf16LE(str, strSize, request.data, maxSize * sizeof(char16_t), dataSize)) return false;
+            request.dataSize = static_cast<uint8_t>(dataSize);
+            return true;
+        }
+
+        template <typename T>
+        static Request make(Command cmd, const T& data) {
+            static_assert(sizeof(T) <= sizeof(Request::data), "request data too large");
+            Request request = make(cmd);
+            request.dataSize = static_cast<uint8_t>(sizeof(T));
+            memcpy(request.data, &data, sizeof(T));
+            return request;
+        }
+    };
+
+    inline Status Device::sendRequest(const Request& request) {
+        return sendPacket(request.cmd, request.data, request.dataSize);
+    }
+
+    inline Status Device::sendFrame(const uint8_t* frame, size_t frameSize) {
+        bool ok = serialSend(frame, frameSize);
+        for (size_t offset = 0; tracer && offset + 4 <= frameSize; offset += 4u + frame[offset + 2]) {
+            size_t size = std::min<size_t>(4u + frame[offset + 2], frameSize - offset);
+            tracer->record(TraceSink::Direction::kSend, traceChannel, frame[offset + 1], &frame[offset], size, !ok);
+        }
+        return ok ? Status::kSuccess : Status::kSerialError;
+    }
+
+    inline Status Device::recvResponse(Request& request) {
+        uint8_t dataSize = request.responseSize;
+        if (!request.isVariableResponse) {
+            return recvPacket(request.cmd, request.response, request.responseSize);
+        }
+
+        Status status = recvPacket(request.cmd, request.response, sizeof(request.response), &dataSize);
+        if (status == Status::kSuccess) request.responseSize = dataSize;
+        return status;
+    }
+
+    inline Status Device::transact(Request& request) {
+        Status status = sendRequest(request);
+        if (status != Status::kSuccess) return status;
+
+        return recvResponse(request);
+    }
+
+    inline Status Device::movePathRel(int16_t x, int16_t y, uint32_t duration, uint32_t pollingRate, bool isIgnoreErrors,
+                                      const LinearPath& path,
+                                      std::function<void()> callback) {
+        PathSampler sampler(x, y, duration, pollingRate, path);
+        std::shared_ptr<const PathSource::Deltas> deltas;
+        if (pathCache) deltas = pathCache->lookup(x, y, duration, pollingRate, path);
+
+        Clock::time_point start = clock->now();
+        int32_t lastX = 0, lastY = 0;
+
+        for (uint32_t tick = 1; tick <= sampler.ticks(); ++tick) {
+            PathSource::Delta delta;
+            if (deltas) {
+                delta = (*deltas)[tick - 1];
+            } else {
+                int32_t posX, posY;
+                sampler.at(tick, posX, posY);
+                delta = { saturateInt16(posX - lastX), saturateInt16(posY - lastY) };
+                lastX = posX;
+                lastY = posY;
+            }
+
+            if (delta.x != 0 || delta.y != 0) {
+                Status status = moveRel(delta.x, delta.y);
+                if (status != Status::kSuccess && !isIgnoreErrors) return status;
+            }
+
+            callback();
+            clock->sleepUntil(start + sampler.elapsed(tick));
+        }
+        return Status::kSuccess;
+    }
+
+    inline Status Device::movePathAbs(int16_t x, int16_t y, uint32_t duration, uint32_t pollingRate, bool isIgnoreErrors,
+                                      const LinearPath& path,
+                                      std::function<void()> callback) {
+        int16_t startX, startY;
+        Status status = getPos(startX, startY);
+        if (status != Status::kSuccess) return status;
+
+        PathSampler sampler(x - startX, y - startY, duration, pollingRate, path);
+        Clock::time_point start = clock->now();
+        int32_t lastX = 0, lastY = 0;
+
+        for (uint32_t tick = 1; tick <= sampler.ticks(); ++tick) {
+            int32_t posX, posY;
+            sampler.at(tick, posX, posY);
+
+            if (posX != lastX || posY != lastY) {
+                status = moveAbs(saturateInt16(startX + posX), saturateInt16(startY + posY));
+                if (status != Status::kSuccess && !isIgnoreErrors) return status;
+                lastX = posX;
+                lastY = posY;
+            }
+
+            callback();
+            clock->sleepUntil(start + sampler.elapsed(tick));
+        }
+        return Status::kSuccess;
+    }
+
+    inline Status Device::movePathAbs(int16_t x, int16_t y, uint32_t duration, uint32_t pollingRate, bool isIgnoreErrors,
+                                      const LinearPath& path, const PathFeedback& feedback, PathFeedbackStats& stats,
+                                      std::function<void()> callback) {
+        const int32_t kMinTravel = 32;  // pixels to travel before a read can tell the gain
+        const int32_t kMaxStep = 8;     // pixels of correction per tick
+
+        stats = PathFeedbackStats{};
+        int16_t startX, startY;
+        Status status = getPos(startX, startY);
+        ++stats.roundTrips;
+        if (status != Status::kSuccess) return status;
+
+        PathSampler sampler(x - startX, y - startY, duration, pollingRate, path);
+        uint32_t ticks = sampler.ticks();
+        Clock::time_point start = clock->now();
+
+        // The offset added to the path to make up for where moves actually land: a step
+        // that ramps from `from` to `to` over `rampTicks`, plus `gain` times the distance
+        // covered since the last read, learned from reads that found the error growing
+        // with the distance, as it does when the board's idea of the screen is off.
+        int32_t fromX = 0, fromY = 0, toX = 0, toY = 0, rampX = 0, rampY = 0, offsetX = 0, offsetY = 0;
+        uint32_t rampStart = 0, rampTicks = 1, lastRead = 0;
+        double gainX = 0, gainY = 0;
+        double drift = -1;  // unforeseen error per pixel found by the last read, -1 until known
+
+        // Where the last move the board took was sent, and the point of the path it was
+        // aiming at. A refused move is simply sent again on the next tick.
+        int32_t sentX = startX, sentY = startY, aimX = 0, aimY = 0, readX = 0, readY = 0;
+
+        // Reads the pointer back, compares it with the aim of the last move, and aims the
+        // rest of the path at what it found.
+        auto read = [&](uint32_t tick) {
+            int16_t atX, atY;
+            Status status = getPos(atX, atY);
+            ++stats.roundTrips;
+            if (status != Status::kSuccess) return status;
+
+            int32_t errorX = atX - (startX + aimX), errorY = atY - (startY + aimY);
+            int32_t error = std::max(std::abs(errorX), std::abs(errorY));
+            if (error != 0) ++stats.corrections;
+            stats.maxError = std::max(stats.maxError, error);
+            stats.finalError = error;
+
+            // What the last read did not see coming: the error, less the part of its
+            // correction still to be ramped in. Over a short distance it is mostly rounding.
+            int32_t newX = errorX - (rampX - toX), newY = errorY - (rampY - toY);
+            int32_t travelled = std::max(std::abs(aimX - readX), std::abs(aimY - readY));
+            if (travelled >= kMinTravel) {
+                auto learn = [&](double& gain, int32_t error, int32_t travelled) {
+                    if (std::abs(travelled) >= kMinTravel) gain = std::max(-0.5, std::min(0.5, gain - static_cast<double>(error) / travelled));
+                };
+                learn(gainX, newX, aimX - readX);
+                learn(gainY, newY, aimY - readY);
+                drift = static_cast<double>(std::max(std::abs(newX), std::abs(newY))) / travelled;
+            }
+
+            fromX = offsetX;
+            fromY = offsetY;
+            toX = offsetX - errorX;
+            toY = offsetY - errorY;
+            readX = aimX;
+            readY = aimY;
+            rampStart = lastRead = tick;
+            rampTicks = std::max<uint32_t>(1, std::min<uint32_t>(ticks - tick, (error + kMaxStep - 1) / kMaxStep));
+            return Status::kSuccess;
+        };
+
+        for (uint32_t tick = 1; tick <= ticks; ++tick) {
+            int32_t posX, posY;
+            sampler.at(tick, posX, posY);
+
+            uint32_t step = std::min(tick - rampStart, rampTicks);
+            rampX = fromX + static_cast<int32_t>(static_cast<int64_t>(toX - fromX) * step / rampTicks);
+            rampY = fromY + static_cast<int32_t>(static_cast<int64_t>(toY - fromY) * step / rampTicks);
+            offsetX = rampX + static_cast<int32_t>(std::lround(gainX * (posX - readX)));
+            offsetY = rampY + static_cast<int32_t>(std::lround(gainY * (posY - readY)));
+
+            int16_t moveX = saturateInt16(startX + posX + offsetX), moveY = saturateInt16(startY + posY + offsetY);
+            if (moveX != sentX || moveY != sentY) {
+                status = moveAbs(moveX, moveY);
+                if (status == Status::kSuccess) {
+                    sentX = moveX;
+                    sentY = moveY;
+                } else if (!isIgnoreErrors) {
+                    return status;
+                }
+            }
+            if (sentX == moveX && sentY == moveY) {
+                aimX = posX;
+                aimY = posY;
+            }
+
+            // Nothing is known about where moves land until one has, so the first is read
+            // back, and the next once the pointer has gone far enough to learn the gain.
+            callback();
+            int32_t travelled = std::max(std::abs(aimX - readX), std::abs(aimY - readY));
+            bool isDue = drift < 0 ? travelled >= (lastRead == 0 ? 1 : kMinTravel) : drift * travelled > feedback.errorBudget;
+            if (tick == ticks || isDue || (feedback.interval != 0 && tick - lastRead >= feedback.interval)) {
+                status = read(tick);
+                if (status != Status::kSuccess && !isIgnoreErrors) return status;
+            }
+            clock->sleepUntil(start + sampler.elapsed(tick));
+        }
+
+        // No ticks are left to spread the last error over, so it is fixed in one move.
+        if (stats.finalError != 0) {
+            status = moveAbs(saturateInt16(x + toX), saturateInt16(y + toY));
+            if (status != Status::kSuccess && !isIgnoreErrors) return status;
+            if (status == Status::kSuccess) {
+                aimX = x - startX;
+                aimY = y - startY;
+                rampX = offsetX = toX;
+                rampY = offsetY = toY;
+            }
+            status = read(ticks);
+            if (status != Status::kSuccess && !isIgnoreErrors) return status;
+        }
+        return Status::kSuccess;
+    }
+
     static std::string statusToString(Status status) {
         std::ostringstream errorMessage;
 
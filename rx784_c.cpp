@@ -0,0 +1,487 @@
+#define RX784_BUILDING_DLL
+#include "rx784_c.h"
+#include "rx784.hpp"
+#include <new>
+
+struct rx784_device {
+    RX784::Device device;
+};
+
+namespace {
+    using namespace RX784;
+
+    constexpr size_t kBatchWindow = 16;
+
+    rx784_status toC(Status status) { return static_cast<rx784_status>(status); }
+
+    template <typename Call>
+    rx784_status call(rx784_device* dev, Call call) {
+        return dev ? toC(call(dev->device)) : static_cast<rx784_status>(RX784_INVALID_ARGUMENT);
+    }
+
+    // A command's status byte, as the blocking Device methods return it.
+    Status commandResult(size_t, const Device::Request& request) { return request.result(); }
+
+    Status transactCommand(Device& device, Device::Request request) {
+        Status status = device.transact(request);
+        return status == Status::kSuccess ? request.result() : status;
+    }
+
+    // Sends the n requests `make` builds, kBatchWindow frames per write, and reads the
+    // answers in order; `finish` turns each answer into that command's status.
+    template <typename Make, typename Finish>
+    rx784_status runBatch(rx784_device* dev, size_t n, rx784_status* out, Make make, Finish finish) {
+        if (!dev) return RX784_INVALID_ARGUMENT;
+
+        Device::Request requests[kBatchWindow];
+        size_t indices[kBatchWindow];
+        uint8_t frames[kBatchWindow * Device::Request::maxFrameSize()];
+        rx784_status first = RX784_SUCCESS;
+        bool isStopped = false;
+
+        auto report = [&](size_t i, rx784_status status) {
+            if (out) out[i] = status;
+            if (first == RX784_SUCCESS) first = status;
+        };
+
+        for (size_t begin = 0; begin < n; begin += kBatchWindow) {
+            size_t end = begin + std::min(kBatchWindow, n - begin), count = 0, size = 0;
+            for (size_t i = begin; i < end; ++i) {
+                if (isStopped) {
+                    report(i, RX784_SKIPPED);
+                } else if (!make(i, requests[count])) {
+                    report(i, RX784_INVALID_ARGUMENT);
+                } else {
+                    size += requests[count].encode(&frames[size]);
+                    indices[count++] = i;
+                }
+            }
+            if (count == 0) continue;
+
+            Status sent = dev->device.sendFrame(frames, size);
+            for (size_t j = 0; j < count; ++j) {
+                if (isStopped) {
+                    report(indices[j], RX784_SKIPPED);
+                    continue;
+                }
+                Status status = sent == Status::kSuccess ? dev->device.recvResponse(requests[j]) : sent;
+                if (status == Status::kSuccess) {
+                    report(indices[j], toC(finish(indices[j], requests[j])));
+                } else {
+                    report(indices[j], toC(status));
+                    isStopped = true;
+                }
+            }
+        }
+        return first;
+    }
+
+    template <typename Make>
+    rx784_status runBatch(rx784_device* dev, size_t n, rx784_status* out, Make make) {
+        return runBatch(dev, n, out, make, commandResult);
+    }
+
+    KeyboardState fromC(const rx784_keyboard_state& state) {
+        KeyboardState keyboardState{};
+        memcpy(&keyboardState.modifierKeys, &state.modifier_keys, sizeof(keyboardState.modifierKeys));
+        for (size_t i = 0; i < sizeof(state.regular_keys); ++i) {
+            keyboardState.regularKeys[i] = static_cast<VirtualKeyCode>(state.regular_keys[i]);
+        }
+        return keyboardState;
+    }
+
+    KeyboardStateMask fromC(const rx784_keyboard_state_mask& mask) {
+        KeyboardStateMask keyboardStateMask{};
+        memcpy(&keyboardStateMask.modifierKeys, &mask.modifier_keys, sizeof(keyboardStateMask.modifierKeys));
+        for (size_t i = 0; i < sizeof(mask.regular_keys); ++i) keyboardStateMask.regularKeys[i] = mask.regular_keys[i] != 0;
+        return keyboardStateMask;
+    }
+
+    MouseState fromC(const rx784_mouse_state& state) {
+        MouseState mouseState{};
+        memcpy(&mouseState.buttons, &state.buttons, sizeof(mouseState.buttons));
+        mouseState.axes = { state.x, state.y, state.w };
+        return mouseState;
+    }
+
+    MouseStateMask fromC(rx784_mouse_state_mask mask) {
+        MouseStateMask mouseStateMask{};
+        memcpy(&mouseStateMask, &mask, sizeof(mouseStateMask));
+        return mouseStateMask;
+    }
+
+    rx784_mouse_state toC(const MouseState& mouseState) {
+        rx784_mouse_state state{};
+        memcpy(&state.buttons, &mouseState.buttons, sizeof(mouseState.buttons));
+        state.x = mouseState.axes.x;
+        state.y = mouseState.axes.y;
+        state.w = mouseState.axes.w;
+        return state;
+    }
+
+    LinearPath fromC(const rx784_linear_path& path) {
+        return { path.a1, path.b1, path.a2, path.b2, path.p1x, path.p1y, path.p2x, path.p2y };
+    }
+
+    Status readString(Device& device, Device::Request request, char* str, size_t capacity, size_t* size) {
+        Status status = device.transact(request);
+        if (status == Status::kSuccess) status = request.hidString(str, capacity, *size);
+        return status;
+    }
+
+    Status readNumber(Device& device, Device::Request request, uint16_t* value) {
+        Status status = device.transact(request);
+        if (status == Status::kSuccess) status = request.hidNumber(*value);
+        return status;
+    }
+
+    bool makeOp(const rx784_op& op, Device::Request& request) {
+        switch (op.op)
+        {
+        case RX784_OP_KEY_DOWN:            request = Device::Request::keyDown(static_cast<VirtualKeyCode>(op.key)); return true;
+        case RX784_OP_KEY_UP:              request = Device::Request::keyUp(static_cast<VirtualKeyCode>(op.key)); return true;
+        case RX784_OP_BUTTON_DOWN:         request = Device::Request::buttonDown(static_cast<Button>(op.key)); return true;
+        case RX784_OP_BUTTON_UP:           request = Device::Request::buttonUp(static_cast<Button>(op.key)); return true;
+        case RX784_OP_MOVE_REL:            request = Device::Request::moveRel(op.x, op.y); return true;
+        case RX784_OP_MOVE_ABS:            request = Device::Request::moveAbs(op.x, op.y); return true;
+        case RX784_OP_SCROLL_REL:          request = Device::Request::scrollRel(op.w); return true;
+        case RX784_OP_SCROLL_ABS:          request = Device::Request::scrollAbs(op.w); return true;
+        case RX784_OP_SET_POS:             request = Device::Request::setPos(op.x, op.y); return true;
+        case RX784_OP_SET_AXES:            request = Device::Request::setAxes(op.x, op.y, op.w); return true;
+        case RX784_OP_RELEASE_ALL_KEYS:    request = Device::Request::releaseAllKeys(); return true;
+        case RX784_OP_RELEASE_ALL_BUTTONS: request = Device::Request::releaseAllButtons(); return true;
+        default:                           return false;
+        }
+    }
+}
+
+extern "C" {
+
+uint32_t rx784_abi_version(void) { return RX784_ABI_VERSION; }
+
+rx784_device* rx784_create(void) { return new (std::nothrow) rx784_device; }
+void rx784_destroy(rx784_device* dev) { delete dev; }
+
+rx784_status rx784_open(rx784_device* dev, const char* port) {
+    if (!port) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) { return device.open(port); });
+}
+
+rx784_status rx784_close(rx784_device* dev) {
+    return call(dev, [](Device& device) { return device.close(); });
+}
+
+rx784_status rx784_reboot(rx784_device* dev) {
+    return call(dev, [](Device& device) { return device.reboot(); });
+}
+
+rx784_status rx784_key_down(rx784_device* dev, uint8_t key) {
+    return call(dev, [&](Device& device) { return device.keyDown(static_cast<VirtualKeyCode>(key)); });
+}
+
+rx784_status rx784_key_up(rx784_device* dev, uint8_t key) {
+    return call(dev, [&](Device& device) { return device.keyUp(static_cast<VirtualKeyCode>(key)); });
+}
+
+rx784_status rx784_release_all_keys(rx784_device* dev) {
+    return call(dev, [](Device& device) { return device.releaseAllKeys(); });
+}
+
+rx784_status rx784_get_key_state(rx784_device* dev, uint8_t key, uint8_t* is_down) {
+    if (!is_down) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) {
+        bool isDown = false;
+        Status status = device.getKeyState(static_cast<VirtualKeyCode>(key), isDown);
+        *is_down = isDown;
+        return status;
+    });
+}
+
+rx784_status rx784_get_keyboard_leds_state(rx784_device* dev, rx784_keyboard_leds_state* state) {
+    if (!state) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) {
+        KeyboardLEDsState ledsState{};
+        Status status = device.getKeyboardLEDsState(ledsState);
+        memcpy(state, &ledsState, sizeof(*state));
+        return status;
+    });
+}
+
+rx784_status rx784_get_keyboard_state(rx784_device* dev, rx784_keyboard_state* state) {
+    if (!state) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) {
+        KeyboardState keyboardState{};
+        Status status = device.getKeyboardState(keyboardState);
+        memcpy(&state->modifier_keys, &keyboardState.modifierKeys, sizeof(state->modifier_keys));
+        for (size_t i = 0; i < sizeof(state->regular_keys); ++i) {
+            state->regular_keys[i] = static_cast<uint8_t>(keyboardState.regularKeys[i]);
+        }
+        return status;
+    });
+}
+
+rx784_status rx784_send_keyboard_state(rx784_device* dev, const rx784_keyboard_state* state,
+                                       const rx784_keyboard_state_mask* mask) {
+    if (!state || !mask) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) { return device.sendKeyboardState(fromC(*state), fromC(*mask)); });
+}
+
+rx784_status rx784_button_down(rx784_device* dev, uint8_t button) {
+    return call(dev, [&](Device& device) { return device.buttonDown(static_cast<Button>(button)); });
+}
+
+rx784_status rx784_button_up(rx784_device* dev, uint8_t button) {
+    return call(dev, [&](Device& device) { return device.buttonUp(static_cast<Button>(button)); });
+}
+
+rx784_status rx784_release_all_buttons(rx784_device* dev) {
+    return call(dev, [](Device& device) { return device.releaseAllButtons(); });
+}
+
+rx784_status rx784_get_buttons_state(rx784_device* dev, uint8_t* buttons) {
+    if (!buttons) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) {
+        ButtonsState buttonsState{};
+        Status status = device.getButtonsState(buttonsState);
+        memcpy(buttons, &buttonsState, sizeof(*buttons));
+        return status;
+    });
+}
+
+rx784_status rx784_move_rel(rx784_device* dev, int16_t x, int16_t y) {
+    return call(dev, [&](Device& device) { return device.moveRel(x, y); });
+}
+
+rx784_status rx784_move_path_rel(rx784_device* dev, int16_t x, int16_t y, uint32_t duration,
+                                 uint32_t polling_rate, uint8_t is_ignore_errors, const rx784_linear_path* path) {
+    if (!path) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) {
+        return device.movePathRel(x, y, duration, polling_rate, is_ignore_errors != 0, fromC(*path));
+    });
+}
+
+rx784_status rx784_scroll_rel(rx784_device* dev, int16_t w) {
+    return call(dev, [&](Device& device) { return device.scrollRel(w); });
+}
+
+rx784_status rx784_get_rel_mouse_state(rx784_device* dev, rx784_mouse_state* state) {
+    if (!state) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) {
+        MouseState mouseState{};
+        Status status = device.getRelMouseState(mouseState);
+        *state = toC(mouseState);
+        return status;
+    });
+}
+
+rx784_status rx784_send_rel_mouse_state(rx784_device* dev, const rx784_mouse_state* state, rx784_mouse_state_mask mask) {
+    if (!state) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) { return device.sendRelMouseState(fromC(*state), fromC(mask)); });
+}
+
+rx784_status rx784_init_abs_system(rx784_device* dev, int16_t screen_width, int16_t screen_height) {
+    return call(dev, [&](Device& device) { return device.initAbsSystem(screen_width, screen_height); });
+}
+
+rx784_status rx784_move_abs(rx784_device* dev, int16_t x, int16_t y) {
+    return call(dev, [&](Device& device) { return device.moveAbs(x, y); });
+}
+
+rx784_status rx784_move_path_abs(rx784_device* dev, int16_t x, int16_t y, uint32_t duration,
+                                 uint32_t polling_rate, uint8_t is_ignore_errors, const rx784_linear_path* path) {
+    if (!path) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) {
+        return device.movePathAbs(x, y, duration, polling_rate, is_ignore_errors != 0, fromC(*path));
+    });
+}
+
+rx784_status rx784_scroll_abs(rx784_device* dev, int16_t w) {
+    return call(dev, [&](Device& device) { return device.scrollAbs(w); });
+}
+
+rx784_status rx784_get_pos(rx784_device* dev, int16_t* x, int16_t* y) {
+    if (!x || !y) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) { return device.getPos(*x, *y); });
+}
+
+rx784_status rx784_set_pos(rx784_device* dev, int16_t x, int16_t y) {
+    return call(dev, [&](Device& device) { return device.setPos(x, y); });
+}
+
+rx784_status rx784_get_wheel_axis(rx784_device* dev, int16_t* w) {
+    if (!w) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) { return device.getWheelAxis(*w); });
+}
+
+rx784_status rx784_set_wheel_axis(rx784_device* dev, int16_t w) {
+    return call(dev, [&](Device& device) { return device.setWheelAxis(w); });
+}
+
+rx784_status rx784_get_axes(rx784_device* dev, int16_t* x, int16_t* y, int16_t* w) {
+    if (!x || !y || !w) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) { return device.getAxes(*x, *y, *w); });
+}
+
+rx784_status rx784_set_axes(rx784_device* dev, int16_t x, int16_t y, int16_t w) {
+    return call(dev, [&](Device& device) { return device.setAxes(x, y, w); });
+}
+
+rx784_status rx784_get_abs_mouse_state(rx784_device* dev, rx784_mouse_state* state) {
+    if (!state) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) {
+        MouseState mouseState{};
+        Status status = device.getAbsMouseState(mouseState);
+        *state = toC(mouseState);
+        return status;
+    });
+}
+
+rx784_status rx784_send_abs_mouse_state(rx784_device* dev, const rx784_mouse_state* state, rx784_mouse_state_mask mask) {
+    if (!state) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) { return device.sendAbsMouseState(fromC(*state), fromC(mask)); });
+}
+
+rx784_status rx784_config_hid_vendor_id(rx784_device* dev, uint16_t vendor_id) {
+    return call(dev, [&](Device& device) { return device.configHIDVendorID(vendor_id); });
+}
+
+rx784_status rx784_config_hid_product_id(rx784_device* dev, uint16_t product_id) {
+    return call(dev, [&](Device& device) { return device.configHIDProductID(product_id); });
+}
+
+rx784_status rx784_config_hid_version_number(rx784_device* dev, uint16_t version_number) {
+    return call(dev, [&](Device& device) { return device.configHIDVersionNumber(version_number); });
+}
+
+rx784_status rx784_config_hid_manufacturer_string(rx784_device* dev, const char* str, size_t size) {
+    Device::Request request;
+    if (!str) return RX784_INVALID_ARGUMENT;
+    if (!Device::Request::configHIDManufacturerString(str, size, request)) return RX784_INVALID_SIZE;
+    return call(dev, [&](Device& device) { return transactCommand(device, request); });
+}
+
+rx784_status rx784_config_hid_product_string(rx784_device* dev, const char* str, size_t size) {
+    Device::Request request;
+    if (!str) return RX784_INVALID_ARGUMENT;
+    if (!Device::Request::configHIDProductString(str, size, request)) return RX784_INVALID_SIZE;
+    return call(dev, [&](Device& device) { return transactCommand(device, request); });
+}
+
+rx784_status rx784_get_hid_vendor_id(rx784_device* dev, uint16_t* vendor_id) {
+    if (!vendor_id) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) { return readNumber(device, Device::Request::getHIDVendorID(), vendor_id); });
+}
+
+rx784_status rx784_get_hid_product_id(rx784_device* dev, uint16_t* product_id) {
+    if (!product_id) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) { return readNumber(device, Device::Request::getHIDProductID(), product_id); });
+}
+
+rx784_status rx784_get_hid_version_number(rx784_device* dev, uint16_t* version_number) {
+    if (!version_number) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) {
+        return readNumber(device, Device::Request::getHIDVersionNumber(), version_number);
+    });
+}
+
+rx784_status rx784_get_hid_manufacturer_string(rx784_device* dev, char* str, size_t capacity, size_t* size) {
+    if (!str || !size) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) {
+        return readString(device, Device::Request::getHIDManufacturerString(), str, capacity, size);
+    });
+}
+
+rx784_status rx784_get_hid_product_string(rx784_device* dev, char* str, size_t capacity, size_t* size) {
+    if (!str || !size) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) {
+        return readString(device, Device::Request::getHIDProductString(), str, capacity, size);
+    });
+}
+
+rx784_status rx784_get_device_id(rx784_device* dev, uint16_t* device_id) {
+    if (!device_id) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) { return device.getDeviceID(*device_id); });
+}
+
+rx784_status rx784_get_firmware_version(rx784_device* dev, uint16_t* firmware_version) {
+    if (!firmware_version) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) { return device.getFirmwareVersion(*firmware_version); });
+}
+
+rx784_status rx784_get_device_serial_number(rx784_device* dev, uint8_t serial_number[20]) {
+    if (!serial_number) return RX784_INVALID_ARGUMENT;
+    return call(dev, [&](Device& device) {
+        Device::Request request = Device::Request::getDeviceSerialNumber();
+        Status status = device.transact(request);
+        if (status == Status::kSuccess) memcpy(serial_number, request.response, 20);
+        return status;
+    });
+}
+
+rx784_status rx784_move_rel_n(rx784_device* dev, const int16_t* xy, size_t n, rx784_status* out) {
+    if (!xy && n != 0) return RX784_INVALID_ARGUMENT;
+    return runBatch(dev, n, out, [&](size_t i, Device::Request& request) {
+        request = Device::Request::moveRel(xy[2 * i], xy[2 * i + 1]);
+        return true;
+    });
+}
+
+rx784_status rx784_move_abs_n(rx784_device* dev, const int16_t* xy, size_t n, rx784_status* out) {
+    if (!xy && n != 0) return RX784_INVALID_ARGUMENT;
+    return runBatch(dev, n, out, [&](size_t i, Device::Request& request) {
+        request = Device::Request::moveAbs(xy[2 * i], xy[2 * i + 1]);
+        return true;
+    });
+}
+
+rx784_status rx784_scroll_rel_n(rx784_device* dev, const int16_t* w, size_t n, rx784_status* out) {
+    if (!w && n != 0) return RX784_INVALID_ARGUMENT;
+    return runBatch(dev, n, out, [&](size_t i, Device::Request& request) {
+        request = Device::Request::scrollRel(w[i]);
+        return true;
+    });
+}
+
+rx784_status rx784_scroll_abs_n(rx784_device* dev, const int16_t* w, size_t n, rx784_status* out) {
+    if (!w && n != 0) return RX784_INVALID_ARGUMENT;
+    return runBatch(dev, n, out, [&](size_t i, Device::Request& request) {
+        request = Device::Request::scrollAbs(w[i]);
+        return true;
+    });
+}
+
+rx784_status rx784_key_down_n(rx784_device* dev, const uint8_t* keys, size_t n, rx784_status* out) {
+    if (!keys && n != 0) return RX784_INVALID_ARGUMENT;
+    return runBatch(dev, n, out, [&](size_t i, Device::Request& request) {
+        request = Device::Request::keyDown(static_cast<VirtualKeyCode>(keys[i]));
+        return true;
+    });
+}
+
+rx784_status rx784_key_up_n(rx784_device* dev, const uint8_t* keys, size_t n, rx784_status* out) {
+    if (!keys && n != 0) return RX784_INVALID_ARGUMENT;
+    return runBatch(dev, n, out, [&](size_t i, Device::Request& request) {
+        request = Device::Request::keyUp(static_cast<VirtualKeyCode>(keys[i]));
+        return true;
+    });
+}
+
+rx784_status rx784_run_n(rx784_device* dev, const rx784_op* ops, size_t n, rx784_status* out) {
+    if (!ops && n != 0) return RX784_INVALID_ARGUMENT;
+    return runBatch(dev, n, out, [&](size_t i, Device::Request& request) { return makeOp(ops[i], request); });
+}
+
+rx784_status rx784_get_pos_n(rx784_device* dev, int16_t* xy, size_t n, rx784_status* out) {
+    if (!xy && n != 0) return RX784_INVALID_ARGUMENT;
+    return runBatch(dev, n, out,
+        [](size_t, Device::Request& request) {
+            request = Device::Request::getPos();
+            return true;
+        },
+        [&](size_t i, const Device::Request& request) {
+            memcpy(&xy[2 * i], request.response, 2 * sizeof(int16_t));
+            return Status::kSuccess;
+        });
+}
+
+}
@@ -0,0 +1,201 @@
+#ifndef RX784_C_H
+#define RX784_C_H
+
+/*
+ * C ABI over RX784::Device, for FFI callers such as ctypes or P/Invoke. Build it as a
+ * shared library from rx784_c.cpp:
+ *
+ *     g++ -std=c++14 -O2 -shared -fPIC -fvisibility=hidden rx784_c.cpp -o librx784.so -pthread
+ *     cl /O2 /LD /DRX784_BUILDING_DLL rx784_c.cpp /Fe:rx784.dll
+ *
+ * Every call returns an rx784_status and writes results only into caller buffers; no
+ * call allocates on the caller's behalf. A handle must not be used by two threads at
+ * once.
+ *
+ * The _n entry points send up to 16 frames per write and read the answers in order,
+ * so one call from a scripting runtime can carry thousands of commands. They return
+ * the first failure, or RX784_SUCCESS, and when `out` is not NULL store each
+ * command's own status there. A command the board rejects does not stop the batch; a
+ * serial error or a garbled answer does, and every command after it gets
+ * RX784_SKIPPED, whether or not its frame had already gone out.
+ *
+ * Only functions and constants are added in later versions; existing signatures and
+ * struct layouts stay as they are. rx784_abi_version() returns RX784_ABI_VERSION.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(RX784_BUILDING_DLL)
+#define RX784_API __declspec(dllexport)
+#else
+#define RX784_API __declspec(dllimport)
+#endif
+#else
+#define RX784_API __attribute__((visibility("default")))
+#endif
+
+#define RX784_ABI_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct rx784_device rx784_device;
+
+typedef uint8_t rx784_status;
+enum {
+    RX784_SUCCESS = 0,
+    RX784_SERIAL_ERROR,
+    RX784_READ_FLASH_ERROR,
+    RX784_WRITE_FLASH_ERROR,
+    RX784_INVALID_SIZE,
+    RX784_INVALID_COMMAND_PACKET,
+    RX784_INVALID_RESPONSE_PACKET,
+    RX784_SKIPPED = 0xFE,           /* not answered, an earlier command in the batch failed */
+    RX784_INVALID_ARGUMENT = 0xFF   /* NULL handle or buffer, or an unknown op */
+};
+
+/* Keys are RX784::VirtualKeyCode values and buttons RX784::Button values. */
+enum {
+    RX784_BUTTON_LEFT = 0,
+    RX784_BUTTON_RIGHT,
+    RX784_BUTTON_MIDDLE,
+    RX784_BUTTON_4,
+    RX784_BUTTON_5
+};
+
+/* Bit i of modifier_keys: left control, shift, alt, OS, then the same on the right. */
+typedef struct rx784_keyboard_state {
+    uint8_t modifier_keys;
+    uint8_t regular_keys[7];
+} rx784_keyboard_state;
+
+typedef struct rx784_keyboard_state_mask {
+    uint8_t modifier_keys;
+    uint8_t regular_keys[7];  /* nonzero to set the slot */
+} rx784_keyboard_state_mask;
+
+/* Bit i of buttons is button i. */
+typedef struct rx784_mouse_state {
+    uint8_t buttons;
+    int16_t x;
+    int16_t y;
+    int16_t w;
+} rx784_mouse_state;
+
+/* Bits 0-2 select the left, right and middle buttons, bits 3-5 the x, y and w axes. */
+typedef uint8_t rx784_mouse_state_mask;
+
+/* Bit 0 num lock, 1 caps lock, 2 scroll lock, 3 compose, 4 kana. */
+typedef uint8_t rx784_keyboard_leds_state;
+
+typedef struct rx784_linear_path {
+    double a1, b1, a2, b2;
+    double p1x, p1y, p2x, p2y;
+} rx784_linear_path;
+
+/* One command of a mixed batch; fields an op does not use are ignored. */
+enum {
+    RX784_OP_KEY_DOWN = 0,   /* key */
+    RX784_OP_KEY_UP,         /* key */
+    RX784_OP_BUTTON_DOWN,    /* key holds the button */
+    RX784_OP_BUTTON_UP,      /* key holds the button */
+    RX784_OP_MOVE_REL,       /* x, y */
+    RX784_OP_MOVE_ABS,       /* x, y */
+    RX784_OP_SCROLL_REL,     /* w */
+    RX784_OP_SCROLL_ABS,     /* w */
+    RX784_OP_SET_POS,        /* x, y */
+    RX784_OP_SET_AXES,       /* x, y, w */
+    RX784_OP_RELEASE_ALL_KEYS,
+    RX784_OP_RELEASE_ALL_BUTTONS
+};
+
+typedef struct rx784_op {
+    uint8_t op;
+    uint8_t key;
+    int16_t x;
+    int16_t y;
+    int16_t w;
+} rx784_op;
+
+RX784_API uint32_t rx784_abi_version(void);
+
+RX784_API rx784_device* rx784_create(void);
+RX784_API void rx784_destroy(rx784_device* dev);
+RX784_API rx784_status rx784_open(rx784_device* dev, const char* port);
+RX784_API rx784_status rx784_close(rx784_device* dev);
+
+RX784_API rx784_status rx784_reboot(rx784_device* dev);
+
+RX784_API rx784_status rx784_key_down(rx784_device* dev, uint8_t key);
+RX784_API rx784_status rx784_key_up(rx784_device* dev, uint8_t key);
+RX784_API rx784_status rx784_release_all_keys(rx784_device* dev);
+RX784_API rx784_status rx784_get_key_state(rx784_device* dev, uint8_t key, uint8_t* is_down);
+RX784_API rx784_status rx784_get_keyboard_leds_state(rx784_device* dev, rx784_keyboard_leds_state* state);
+RX784_API rx784_status rx784_get_keyboard_state(rx784_device* dev, rx784_keyboard_state* state);
+RX784_API rx784_status rx784_send_keyboard_state(rx784_device* dev, const rx784_keyboard_state* state,
+                                                 const rx784_keyboard_state_mask* mask);
+
+RX784_API rx784_status rx784_button_down(rx784_device* dev, uint8_t button);
+RX784_API rx784_status rx784_button_up(rx784_device* dev, uint8_t button);
+RX784_API rx784_status rx784_release_all_buttons(rx784_device* dev);
+RX784_API rx784_status rx784_get_buttons_state(rx784_device* dev, uint8_t* buttons);
+
+RX784_API rx784_status rx784_move_rel(rx784_device* dev, int16_t x, int16_t y);
+RX784_API rx784_status rx784_move_path_rel(rx784_device* dev, int16_t x, int16_t y, uint32_t duration,
+                                           uint32_t polling_rate, uint8_t is_ignore_errors, const rx784_linear_path* path);
+RX784_API rx784_status rx784_scroll_rel(rx784_device* dev, int16_t w);
+RX784_API rx784_status rx784_get_rel_mouse_state(rx784_device* dev, rx784_mouse_state* state);
+RX784_API rx784_status rx784_send_rel_mouse_state(rx784_device* dev, const rx784_mouse_state* state,
+                                                  rx784_mouse_state_mask mask);
+
+RX784_API rx784_status rx784_init_abs_system(rx784_device* dev, int16_t screen_width, int16_t screen_height);
+RX784_API rx784_status rx784_move_abs(rx784_device* dev, int16_t x, int16_t y);
+RX784_API rx784_status rx784_move_path_abs(rx784_device* dev, int16_t x, int16_t y, uint32_t duration,
+                                           uint32_t polling_rate, uint8_t is_ignore_errors, const rx784_linear_path* path);
+RX784_API rx784_status rx784_scroll_abs(rx784_device* dev, int16_t w);
+RX784_API rx784_status rx784_get_pos(rx784_device* dev, int16_t* x, int16_t* y);
+RX784_API rx784_status rx784_set_pos(rx784_device* dev, int16_t x, int16_t y);
+RX784_API rx784_status rx784_get_wheel_axis(rx784_device* dev, int16_t* w);
+RX784_API rx784_status rx784_set_wheel_axis(rx784_device* dev, int16_t w);
+RX784_API rx784_status rx784_get_axes(rx784_device* dev, int16_t* x, int16_t* y, int16_t* w);
+RX784_API rx784_status rx784_set_axes(rx784_device* dev, int16_t x, int16_t y, int16_t w);
+RX784_API rx784_status rx784_get_abs_mouse_state(rx784_device* dev, rx784_mouse_state* state);
+RX784_API rx784_status rx784_send_abs_mouse_state(rx784_device* dev, const rx784_mouse_state* state,
+                                                  rx784_mouse_state_mask mask);
+
+/* Strings are UTF-8 and not NUL-terminated; `size` receives the byte count. */
+RX784_API rx784_status rx784_config_hid_vendor_id(rx784_device* dev, uint16_t vendor_id);
+RX784_API rx784_status rx784_config_hid_product_id(rx784_device* dev, uint16_t product_id);
+RX784_API rx784_status rx784_config_hid_version_number(rx784_device* dev, uint16_t version_number);
+RX784_API rx784_status rx784_config_hid_manufacturer_string(rx784_device* dev, const char* str, size_t size);
+RX784_API rx784_status rx784_config_hid_product_string(rx784_device* dev, const char* str, size_t size);
+RX784_API rx784_status rx784_get_hid_vendor_id(rx784_device* dev, uint16_t* vendor_id);
+RX784_API rx784_status rx784_get_hid_product_id(rx784_device* dev, uint16_t* product_id);
+RX784_API rx784_status rx784_get_hid_version_number(rx784_device* dev, uint16_t* version_number);
+RX784_API rx784_status rx784_get_hid_manufacturer_string(rx784_device* dev, char* str, size_t capacity, size_t* size);
+RX784_API rx784_status rx784_get_hid_product_string(rx784_device* dev, char* str, size_t capacity, size_t* size);
+
+RX784_API rx784_status rx784_get_device_id(rx784_device* dev, uint16_t* device_id);
+RX784_API rx784_status rx784_get_firmware_version(rx784_device* dev, uint16_t* firmware_version);
+RX784_API rx784_status rx784_get_device_serial_number(rx784_device* dev, uint8_t serial_number[20]);
+
+/* xy holds n (x, y) pairs; w and keys hold n values. */
+RX784_API rx784_status rx784_move_rel_n(rx784_device* dev, const int16_t* xy, size_t n, rx784_status* out);
+RX784_API rx784_status rx784_move_abs_n(rx784_device* dev, const int16_t* xy, size_t n, rx784_status* out);
+RX784_API rx784_status rx784_scroll_rel_n(rx784_device* dev, const int16_t* w, size_t n, rx784_status* out);
+RX784_API rx784_status rx784_scroll_abs_n(rx784_device* dev, const int16_t* w, size_t n, rx784_status* out);
+RX784_API rx784_status rx784_key_down_n(rx784_device* dev, const uint8_t* keys, size_t n, rx784_status* out);
+RX784_API rx784_status rx784_key_up_n(rx784_device* dev, const uint8_t* keys, size_t n, rx784_status* out);
+RX784_API rx784_status rx784_run_n(rx784_device* dev, const rx784_op* ops, size_t n, rx784_status* out);
+
+/* Reads the position n times back to back, into n (x, y) pairs. */
+RX784_API rx784_status rx784_get_pos_n(rx784_device* dev, int16_t* xy, size_t n, rx784_status* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,145 @@
+#pragma once
+#include "rx784.hpp"
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace RX784 {
+    // Bounded LRU of fully expanded relative paths, keyed by every movePathRel parameter,
+    // so that a repeated move costs a lookup instead of a Bezier evaluation per tick.
+    class PathCache : public PathSource {
+    public:
+        struct Stats {
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t evictions;
+            size_t entries;
+            size_t bytes;
+        };
+
+        explicit PathCache(size_t capacity = 1 << 20) : capacity(capacity), stats_{} {}
+
+        PathCache(const PathCache&) = delete;
+        PathCache& operator=(const PathCache&) = delete;
+
+        static Deltas expand(int16_t x, int16_t y, uint32_t duration, uint32_t pollingRate, const LinearPath& path) {
+            PathSampler sampler(x, y, duration, pollingRate, path);
+            Deltas deltas(sampler.ticks());
+            int32_t lastX = 0, lastY = 0;
+
+            for (uint32_t tick = 1; tick <= sampler.ticks(); ++tick) {
+                int32_t posX, posY;
+                sampler.at(tick, posX, posY);
+                deltas[tick - 1] = { saturateInt16(posX - lastX), saturateInt16(posY - lastY) };
+                lastX = posX;
+                lastY = posY;
+            }
+            return deltas;
+        }
+
+        std::shared_ptr<const Deltas> lookup(int16_t x, int16_t y, uint32_t duration, uint32_t pollingRate,
+                                             const LinearPath& path) override {
+            Key key = { x, y, duration, pollingRate, path };
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto found = index.find(key);
+                if (found != index.end()) {
+                    ++stats_.hits;
+                    entries.splice(entries.begin(), entries, found->second);
+                    return found->second->deltas;
+                }
+                ++stats_.misses;
+            }
+
+            auto deltas = std::make_shared<const Deltas>(expand(x, y, duration, pollingRate, path));
+            size_t bytes = entryBytes(*deltas);
+            if (bytes > capacity) return deltas;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (index.count(key)) return deltas;
+
+            entries.push_front({ key, deltas });
+            index.emplace(key, entries.begin());
+            stats_.bytes += bytes;
+            ++stats_.entries;
+            evict();
+            return deltas;
+        }
+
+        void setCapacity(size_t bytes) {
+            std::lock_guard<std::mutex> lock(mutex);
+            capacity = bytes;
+            evict();
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            index.clear();
+            entries.clear();
+            stats_.entries = 0;
+            stats_.bytes = 0;
+        }
+
+        Stats stats() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return stats_;
+        }
+
+    private:
+        struct Key {
+            int16_t x;
+            int16_t y;
+            uint32_t duration;
+            uint32_t pollingRate;
+            LinearPath path;
+
+            bool operator==(const Key& other) const {
+                return x == other.x && y == other.y && duration == other.duration &&
+                       pollingRate == other.pollingRate && memcmp(&path, &other.path, sizeof(path)) == 0;
+            }
+        };
+
+        struct KeyHash {
+            size_t operator()(const Key& key) const {
+                uint64_t hash = 14695981039346656037ull;
+                auto mix = [&hash](const void* data, size_t size) {
+                    for (size_t i = 0; i < size; ++i) {
+                        hash = (hash ^ static_cast<const uint8_t*>(data)[i]) * 1099511628211ull;
+                    }
+                };
+                mix(&key.x, sizeof(key.x));
+                mix(&key.y, sizeof(key.y));
+                mix(&key.duration, sizeof(key.duration));
+                mix(&key.pollingRate, sizeof(key.pollingRate));
+                mix(&key.path, sizeof(key.path));
+                return static_cast<size_t>(hash);
+            }
+        };
+
+        struct Entry {
+            Key key;
+            std::shared_ptr<const Deltas> deltas;
+        };
+
+        size_t capacity;
+        Stats stats_;
+        mutable std::mutex mutex;
+        std::list<Entry> entries;
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+
+        static size_t entryBytes(const Deltas& deltas) {
+            return deltas.size() * sizeof(Delta) + sizeof(Entry) + sizeof(Key) + 8 * sizeof(void*);
+        }
+
+        void evict() {
+            while (stats_.bytes > capacity && !entries.empty()) {
+                const Entry& victim = entries.back();
+                stats_.bytes -= entryBytes(*victim.deltas);
+                --stats_.entries;
+                ++stats_.evictions;
+                index.erase(victim.key);
+                entries.pop_back();
+            }
+        }
+    };
+};
@@ -0,0 +1,154 @@
+#pragma once
+#include "rx784.hpp"
+
+namespace RX784 {
+    // Time that stands still while any attached thread is busy, and jumps to the nearest
+    // deadline as soon as all of them are waiting on the clock. Hours of paced motion
+    // against a SimulatedBoard then take as long as the frames do, and come out the same
+    // on every run, as long as no two threads act on the same instant.
+    //
+    //     RX784::VirtualClock clock;
+    //     clock.attach();             // the test's own thread
+    //     device.setClock(clock);
+    //     RX784::PathQueue queue(device, 250, std::chrono::milliseconds(48), clock);
+    //     ...
+    //     clock.detach();
+    //
+    // Every thread that waits on the clock must be attached for as long as it does; the
+    // library's own threads attach themselves. A thread blocked elsewhere, such as in a
+    // serial read, counts as busy.
+    class VirtualClock : public Clock {
+    public:
+        explicit VirtualClock(time_point start = time_point(std::chrono::hours(1)))
+            : current(start), tasks(0), blocked(0), waiters(nullptr) {}
+
+        VirtualClock(const VirtualClock&) = delete;
+        VirtualClock& operator=(const VirtualClock&) = delete;
+
+        time_point now() override {
+            std::lock_guard<std::mutex> lock(mutex);
+            return current;
+        }
+
+        void sleepUntil(time_point deadline) override {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (current >= deadline) return;
+
+            Waiter waiter = { deadline, nullptr, false, nullptr };
+            park(waiter);
+            ticked.wait(lock, [&] { return waiter.isWoken; });
+            unlink(waiter);
+        }
+
+        void notifyOne(std::condition_variable& condition) override { notifyAll(condition); }
+
+        void notifyAll(std::condition_variable& condition) override {
+            std::lock_guard<std::mutex> lock(mutex);
+            bool isAnyWoken = false;
+            for (Waiter* waiter = waiters; waiter; waiter = waiter->next) {
+                if (waiter->condition == &condition && !waiter->isWoken) {
+                    waiter->isWoken = true;
+                    --blocked;
+                    isAnyWoken = true;
+                }
+            }
+            if (isAnyWoken) ticked.notify_all();
+        }
+
+        bool isRealTime() const override { return false; }
+
+        void attach() override {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++tasks;
+        }
+
+        void detach() override {
+            std::lock_guard<std::mutex> lock(mutex);
+            --tasks;
+            advanceIfIdle();
+        }
+
+        // Moves time on by hand, for tests that drive the clock from outside.
+        void advance(duration step) {
+            std::lock_guard<std::mutex> lock(mutex);
+            current += step;
+            wakeDue();
+        }
+
+    protected:
+        bool block(std::unique_lock<std::mutex>& outer, std::condition_variable& condition, time_point deadline,
+                   bool (*isReady)(const void* context), const void* context) override {
+            for (;;) {
+                if (isReady(context)) return true;
+                {
+                    // Parked before `outer` is let go, so a notify that follows a change
+                    // made under `outer` cannot miss this waiter.
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (current >= deadline) return false;
+
+                    Waiter waiter = { deadline, &condition, false, nullptr };
+                    park(waiter);
+                    outer.unlock();
+                    ticked.wait(lock, [&] { return waiter.isWoken; });
+                    unlink(waiter);
+                }
+                outer.lock();
+            }
+        }
+
+    private:
+        struct Waiter {
+            time_point deadline;
+            std::condition_variable* condition;  // nullptr for a sleep
+            bool isWoken;
+            Waiter* next;
+        };
+
+        std::mutex mutex;
+        std::condition_variable ticked;
+        time_point current;
+        size_t tasks;
+        size_t blocked;
+        Waiter* waiters;
+
+        void park(Waiter& waiter) {
+            waiter.next = waiters;
+            waiters = &waiter;
+            ++blocked;
+            advanceIfIdle();
+        }
+
+        void unlink(Waiter& waiter) {
+            for (Waiter** link = &waiters; *link; link = &(*link)->next) {
+                if (*link == &waiter) {
+                    *link = waiter.next;
+                    return;
+                }
+            }
+        }
+
+        void wakeDue() {
+            bool isAnyWoken = false;
+            for (Waiter* waiter = waiters; waiter; waiter = waiter->next) {
+                if (!waiter->isWoken && waiter->deadline <= current) {
+                    waiter->isWoken = true;
+                    --blocked;
+                    isAnyWoken = true;
+                }
+            }
+            if (isAnyWoken) ticked.notify_all();
+        }
+
+        void advanceIfIdle() {
+            if (tasks == 0 || blocked < tasks) return;
+
+            time_point next = time_point::max();
+            for (Waiter* waiter = waiters; waiter; waiter = waiter->next) {
+                if (!waiter->isWoken) next = std::min(next, waiter->deadline);
+            }
+            if (next == time_point::max()) return;  // everyone waits on everyone else
+            current = std::max(current, next);
+            wakeDue();
+        }
+    };
+};
@@ -0,0 +1,554 @@
+#pragma once
+#include "rx784_queue.hpp"
+#include <coroutine>
+#include <atomic>
+#include <exception>
+#include <utility>
+
+#ifdef _WIN32
+#include <mmsystem.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "winmm.lib")
+#endif
+#endif
+
+namespace RX784 {
+    class Scheduler;
+
+    template <typename T = void>
+    class Task;
+
+    // Hierarchical timing wheel: 64 slots per level, each level 64 times coarser than the
+    // one below. Timers are intrusive, so scheduling never allocates.
+    class TimerWheel {
+    public:
+        struct Timer {
+            uint64_t tick;
+            Timer* next;
+            std::coroutine_handle<> handle;
+        };
+
+        explicit TimerWheel(uint64_t tick = 0) : current(tick), count(0), slots{}, occupied{} {}
+
+        uint64_t now() const { return current; }
+        size_t size() const { return count; }
+
+        // Returns false if the timer is already due.
+        bool insert(Timer& timer) {
+            if (timer.tick <= current) return false;
+            place(timer);
+            ++count;
+            return true;
+        }
+
+        // Earliest tick at which advance() has anything to do, or UINT64_MAX.
+        uint64_t nextTick() const {
+            uint64_t next = UINT64_MAX;
+            for (size_t level = 0; level < kLevels; ++level) {
+                if (!occupied[level]) continue;
+
+                size_t shift = kSlotBits * level;
+                uint64_t base = current >> shift;
+                unsigned rotation = static_cast<unsigned>((base + 1) & kSlotMask);
+                uint64_t bits = rotation ? (occupied[level] >> rotation) | (occupied[level] << (kSlots - rotation))
+                                         : occupied[level];
+                next = std::min(next, (base + 1 + countTrailingZeros(bits)) << shift);
+            }
+            return next;
+        }
+
+        // Moves to `tick` and returns the expired timers in firing order.
+        Timer* advance(uint64_t tick) {
+            Timer* expired = nullptr;
+            Timer** tail = &expired;
+
+            while (current < tick) {
+                uint64_t next = nextTick();
+                if (next > tick) {
+                    current = tick;
+                    break;
+                }
+                current = next;
+
+                for (size_t level = kLevels - 1; level > 0; --level) {
+                    if (current & ((uint64_t(1) << (kSlotBits * level)) - 1)) continue;
+                    cascade(level, (current >> (kSlotBits * level)) & kSlotMask);
+                }
+
+                size_t slot = current & kSlotMask;
+                for (Timer* timer = take(0, slot); timer; timer = timer->next) {
+                    *tail = timer;
+                    tail = &timer->next;
+                    --count;
+                }
+            }
+            *tail = nullptr;
+            return expired;
+        }
+
+    private:
+        static constexpr size_t kSlotBits = 6;
+        static constexpr size_t kSlots    = size_t(1) << kSlotBits;
+        static constexpr size_t kSlotMask = kSlots - 1;
+        static constexpr size_t kLevels   = 6;
+
+        uint64_t current;
+        size_t count;
+        Timer* slots[kLevels][kSlots];
+        uint64_t occupied[kLevels];
+
+        static unsigned countTrailingZeros(uint64_t bits) {
+            unsigned n = 0;
+            while (!(bits & 1)) {
+                bits >>= 1;
+                ++n;
+            }
+            return n;
+        }
+
+        void place(Timer& timer) {
+            size_t level = 0;
+            while (level + 1 < kLevels &&
+                   (timer.tick >> (kSlotBits * level)) - (current >> (kSlotBits * level)) >= kSlots) {
+                ++level;
+            }
+
+            uint64_t index = timer.tick >> (kSlotBits * level);
+            uint64_t limit = (current >> (kSlotBits * level)) + kSlots - 1;
+            size_t slot = std::min(index, limit) & kSlotMask;
+
+            timer.next = slots[level][slot];
+            slots[level][slot] = &timer;
+            occupied[level] |= uint64_t(1) << slot;
+        }
+
+        Timer* take(size_t level, size_t slot) {
+            Timer* list = slots[level][slot];
+            slots[level][slot] = nullptr;
+            occupied[level] &= ~(uint64_t(1) << slot);
+            return list;
+        }
+
+        void cascade(size_t level, size_t slot) {
+            for (Timer* timer = take(level, slot); timer;) {
+                Timer* next = timer->next;
+                place(*timer);
+                timer = next;
+            }
+        }
+    };
+
+    class TaskPromiseBase {
+    public:
+        std::coroutine_handle<> continuation;
+        Scheduler* scheduler = nullptr;
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        void unhandled_exception() noexcept { std::terminate(); }
+
+        struct FinalAwaiter {
+            bool await_ready() const noexcept { return false; }
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept;
+            void await_resume() const noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept { return {}; }
+    };
+
+    template <typename T>
+    struct TaskResult {
+        T value{};
+        void return_value(T result) { value = std::move(result); }
+        T take() { return std::move(value); }
+    };
+
+    template <>
+    struct TaskResult<void> {
+        void return_void() {}
+        void take() {}
+    };
+
+    // Lazily started coroutine. Await it from another task, or hand it to Scheduler::spawn.
+    template <typename T>
+    class Task {
+    public:
+        struct promise_type : TaskPromiseBase, TaskResult<T> {
+            Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        };
+
+        Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+        ~Task() { if (handle) handle.destroy(); }
+
+        bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+            handle.promise().continuation = continuation;
+            return handle;
+        }
+
+        T await_resume() { return handle.promise().take(); }
+
+    private:
+        friend class Scheduler;
+
+        explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    // Drives any number of tasks from one thread: a timing wheel for sleeps and a
+    // thread-safe run queue that CommandQueue completions post into. Sleeps are measured
+    // on `clock`; the spin before a deadline is skipped when it is not real time.
+    class Scheduler {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit Scheduler(std::chrono::nanoseconds resolution = std::chrono::microseconds(100),
+                           std::chrono::nanoseconds spinThreshold = std::chrono::microseconds(1500),
+                           RX784::Clock& clock = steadyClock())
+            : clock(clock), epoch(clock.now()), resolution(resolution), spinThreshold(spinThreshold),
+              liveTasks(0), hasPosted(false) {}
+
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+
+        static Scheduler* current() { return currentScheduler(); }
+
+        // The running scheduler's time, or the steady clock's off the scheduler thread.
+        static Clock::time_point now() {
+            Scheduler* scheduler = current();
+            return scheduler ? scheduler->clock.now() : Clock::now();
+        }
+
+        template <typename T>
+        void spawn(Task<T> task) {
+            std::coroutine_handle<> handle = task.handle;
+            task.handle.promise().scheduler = this;
+            task.handle = nullptr;
+            ++liveTasks;
+            post(handle);
+        }
+
+        // Resumes `handle` on the scheduler thread. Safe to call from any thread.
+        void post(std::coroutine_handle<> handle) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                posted.push_back(handle);
+                hasPosted.store(true, std::memory_order_release);
+            }
+            clock.notifyOne(condition);
+        }
+
+        void schedule(TimerWheel::Timer& timer, Clock::time_point deadline) {
+            auto offset = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - epoch);
+            timer.tick = offset.count() <= 0 ? 0 : (offset.count() + resolution.count() - 1) / resolution.count();
+            if (!wheel.insert(timer)) post(timer.handle);
+        }
+
+        // Runs until every spawned task has finished.
+        void run() {
+            Scheduler*& current = currentScheduler();
+            Scheduler* previous = current;
+            current = this;
+#ifdef _WIN32
+            timeBeginPeriod(1);
+#endif
+            clock.attach();
+
+            std::vector<std::coroutine_handle<>> ready;
+            while (liveTasks != 0) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ready.swap(posted);
+                    hasPosted.store(false, std::memory_order_relaxed);
+                }
+                for (std::coroutine_handle<> handle : ready) handle.resume();
+                ready.clear();
+
+                for (TimerWheel::Timer* timer = wheel.advance(tickAt(clock.now())); timer;) {
+                    TimerWheel::Timer* next = timer->next;
+                    timer->handle.resume();
+                    timer = next;
+                }
+
+                if (liveTasks != 0) wait();
+            }
+            clock.detach();
+
+#ifdef _WIN32
+            timeEndPeriod(1);
+#endif
+            current = previous;
+        }
+
+    private:
+        friend class TaskPromiseBase;
+
+        RX784::Clock& clock;
+        Clock::time_point epoch;
+        std::chrono::nanoseconds resolution;
+        std::chrono::nanoseconds spinThreshold;
+        TimerWheel wheel;
+        size_t liveTasks;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::vector<std::coroutine_handle<>> posted;
+        std::atomic<bool> hasPosted;
+
+        static Scheduler*& currentScheduler() {
+            static thread_local Scheduler* scheduler = nullptr;
+            return scheduler;
+        }
+
+        uint64_t tickAt(Clock::time_point time) const {
+            auto offset = std::chrono::duration_cast<std::chrono::nanoseconds>(time - epoch);
+            return offset.count() <= 0 ? 0 : offset.count() / resolution.count();
+        }
+
+        void wait() {
+            uint64_t next = wheel.nextTick();
+            std::unique_lock<std::mutex> lock(mutex);
+            if (!posted.empty()) return;
+
+            if (next == UINT64_MAX) {
+                clock.wait(lock, condition, [this] { return !posted.empty(); });
+                return;
+            }
+
+            Clock::time_point deadline = epoch + resolution * next;
+            if (!clock.isRealTime()) {
+                clock.waitUntil(lock, condition, deadline, [this] { return !posted.empty(); });
+                return;
+            }
+            if (deadline - clock.now() > spinThreshold) {
+                clock.waitUntil(lock, condition, deadline - spinThreshold, [this] { return !posted.empty(); });
+                return;
+            }
+
+            lock.unlock();
+            while (clock.now() < deadline && !hasPosted.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+        }
+    };
+
+    template <typename Promise>
+    std::coroutine_handle<> TaskPromiseBase::FinalAwaiter::await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+        TaskPromiseBase& promise = handle.promise();
+        if (promise.continuation) return promise.continuation;
+
+        if (Scheduler* scheduler = promise.scheduler) {
+            handle.destroy();
+            --scheduler->liveTasks;
+        }
+        return std::noop_coroutine();
+    }
+
+    class SleepAwaiter {
+    public:
+        explicit SleepAwaiter(Scheduler::Clock::time_point deadline) : deadline(deadline), timer{} {}
+
+        bool await_ready() const { return deadline <= Scheduler::now(); }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            timer.handle = handle;
+            Scheduler::current()->schedule(timer, deadline);
+        }
+
+        void await_resume() const {}
+
+    private:
+        Scheduler::Clock::time_point deadline;
+        TimerWheel::Timer timer;
+    };
+
+    inline SleepAwaiter sleepUntil(Scheduler::Clock::time_point deadline) {
+        return SleepAwaiter(deadline);
+    }
+
+    template <typename Rep, typename Period>
+    SleepAwaiter sleepFor(std::chrono::duration<Rep, Period> duration) {
+        return SleepAwaiter(Scheduler::now() + std::chrono::duration_cast<Scheduler::Clock::duration>(duration));
+    }
+
+    // Awaitable counterpart of Device. Every call suspends the calling task until the
+    // request has been through the CommandQueue; no thread blocks on the way.
+    class AsyncDevice {
+    public:
+        class Operation {
+        public:
+            bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                this->handle = handle;
+                scheduler = Scheduler::current();
+                entry.context = this;
+                entry.onComplete = &Operation::complete;
+                queue.submit(entry, lane);
+            }
+
+            Status await_resume() const {
+                return entry.status != Status::kSuccess ? entry.status : entry.request.result();
+            }
+
+        protected:
+            friend class AsyncDevice;
+
+            Operation(CommandQueue& queue, const Device::Request& request, CommandQueue::Lane lane)
+                : queue(queue), entry{}, lane(lane), scheduler(nullptr) {
+                entry.request = request;
+            }
+
+            CommandQueue& queue;
+            CommandQueue::Entry entry;
+            CommandQueue::Lane lane;
+            std::coroutine_handle<> handle;
+            Scheduler* scheduler;
+
+            static void complete(CommandQueue::Entry& entry) {
+                Operation& operation = *static_cast<Operation*>(entry.context);
+                operation.scheduler->post(operation.handle);
+            }
+        };
+
+        class AxesOperation : public Operation {
+        public:
+            Status await_resume() const {
+                if (entry.status != Status::kSuccess) return entry.status;
+
+                memcpy(axes, entry.request.response, entry.request.responseSize);
+                return Status::kSuccess;
+            }
+
+        private:
+            friend class AsyncDevice;
+
+            AxesOperation(CommandQueue& queue, const Device::Request& request, int16_t* axes)
+                : Operation(queue, request, CommandQueue::laneOf(request)), axes(axes) {}
+
+            int16_t* axes;
+        };
+
+        explicit AsyncDevice(CommandQueue& queue) : queue(queue), pathCache(nullptr) {}
+
+        void setPathCache(PathSource* cache) { pathCache = cache; }
+
+        Operation submit(const Device::Request& request) {
+            return Operation(queue, request, CommandQueue::laneOf(request));
+        }
+
+        Operation submit(const Device::Request& request, CommandQueue::Lane lane) {
+            return Operation(queue, request, lane);
+        }
+
+        Operation keyDown(VirtualKeyCode virtualKeyCode) { return submit(Device::Request::keyDown(virtualKeyCode)); }
+        Operation keyUp(VirtualKeyCode virtualKeyCode)   { return submit(Device::Request::keyUp(virtualKeyCode)); }
+        Operation releaseAllKeys()                       { return submit(Device::Request::releaseAllKeys()); }
+
+        Operation sendKeyboardState(const KeyboardState& keyboardState, const KeyboardStateMask& keyboardStateMask) {
+            return submit(Device::Request::sendKeyboardState(keyboardState, keyboardStateMask));
+        }
+
+        Operation buttonDown(Button button) { return submit(Device::Request::buttonDown(button)); }
+        Operation buttonUp(Button button)   { return submit(Device::Request::buttonUp(button)); }
+        Operation releaseAllButtons()       { return submit(Device::Request::releaseAllButtons()); }
+
+        Operation moveRel(int16_t x, int16_t y) { return submit(Device::Request::moveRel(x, y)); }
+        Operation scrollRel(int16_t w)          { return submit(Device::Request::scrollRel(w)); }
+
+        Operation sendRelMouseState(const MouseState& mouseState, MouseStateMask mouseStateMask) {
+            return submit(Device::Request::sendRelMouseState(mouseState, mouseStateMask));
+        }
+
+        Operation moveAbs(int16_t x, int16_t y) { return submit(Device::Request::moveAbs(x, y)); }
+        Operation scrollAbs(int16_t w)          { return submit(Device::Request::scrollAbs(w)); }
+        Operation setPos(int16_t x, int16_t y)  { return submit(Device::Request::setPos(x, y)); }
+
+        Operation sendAbsMouseState(const MouseState& mouseState, MouseStateMask mouseStateMask) {
+            return submit(Device::Request::sendAbsMouseState(mouseState, mouseStateMask));
+        }
+
+        AxesOperation getPos(int16_t (&pos)[2])  { return AxesOperation(queue, Device::Request::getPos(), pos); }
+        AxesOperation getAxes(int16_t (&axes)[3]) { return AxesOperation(queue, Device::Request::getAxes(), axes); }
+
+        Task<Status> movePathRel(int16_t x, int16_t y, uint32_t duration, uint32_t pollingRate, bool isIgnoreErrors,
+                                 LinearPath path) {
+            PathSampler sampler(x, y, duration, pollingRate, path);
+            std::shared_ptr<const PathSource::Deltas> deltas;
+            if (pathCache) deltas = pathCache->lookup(x, y, duration, pollingRate, path);
+
+            Scheduler::Clock::time_point start = Scheduler::now();
+            int32_t lastX = 0, lastY = 0;
+
+            for (uint32_t tick = 1; tick <= sampler.ticks(); ++tick) {
+                PathSource::Delta delta;
+                if (deltas) {
+                    delta = (*deltas)[tick - 1];
+                } else {
+                    int32_t posX, posY;
+                    sampler.at(tick, posX, posY);
+                    delta = { saturateInt16(posX - lastX), saturateInt16(posY - lastY) };
+                    lastX = posX;
+                    lastY = posY;
+                }
+
+                if (delta.x != 0 || delta.y != 0) {
+                    Status status = co_await moveRel(delta.x, delta.y);
+                    if (status != Status::kSuccess && !isIgnoreErrors) co_return status;
+                }
+
+                co_await sleepUntil(start + sampler.elapsed(tick));
+            }
+            co_return Status::kSuccess;
+        }
+
+        Task<Status> movePathRel(int16_t x, int16_t y, uint32_t duration, uint32_t pollingRate, LinearPath path) {
+            return movePathRel(x, y, duration, pollingRate, false, path);
+        }
+
+        Task<Status> movePathRel(int16_t x, int16_t y, uint32_t duration, LinearPath path) {
+            return movePathRel(x, y, duration, 250, false, path);
+        }
+
+        Task<Status> movePathAbs(int16_t x, int16_t y, uint32_t duration, uint32_t pollingRate, bool isIgnoreErrors,
+                                 LinearPath path) {
+            int16_t start[2]{};
+            Status status = co_await getPos(start);
+            if (status != Status::kSuccess) co_return status;
+
+            PathSampler sampler(x - start[0], y - start[1], duration, pollingRate, path);
+            Scheduler::Clock::time_point startTime = Scheduler::now();
+            int32_t lastX = 0, lastY = 0;
+
+            for (uint32_t tick = 1; tick <= sampler.ticks(); ++tick) {
+                int32_t posX, posY;
+                sampler.at(tick, posX, posY);
+
+                if (posX != lastX || posY != lastY) {
+                    status = co_await moveAbs(saturateInt16(start[0] + posX), saturateInt16(start[1] + posY));
+                    if (status != Status::kSuccess && !isIgnoreErrors) co_return status;
+                    lastX = posX;
+                    lastY = posY;
+                }
+
+                co_await sleepUntil(startTime + sampler.elapsed(tick));
+            }
+            co_return Status::kSuccess;
+        }
+
+        Task<Status> movePathAbs(int16_t x, int16_t y, uint32_t duration, uint32_t pollingRate, LinearPath path) {
+            return movePathAbs(x, y, duration, pollingRate, false, path);
+        }
+
+        Task<Status> movePathAbs(int16_t x, int16_t y, uint32_t duration, LinearPath path) {
+            return movePathAbs(x, y, duration, 250, false, path);
+        }
+
+    private:
+        CommandQueue& queue;
+        PathSource* pathCache;
+    };
+};
@@ -0,0 +1,255 @@
+#pragma once
+#include "rx784.hpp"
+#if !defined(RX784_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define RX784_FILTER_SSE2
+#endif
+
+namespace RX784 {
+    // Turns float motion into moveRel deltas. Stages run in the order they are added;
+    // adjacent scale and rotate stages fold into a single 2x2 matrix. The output is
+    // rounded with the fractional remainder carried to the next sample, so slow motion
+    // is not lost, and saturated to int16 once at the very end.
+    //
+    // A batch is consecutive samples of one stream in SoA layout. With SSE2 four samples
+    // go through every stage together; the smoothing recurrence and the remainder carry
+    // are evaluated as in-register prefix scans. A tail of fewer than four takes the
+    // scalar path, which keeps the same state.
+    class MotionFilter {
+    public:
+        MotionFilter() : carryX(0), carryY(0) {}
+
+        MotionFilter& scale(float x, float y) {
+            return transform(x, 0, 0, y);
+        }
+
+        MotionFilter& rotate(float radians) {
+            float c = std::cos(radians), s = std::sin(radians);
+            return transform(c, -s, s, c);
+        }
+
+        // Exponential moving average; alpha = 1 passes samples through unchanged.
+        MotionFilter& smooth(float alpha) {
+            Stage stage{};
+            stage.kind = Kind::kSmooth;
+            stage.alpha = alpha;
+            stage.decay = 1 - alpha;
+            for (size_t i = 0; i < 4; ++i) stage.decayPowers[i] = std::pow(stage.decay, static_cast<float>(i + 1));
+            stages.push_back(stage);
+            return *this;
+        }
+
+        // Drops samples whose length is below `radius`.
+        MotionFilter& deadZone(float radius) {
+            Stage stage{};
+            stage.kind = Kind::kDeadZone;
+            stage.radiusSquared = radius * radius;
+            stages.push_back(stage);
+            return *this;
+        }
+
+        // Multiplies each sample by gain(speed), speed being its length in counts. The curve
+        // is sampled into a Q16 table of kLUTSize entries up to maxSpeed and held flat beyond.
+        MotionFilter& accelerate(const std::function<float(float speed)>& gain, float maxSpeed = 64) {
+            Stage stage{};
+            stage.kind = Kind::kAccelerate;
+            stage.lut = luts.size();
+            stage.indexScale = (kLUTSize - 1) / maxSpeed;
+
+            std::vector<int32_t> lut(kLUTSize);
+            for (size_t i = 0; i < kLUTSize; ++i) {
+                lut[i] = static_cast<int32_t>(std::lround(gain(i / stage.indexScale) * 65536.0f));
+            }
+            luts.push_back(std::move(lut));
+            stages.push_back(stage);
+            return *this;
+        }
+
+        // Forgets the smoothing history and the carried remainder.
+        void reset() {
+            carryX = carryY = 0;
+            for (Stage& stage : stages) stage.lastX = stage.lastY = 0;
+        }
+
+        void process(const float* x, const float* y, int16_t* outX, int16_t* outY, size_t count) {
+#ifdef RX784_FILTER_SSE2
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) processGroup(&x[i], &y[i], &outX[i], &outY[i]);
+            processScalar(&x[i], &y[i], &outX[i], &outY[i], count - i);
+#else
+            processScalar(x, y, outX, outY, count);
+#endif
+        }
+
+        // Reference implementation, one sample at a time.
+        void processScalar(const float* x, const float* y, int16_t* outX, int16_t* outY, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                float vx = x[i], vy = y[i];
+                for (Stage& stage : stages) {
+                    switch (stage.kind)
+                    {
+                    case Kind::kLinear: {
+                        float tx = stage.matrix[0] * vx + stage.matrix[1] * vy;
+                        vy = stage.matrix[2] * vx + stage.matrix[3] * vy;
+                        vx = tx;
+                        break;
+                    }
+                    case Kind::kSmooth:
+                        vx = stage.lastX = stage.alpha * vx + stage.decay * stage.lastX;
+                        vy = stage.lastY = stage.alpha * vy + stage.decay * stage.lastY;
+                        break;
+                    case Kind::kDeadZone:
+                        if (vx * vx + vy * vy < stage.radiusSquared) vx = vy = 0;
+                        break;
+                    case Kind::kAccelerate: {
+                        float gain = luts[stage.lut][lutIndex(stage, std::sqrt(vx * vx + vy * vy))] * (1.0f / 65536);
+                        vx *= gain;
+                        vy *= gain;
+                        break;
+                    }
+                    }
+                }
+                outX[i] = quantize(vx, carryX);
+                outY[i] = quantize(vy, carryY);
+            }
+        }
+
+        // Filters one sample and sends it, skipping empty moves.
+        Status moveRel(Device& device, float x, float y) {
+            int16_t outX, outY;
+            processScalar(&x, &y, &outX, &outY, 1);
+            if (outX == 0 && outY == 0) return Status::kSuccess;
+            return device.moveRel(outX, outY);
+        }
+
+    private:
+        static constexpr size_t kLUTSize = 256;
+        static constexpr float kMaxMagnitude = 65536;  // keeps the running sums exact enough and inside int32
+
+        enum class Kind : uint8_t { kLinear, kSmooth, kDeadZone, kAccelerate };
+
+        struct Stage {
+            Kind kind;
+            float matrix[4];
+            float alpha;
+            float decay;
+            float decayPowers[4];
+            float lastX;
+            float lastY;
+            float radiusSquared;
+            size_t lut;
+            float indexScale;
+        };
+
+        std::vector<Stage> stages;
+        std::vector<std::vector<int32_t>> luts;
+        float carryX;
+        float carryY;
+
+        MotionFilter& transform(float m00, float m01, float m10, float m11) {
+            if (!stages.empty() && stages.back().kind == Kind::kLinear) {
+                float* m = stages.back().matrix;
+                float folded[4] = { m00 * m[0] + m01 * m[2], m00 * m[1] + m01 * m[3],
+                                    m10 * m[0] + m11 * m[2], m10 * m[1] + m11 * m[3] };
+                memcpy(m, folded, sizeof(folded));
+                return *this;
+            }
+
+            Stage stage{};
+            stage.kind = Kind::kLinear;
+            stage.matrix[0] = m00;
+            stage.matrix[1] = m01;
+            stage.matrix[2] = m10;
+            stage.matrix[3] = m11;
+            stages.push_back(stage);
+            return *this;
+        }
+
+        static size_t lutIndex(const Stage& stage, float speed) {
+            return static_cast<size_t>(std::min(speed * stage.indexScale, static_cast<float>(kLUTSize - 1)));
+        }
+
+        static int16_t quantize(float value, float& carry) {
+            float limit = kMaxMagnitude;
+            float sum = carry + std::max(-limit, std::min(limit, value));
+            float rounded = std::nearbyint(sum);
+            carry = sum - rounded;
+            return saturateInt16(static_cast<int32_t>(rounded));
+        }
+
+#ifdef RX784_FILTER_SSE2
+        static __m128 shiftLanes1(__m128 v) { return _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)); }
+        static __m128 shiftLanes2(__m128 v) { return _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)); }
+
+        static float lastLane(__m128 v) { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))); }
+
+        // t[i] = alpha * v[i] + decay * t[i - 1], seeded with `last`.
+        static __m128 smoothLanes(const Stage& stage, __m128 v, float last) {
+            __m128 decay = _mm_set1_ps(stage.decay);
+            __m128 t = _mm_mul_ps(_mm_set1_ps(stage.alpha), v);
+            t = _mm_add_ps(t, _mm_mul_ps(decay, shiftLanes1(t)));
+            t = _mm_add_ps(t, _mm_mul_ps(_mm_mul_ps(decay, decay), shiftLanes2(t)));
+            return _mm_add_ps(t, _mm_mul_ps(_mm_loadu_ps(stage.decayPowers), _mm_set1_ps(last)));
+        }
+
+        // Rounds the running sum and emits its integer steps, carrying what is left over.
+        static __m128i quantizeLanes(__m128 v, float& carry) {
+            __m128 limit = _mm_set1_ps(kMaxMagnitude);
+            v = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), limit), _mm_min_ps(limit, v));
+            v = _mm_add_ps(v, shiftLanes1(v));
+            v = _mm_add_ps(v, shiftLanes2(v));
+            __m128 sum = _mm_add_ps(v, _mm_set1_ps(carry));
+
+            __m128i rounded = _mm_cvtps_epi32(sum);
+            carry = lastLane(_mm_sub_ps(sum, _mm_cvtepi32_ps(rounded)));
+            return _mm_sub_epi32(rounded, _mm_slli_si128(rounded, 4));
+        }
+
+        void processGroup(const float* x, const float* y, int16_t* outX, int16_t* outY) {
+            __m128 vx = _mm_loadu_ps(x), vy = _mm_loadu_ps(y);
+
+            for (Stage& stage : stages) {
+                switch (stage.kind)
+                {
+                case Kind::kLinear: {
+                    __m128 tx = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(stage.matrix[0]), vx), _mm_mul_ps(_mm_set1_ps(stage.matrix[1]), vy));
+                    vy = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(stage.matrix[2]), vx), _mm_mul_ps(_mm_set1_ps(stage.matrix[3]), vy));
+                    vx = tx;
+                    break;
+                }
+                case Kind::kSmooth:
+                    vx = smoothLanes(stage, vx, stage.lastX);
+                    vy = smoothLanes(stage, vy, stage.lastY);
+                    stage.lastX = lastLane(vx);
+                    stage.lastY = lastLane(vy);
+                    break;
+                case Kind::kDeadZone: {
+                    __m128 lengthSquared = _mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy));
+                    __m128 isOutside = _mm_cmpge_ps(lengthSquared, _mm_set1_ps(stage.radiusSquared));
+                    vx = _mm_and_ps(isOutside, vx);
+                    vy = _mm_and_ps(isOutside, vy);
+                    break;
+                }
+                case Kind::kAccelerate: {
+                    __m128 speed = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)));
+                    __m128 index = _mm_min_ps(_mm_mul_ps(speed, _mm_set1_ps(stage.indexScale)), _mm_set1_ps(kLUTSize - 1));
+                    alignas(16) int32_t indices[4];
+                    _mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_cvttps_epi32(index));
+
+                    const int32_t* lut = luts[stage.lut].data();
+                    __m128i fixedGain = _mm_set_epi32(lut[indices[3]], lut[indices[2]], lut[indices[1]], lut[indices[0]]);
+                    __m128 gain = _mm_mul_ps(_mm_cvtepi32_ps(fixedGain), _mm_set1_ps(1.0f / 65536));
+                    vx = _mm_mul_ps(vx, gain);
+                    vy = _mm_mul_ps(vy, gain);
+                    break;
+                }
+                }
+            }
+
+            __m128i packed = _mm_packs_epi32(quantizeLanes(vx, carryX), quantizeLanes(vy, carryY));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(outX), packed);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(outY), _mm_unpackhi_epi64(packed, packed));
+        }
+#endif
+    };
+};
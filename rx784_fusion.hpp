@@ -0,0 +1,246 @@
+#pragma once
+#include "rx784.hpp"
+
+namespace RX784 {
+    // Folds a run of adjacent requests into one masked state packet. Only runs whose
+    // events the host sees in the same order when they arrive together are fused:
+    //
+    //  - moveRel and scrollRel, summed while the totals fit in int16, optionally closed
+    //    by one left, right or middle button change, become a sendRelMouseState. A button
+    //    change that comes before motion is never fused, since one HID report moves the
+    //    pointer before it applies buttons.
+    //  - moveAbs and scrollAbs, the last position winning, optionally closed by one button
+    //    change, become a sendAbsMouseState.
+    //  - keyDown or keyUp events all pressing or all releasing distinct keys, modifiers
+    //    before regular keys, become a sendKeyboardState. Regular keys get the lowest
+    //    free slots in event order, which needs the board's slot layout: keys fuse only
+    //    after releaseAllKeys, reboot or getKeyboardState has passed through observe(),
+    //    and until a plain keyDown or keyUp goes out unfused. While the layout is known,
+    //    a lone key event is also converted, so that it stays known.
+    class CommandFuser {
+    public:
+        CommandFuser() : kind(Kind::kNone), count(0), isKeyboardKnown(false), modifierKeys(0), regularKeys{},
+                         runModifierKeys(0), runRegularKeys{}, modifierMask(0), regularMask(0), isRelease(false),
+                         hasRegularKey(false), axes{}, axesMask(0), buttonMask(0), buttons(0), fused{} {}
+
+        // Starts a run; false if `request` can never be fused.
+        bool begin(const Device::Request& request) {
+            count = 0;
+            kind = kindOf(request);
+            if (kind == Kind::kKeyboard && !isKeyboardKnown) kind = Kind::kNone;
+            if (kind == Kind::kNone) return false;
+
+            runModifierKeys = modifierKeys;
+            memcpy(runRegularKeys, regularKeys, sizeof(regularKeys));
+            modifierMask = regularMask = 0;
+            isRelease = request.cmd == Device::Command::kKeyUp;
+            hasRegularKey = false;
+            memset(axes, 0, sizeof(axes));
+            axesMask = buttonMask = buttons = 0;
+            return append(request);
+        }
+
+        // Adds the next request to the run; false ends the run without taking it.
+        bool append(const Device::Request& request) {
+            bool isTaken = false;
+            switch (kind)
+            {
+            case Kind::kKeyboard:
+                isTaken = appendKey(request);
+                break;
+            case Kind::kRelative:
+            case Kind::kAbsolute:
+                isTaken = appendMouse(request);
+                break;
+            default:
+                break;
+            }
+            if (isTaken) ++count;
+            return isTaken;
+        }
+
+        size_t size() const { return count; }
+
+        // Whether the run should go out as packet() rather than as its single request.
+        bool isWorthSending() const { return count > 1 || kind == Kind::kKeyboard; }
+
+        // The fused packet for the current run.
+        const Device::Request& packet() {
+            fused = Device::Request{};
+            fused.responseSize = sizeof(Status);
+            if (kind == Kind::kKeyboard) {
+                fused.cmd = Device::Command::kSendKeyboardState;
+                fused.dataSize = 10;
+                fused.data[0] = modifierMask;
+                fused.data[1] = regularMask;
+                fused.data[2] = runModifierKeys;
+                memcpy(&fused.data[3], runRegularKeys, sizeof(runRegularKeys));
+            } else {
+                fused.cmd = kind == Kind::kRelative ? Device::Command::kSendRelMouseState : Device::Command::kSendAbsMouseState;
+                fused.dataSize = 8;
+                fused.data[0] = static_cast<uint8_t>(buttonMask | axesMask << 3);
+                fused.data[1] = buttons;
+                for (size_t i = 0; i < 3; ++i) {
+                    int16_t value = static_cast<int16_t>(axes[i]);
+                    memcpy(&fused.data[2 + 2 * i], &value, sizeof(value));
+                }
+            }
+            return fused;
+        }
+
+        // Whether observe() has to see this request's outcome before the next run begins.
+        static bool isObserved(const Device::Request& request) {
+            switch (request.cmd)
+            {
+            case Device::Command::kReboot:
+            case Device::Command::kReleaseAllKeys:
+            case Device::Command::kGetKeyboardState:
+            case Device::Command::kSendKeyboardState:
+            case Device::Command::kKeyDown:
+            case Device::Command::kKeyUp:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        // Keeps the key slot layout in step with what the board acknowledged.
+        void observe(const Device::Request& request, Status status) {
+            bool isDone = status == Status::kSuccess && (request.responseSize != 1 || request.result() == Status::kSuccess);
+            switch (request.cmd)
+            {
+            case Device::Command::kReboot:
+            case Device::Command::kReleaseAllKeys:
+                if (isDone) {
+                    modifierKeys = 0;
+                    memset(regularKeys, 0, sizeof(regularKeys));
+                }
+                isKeyboardKnown = isDone;
+                break;
+            case Device::Command::kGetKeyboardState:
+                if (isDone) {
+                    modifierKeys = request.response[0];
+                    memcpy(regularKeys, &request.response[1], sizeof(regularKeys));
+                }
+                isKeyboardKnown = isDone;
+                break;
+            case Device::Command::kSendKeyboardState:
+                if (!isDone) {
+                    isKeyboardKnown = false;
+                } else if (request.dataSize == 10) {
+                    modifierKeys = static_cast<uint8_t>((modifierKeys & ~request.data[0]) | (request.data[2] & request.data[0]));
+                    for (size_t i = 0; i < 7; ++i) {
+                        if (request.data[1] & (1u << i)) regularKeys[i] = request.data[3 + i];
+                    }
+                }
+                break;
+            case Device::Command::kKeyDown:
+            case Device::Command::kKeyUp:
+                isKeyboardKnown = false;
+                break;
+            default:
+                break;
+            }
+        }
+
+    private:
+        enum class Kind : uint8_t { kNone, kRelative, kAbsolute, kKeyboard };
+
+        Kind kind;
+        size_t count;
+
+        // The board's key slots as last acknowledged, in wire encoding.
+        bool isKeyboardKnown;
+        uint8_t modifierKeys;
+        uint8_t regularKeys[7];
+
+        // The run being built.
+        uint8_t runModifierKeys;
+        uint8_t runRegularKeys[7];
+        uint8_t modifierMask;
+        uint8_t regularMask;
+        bool isRelease;
+        bool hasRegularKey;
+        int32_t axes[3];
+        uint8_t axesMask;
+        uint8_t buttonMask;
+        uint8_t buttons;
+        Device::Request fused;
+
+        static Kind kindOf(const Device::Request& request) {
+            switch (request.cmd)
+            {
+            case Device::Command::kMoveRel:
+            case Device::Command::kScrollRel:
+                return Kind::kRelative;
+            case Device::Command::kMoveAbs:
+            case Device::Command::kScrollAbs:
+                return Kind::kAbsolute;
+            case Device::Command::kKeyDown:
+            case Device::Command::kKeyUp:
+                return request.dataSize == 1 ? Kind::kKeyboard : Kind::kNone;
+            default:
+                return Kind::kNone;
+            }
+        }
+
+        static int16_t int16At(const uint8_t* data, size_t index) {
+            int16_t value;
+            memcpy(&value, &data[index * 2], sizeof(value));
+            return value;
+        }
+
+        bool appendMouse(const Device::Request& request) {
+            if (buttonMask != 0) return false;  // nothing follows the closing button change
+
+            if (request.cmd == Device::Command::kButtonDown || request.cmd == Device::Command::kButtonUp) {
+                if (count == 0 || request.dataSize != 1 || request.data[0] > 2) return false;
+                buttonMask = static_cast<uint8_t>(1u << request.data[0]);
+                buttons = request.cmd == Device::Command::kButtonDown ? buttonMask : 0;
+                return true;
+            }
+            if (kindOf(request) != kind) return false;
+
+            bool isScroll = request.cmd == Device::Command::kScrollRel || request.cmd == Device::Command::kScrollAbs;
+            if (request.dataSize != (isScroll ? 2 : 4)) return false;
+
+            int32_t next[3] = { axes[0], axes[1], axes[2] };
+            size_t first = isScroll ? 2 : 0, last = isScroll ? 3 : 2;
+            for (size_t i = first; i < last; ++i) {
+                int16_t value = int16At(request.data, i - first);
+                next[i] = kind == Kind::kRelative ? next[i] + value : value;
+                if (next[i] < INT16_MIN || next[i] > INT16_MAX) return false;
+            }
+            memcpy(axes, next, sizeof(axes));
+            axesMask |= isScroll ? 0x4 : 0x3;
+            return true;
+        }
+
+        bool appendKey(const Device::Request& request) {
+            if (kindOf(request) != Kind::kKeyboard || (request.cmd == Device::Command::kKeyUp) != isRelease) return false;
+
+            uint8_t key = request.data[0];
+            if (key >= 0xE0 && key <= 0xE7) {
+                uint8_t bit = static_cast<uint8_t>(1u << (key - 0xE0));
+                if (hasRegularKey || (modifierMask & bit)) return false;
+                modifierMask |= bit;
+                runModifierKeys = isRelease ? (runModifierKeys & ~bit) : (runModifierKeys | bit);
+                return true;
+            }
+
+            uint8_t* end = runRegularKeys + sizeof(runRegularKeys);
+            uint8_t* slot = std::find(runRegularKeys, end, key);
+            if (slot != end && (regularMask & (1u << (slot - runRegularKeys)))) return false;  // same key twice
+            if (isRelease) {
+                if (slot != end) *slot = 0;
+            } else if (slot == end) {
+                slot = std::find(runRegularKeys, end, 0);
+                if (slot == end) return false;  // no free slot
+                *slot = key;
+            }
+            if (slot != end) regularMask |= static_cast<uint8_t>(1u << (slot - runRegularKeys));
+            hasRegularKey = true;
+            return true;
+        }
+    };
+};
@@ -0,0 +1,121 @@
+#pragma once
+#include "rx784.hpp"
+#include <condition_variable>
+
+namespace RX784 {
+    // Sends the same request to several boards at once. The frame is encoded once and
+    // written to every port back to back from the calling thread, so the boards receive
+    // it within a few write calls of each other instead of one round trip apart; each
+    // device then has a thread of its own that waits for its reply.
+    //
+    // The devices are owned by the caller, must already be open, and must not be used
+    // by anyone else while a broadcast is in progress.
+    class DeviceGroup {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        struct Report {
+            size_t failures;
+            std::chrono::nanoseconds sendSkew;   // first write started to last write returned
+            std::chrono::nanoseconds replySkew;  // first reply to last reply
+            std::chrono::nanoseconds elapsed;    // the whole broadcast
+        };
+
+        explicit DeviceGroup(const std::vector<Device*>& devices)
+            : members(devices.size()), generation(0), pending(0), isStopping(false) {
+            for (size_t i = 0; i < devices.size(); ++i) {
+                members[i].device = devices[i];
+                members[i].thread = std::thread(&DeviceGroup::gather, this, i);
+            }
+        }
+
+        DeviceGroup(const DeviceGroup&) = delete;
+        DeviceGroup& operator=(const DeviceGroup&) = delete;
+
+        ~DeviceGroup() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                isStopping = true;
+            }
+            start.notify_all();
+            for (Member& member : members) member.thread.join();
+        }
+
+        size_t size() const { return members.size(); }
+
+        // Outcome of the latest broadcast for the device at `index`.
+        Status status(size_t index) const { return members[index].status; }
+        const Device::Request& response(size_t index) const { return members[index].request; }
+
+        Report broadcast(const Device::Request& request) {
+            uint8_t frame[Device::Request::maxFrameSize()];
+            size_t frameSize = request.encode(frame);
+            for (Member& member : members) member.request = request;
+
+            Clock::time_point begin = Clock::now();
+            for (Member& member : members) member.status = member.device->sendFrame(frame, frameSize);
+            Clock::time_point sent = Clock::now();
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                pending = members.size();
+                ++generation;
+                start.notify_all();
+                done.wait(lock, [&] { return pending == 0; });
+            }
+
+            Report report{};
+            Clock::time_point firstReply = Clock::time_point::max(), lastReply = Clock::time_point::min();
+            for (const Member& member : members) {
+                if (member.status != Status::kSuccess) {
+                    ++report.failures;
+                    continue;
+                }
+                firstReply = std::min(firstReply, member.replyTime);
+                lastReply = std::max(lastReply, member.replyTime);
+            }
+            report.sendSkew = sent - begin;
+            report.replySkew = firstReply <= lastReply ? lastReply - firstReply : std::chrono::nanoseconds(0);
+            report.elapsed = Clock::now() - begin;
+            return report;
+        }
+
+    private:
+        struct Member {
+            Device* device;
+            Device::Request request;
+            Status status;
+            Clock::time_point replyTime;
+            std::thread thread;
+        };
+
+        std::vector<Member> members;
+        std::mutex mutex;
+        std::condition_variable start;
+        std::condition_variable done;
+        uint64_t generation;
+        size_t pending;
+        bool isStopping;
+
+        void gather(size_t index) {
+            Member& member = members[index];
+            uint64_t seen = 0;
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    start.wait(lock, [&] { return generation != seen || isStopping; });
+                    if (isStopping) return;
+                    seen = generation;
+                }
+
+                if (member.status == Status::kSuccess) {
+                    member.status = member.device->recvResponse(member.request);
+                    member.replyTime = Clock::now();
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0) done.notify_one();
+            }
+        }
+    };
+};
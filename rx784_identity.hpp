@@ -0,0 +1,162 @@
+#pragma once
+#include "rx784.hpp"
+#include <atomic>
+
+namespace RX784 {
+    // What a board reports to the host as its USB identity. Each field lives in flash,
+    // so every config call costs a flash write.
+    struct HIDIdentity {
+        uint16_t vendorID;
+        uint16_t productID;
+        uint16_t versionNumber;
+        std::string manufacturerString;
+        std::string productString;
+    };
+
+    struct HIDIdentityReport {
+        Status status;
+        uint8_t written;   // fields that differed and were written
+        uint8_t skipped;   // fields that already matched
+        std::chrono::nanoseconds elapsed;
+    };
+
+    struct HIDProvisioningReport {
+        size_t failures;
+        uint64_t written;
+        uint64_t skipped;
+        std::chrono::nanoseconds elapsed;
+        std::vector<HIDIdentityReport> devices;  // in the order the devices were given
+    };
+
+    namespace detail {
+        enum HIDField { kVendorID, kProductID, kVersionNumber, kManufacturerString, kProductString, kHIDFieldCount };
+
+        // Reads every field in `fields` in one pipelined pass. When a send fails, the
+        // responses to the requests already sent are still read off the link, so that the
+        // next request on the device does not take one of them for its own.
+        inline Status readHIDFields(Device& device, const bool (&fields)[kHIDFieldCount], Device::Request (&reads)[kHIDFieldCount]) {
+            static Device::Request (*const kReaders[kHIDFieldCount])() = {
+                Device::Request::getHIDVendorID, Device::Request::getHIDProductID, Device::Request::getHIDVersionNumber,
+                Device::Request::getHIDManufacturerString, Device::Request::getHIDProductString
+            };
+            Status result = Status::kSuccess;
+            size_t sent = 0;
+            for (; sent < kHIDFieldCount; ++sent) {
+                if (!fields[sent]) continue;
+                reads[sent] = kReaders[sent]();
+                result = device.sendRequest(reads[sent]);
+                if (result != Status::kSuccess) break;
+            }
+
+            for (size_t i = 0; i < sent; ++i) {
+                if (!fields[i]) continue;
+                Status status = device.recvResponse(reads[i]);
+                if (status != Status::kSuccess && result == Status::kSuccess) result = status;
+            }
+            return result;
+        }
+
+        inline Status matchesHIDField(const Device::Request& read, HIDField field, const HIDIdentity& profile, bool& isMatch) {
+            if (field >= kManufacturerString) {
+                std::string value;
+                Status status = read.hidString(value);
+                isMatch = value == (field == kManufacturerString ? profile.manufacturerString : profile.productString);
+                return status;
+            }
+            uint16_t value = 0;
+            Status status = read.hidNumber(value);
+            isMatch = value == (field == kVendorID ? profile.vendorID : field == kProductID ? profile.productID : profile.versionNumber);
+            return status;
+        }
+
+        inline bool makeHIDWrite(HIDField field, const HIDIdentity& profile, Device::Request& request) {
+            switch (field)
+            {
+            case kVendorID:
+                request = Device::Request::configHIDVendorID(profile.vendorID);
+                return true;
+            case kProductID:
+                request = Device::Request::configHIDProductID(profile.productID);
+                return true;
+            case kVersionNumber:
+                request = Device::Request::configHIDVersionNumber(profile.versionNumber);
+                return true;
+            case kManufacturerString:
+                return Device::Request::configHIDManufacturerString(profile.manufacturerString, request);
+            case kProductString:
+                return Device::Request::configHIDProductString(profile.productString, request);
+            default:
+                return false;
+            }
+        }
+    };
+
+    // Reads the board's identity in one pipelined pass, writes only the fields that
+    // differ from `profile`, one at a time since each is a flash write, and reads those
+    // back to verify them. A field that reads back wrong fails with kWriteFlashError.
+    inline HIDIdentityReport applyHIDIdentity(Device& device, const HIDIdentity& profile) {
+        using namespace detail;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        HIDIdentityReport report{};
+        Device::Request reads[kHIDFieldCount];
+        bool isDiffering[kHIDFieldCount] = { true, true, true, true, true };
+
+        report.status = readHIDFields(device, isDiffering, reads);
+        for (size_t i = 0; i < kHIDFieldCount && report.status == Status::kSuccess; ++i) {
+            bool isMatch = false;
+            report.status = matchesHIDField(reads[i], static_cast<HIDField>(i), profile, isMatch);
+            isDiffering[i] = !isMatch;
+            if (isMatch) ++report.skipped;
+        }
+
+        for (size_t i = 0; i < kHIDFieldCount && report.status == Status::kSuccess; ++i) {
+            if (!isDiffering[i]) continue;
+            Device::Request write;
+            if (!makeHIDWrite(static_cast<HIDField>(i), profile, write)) {
+                report.status = Status::kInvalidSize;
+                break;
+            }
+            report.status = device.transact(write);
+            if (report.status == Status::kSuccess) report.status = write.result();
+            if (report.status == Status::kSuccess) ++report.written;
+        }
+
+        if (report.status == Status::kSuccess && report.written != 0) {
+            report.status = readHIDFields(device, isDiffering, reads);
+            for (size_t i = 0; i < kHIDFieldCount && report.status == Status::kSuccess; ++i) {
+                if (!isDiffering[i]) continue;
+                bool isMatch = false;
+                report.status = matchesHIDField(reads[i], static_cast<HIDField>(i), profile, isMatch);
+                if (report.status == Status::kSuccess && !isMatch) report.status = Status::kWriteFlashError;
+            }
+        }
+
+        report.elapsed = std::chrono::steady_clock::now() - start;
+        return report;
+    }
+
+    // Provisions many boards at once, `parallelism` at a time.
+    inline HIDProvisioningReport applyHIDIdentity(const std::vector<Device*>& devices, const HIDIdentity& profile,
+                                                  size_t parallelism = 16) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        HIDProvisioningReport report{};
+        report.devices.resize(devices.size());
+
+        std::atomic<size_t> next(0);
+        auto work = [&] {
+            for (size_t i = next++; i < devices.size(); i = next++) report.devices[i] = applyHIDIdentity(*devices[i], profile);
+        };
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < std::min(parallelism, devices.size()); ++i) threads.emplace_back(work);
+        work();
+        for (std::thread& thread : threads) thread.join();
+
+        for (const HIDIdentityReport& device : report.devices) {
+            if (device.status != Status::kSuccess) ++report.failures;
+            report.written += device.written;
+            report.skipped += device.skipped;
+        }
+        report.elapsed = std::chrono::steady_clock::now() - start;
+        return report;
+    }
+};
@@ -0,0 +1,259 @@
+#pragma once
+#include "rx784.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+
+// Puts a faulty link between a Device and its port, to see how the library copes
+// before a real cable does it.
+//
+//     RX784::ImpairedTransport link(42);
+//     link.open("/dev/ttyUSB0");
+//     RX784::ImpairedTransport::Profile profile{};
+//     profile.dropRate = 1e-3;
+//     link.setProfile(RX784::ImpairedTransport::Direction::kToHost, profile);
+//     device.open(link);
+//
+// Each direction has its own profile. Bytes are serialized at the bandwidth cap, then
+// delayed by the latency plus up to `jitter`, drawn afresh whenever the direction has
+// gone idle, so jitter never reorders bytes. Drops, bit flips and stray 0xBE/0xED bytes
+// are decided per byte by a generator per direction, so the same seed hits the same
+// bytes on every run and with every standard library.
+//
+// Bytes to the board are held until they are due and written when the Device next
+// sends or reads, so back-to-back requests overlap their latency as on a real line.
+// Bytes from the board are taken off the port by a reader thread as they arrive. A
+// read gives up when no byte comes due within `timeout` of the last one, like the
+// 50 ms serial timeout, and leaves later bytes to the next read.
+
+namespace RX784 {
+    class ImpairedTransport : public Transport {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        enum class Direction : uint8_t { kToBoard, kToHost };
+
+        struct Profile {
+            std::chrono::microseconds latency;
+            std::chrono::microseconds jitter;
+            uint32_t bytesPerSecond;  // 0 for no cap
+            double dropRate;          // chance that a byte is lost
+            double flipRate;          // chance that a byte has one bit flipped
+            double spuriousRate;      // chance that a stray 0xBE or 0xED comes before a byte
+        };
+
+        struct Stats {
+            uint64_t bytes;     // bytes offered
+            uint64_t dropped;
+            uint64_t flipped;
+            uint64_t inserted;
+        };
+
+        explicit ImpairedTransport(uint64_t seed = 0)
+            : directions{}, timeout(std::chrono::milliseconds(50)), isStopping(false) {
+            reseed(seed);
+        }
+
+        ImpairedTransport(const ImpairedTransport&) = delete;
+        ImpairedTransport& operator=(const ImpairedTransport&) = delete;
+
+        ~ImpairedTransport() { close(); }
+
+        // Impairs a serial port.
+        Status open(const std::string& port) {
+            close();
+            Status status = link.open(port);
+            if (status == Status::kSuccess) start();
+            return status;
+        }
+
+        // Impairs another transport, which must outlive this one.
+        Status open(Transport& transport) {
+            close();
+            Status status = link.open(transport);
+            if (status == Status::kSuccess) start();
+            return status;
+        }
+
+        void setProfile(Direction direction, const Profile& profile) {
+            std::lock_guard<std::mutex> lock(mutex);
+            directions[static_cast<size_t>(direction)].profile = profile;
+        }
+
+        // Restarts the random sequences, so the same faults hit the same bytes again.
+        void reseed(uint64_t seed) {
+            std::lock_guard<std::mutex> lock(mutex);
+            directions[0].random = seed;
+            directions[1].random = seed ^ 0x5DEECE66Dull;
+        }
+
+        void setTimeout(std::chrono::milliseconds timeout) { this->timeout = timeout; }
+
+        Stats getStats(Direction direction) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return directions[static_cast<size_t>(direction)].stats;
+        }
+
+        bool send(const void* buffer, size_t size) override {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                DirectionState& out = directions[static_cast<size_t>(Direction::kToBoard)];
+                Clock::time_point due = schedule(out, size, Clock::now());
+                const uint8_t* bytes = static_cast<const uint8_t*>(buffer);
+                for (size_t i = 0; i < size; ++i) impair(out, bytes[i], due, pendingOut);
+            }
+            return flush(Clock::now());
+        }
+
+        size_t recv(void* buffer, size_t size) override {
+            if (!flush(Clock::time_point::max())) return 0;
+
+            uint8_t* bytes = static_cast<uint8_t*>(buffer);
+            size_t copied = 0;
+            Clock::time_point deadline = Clock::now() + timeout;
+            std::unique_lock<std::mutex> lock(mutex);
+            while (copied < size) {
+                if (pendingIn.empty()) {
+                    if (!arrived.wait_until(lock, deadline, [&] { return !pendingIn.empty(); })) break;
+                    continue;
+                }
+
+                Clock::time_point due = pendingIn.front().due;
+                if (due > Clock::now()) {
+                    lock.unlock();
+                    std::this_thread::sleep_until(std::min(due, deadline));
+                    lock.lock();
+                    if (due > deadline) break;
+                    continue;
+                }
+                bytes[copied++] = pendingIn.front().byte;
+                pendingIn.pop_front();
+                deadline = Clock::now() + timeout;
+            }
+            return copied;
+        }
+
+        bool close() override {
+            if (reader.joinable()) {
+                isStopping = true;
+                reader.join();
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            pendingOut.clear();
+            pendingIn.clear();
+            for (DirectionState& direction : directions) direction.lineFree = direction.lastDue = Clock::time_point{};
+            return link.close() == Status::kSuccess;
+        }
+
+    private:
+        struct Pending {
+            uint8_t byte;
+            Clock::time_point due;
+        };
+
+        struct DirectionState {
+            Profile profile;
+            Stats stats;
+            uint64_t random;
+            Clock::time_point lineFree;  // when the last byte finished serializing
+            Clock::time_point lastDue;
+            std::chrono::nanoseconds delay;
+        };
+
+        Device link;
+        mutable std::mutex mutex;
+        std::condition_variable arrived;
+        DirectionState directions[2];
+        std::deque<Pending> pendingOut;
+        std::deque<Pending> pendingIn;
+        std::chrono::milliseconds timeout;
+        std::atomic<bool> isStopping;
+        std::thread reader;
+
+        void start() {
+            isStopping = false;
+            reader = std::thread(&ImpairedTransport::read, this);
+        }
+
+        // Byte by byte, so each is stamped when it arrived.
+        void read() {
+            DirectionState& in = directions[static_cast<size_t>(Direction::kToHost)];
+            while (!isStopping) {
+                uint8_t byte;
+                if (link.serialRecvSome(&byte, 1) == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                Clock::time_point due = schedule(in, 1, Clock::now());
+                impair(in, byte, due, pendingIn);
+                arrived.notify_one();
+            }
+        }
+
+        // splitmix64
+        static uint64_t next(DirectionState& direction) {
+            uint64_t z = (direction.random += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        static bool chance(DirectionState& direction, double rate) {
+            return rate > 0 && static_cast<double>(next(direction) >> 11) / 9007199254740992.0 < rate;
+        }
+
+        // When `size` bytes that arrived at `now` come out of the far end.
+        static Clock::time_point schedule(DirectionState& direction, size_t size, Clock::time_point now) {
+            const Profile& profile = direction.profile;
+            if (now >= direction.lastDue) {
+                direction.delay = profile.latency;
+                if (profile.jitter.count() > 0) {
+                    uint64_t jitter = static_cast<uint64_t>(std::chrono::nanoseconds(profile.jitter).count());
+                    direction.delay += std::chrono::nanoseconds(next(direction) % jitter);
+                }
+            }
+
+            Clock::time_point sent = std::max(now, direction.lineFree);
+            if (profile.bytesPerSecond != 0) sent += std::chrono::nanoseconds(size * 1000000000ull / profile.bytesPerSecond);
+            direction.lineFree = sent;
+            direction.lastDue = std::max(direction.lastDue, sent + direction.delay);
+            return direction.lastDue;
+        }
+
+        static void impair(DirectionState& direction, uint8_t byte, Clock::time_point due, std::deque<Pending>& pending) {
+            const Profile& profile = direction.profile;
+            ++direction.stats.bytes;
+            if (chance(direction, profile.spuriousRate)) {
+                pending.push_back({ static_cast<uint8_t>(next(direction) & 1 ? 0xBE : 0xED), due });
+                ++direction.stats.inserted;
+            }
+            if (chance(direction, profile.dropRate)) {
+                ++direction.stats.dropped;
+                return;
+            }
+            if (chance(direction, profile.flipRate)) {
+                byte ^= static_cast<uint8_t>(1u << (next(direction) % 8));
+                ++direction.stats.flipped;
+            }
+            pending.push_back({ byte, due });
+        }
+
+        // Writes the bytes for the board that are due by `until`, waiting for them if
+        // `until` is later than now. Only the Device's thread touches pendingOut.
+        bool flush(Clock::time_point until) {
+            uint8_t chunk[256];
+            while (!pendingOut.empty() && pendingOut.front().due <= until) {
+                Clock::time_point due = pendingOut.front().due;
+                size_t size = 0;
+                while (size < sizeof(chunk) && !pendingOut.empty() && pendingOut.front().due == due) {
+                    chunk[size++] = pendingOut.front().byte;
+                    pendingOut.pop_front();
+                }
+                std::this_thread::sleep_until(due);
+                if (!link.serialSend(chunk, size)) return false;
+            }
+            return true;
+        }
+    };
+};
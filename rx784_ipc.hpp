@@ -0,0 +1,305 @@
+#pragma once
+#include "rx784.hpp"
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <linux/futex.h>
+
+// Client side of rx784d (tools/rx784d.cpp), which owns the serial ports so that several
+// processes can share one board. Linux only.
+//
+// A client connects to the daemon's Unix socket once, names a port and gets back a
+// shared-memory SharedRing plus an eventfd. After that every frame goes through the
+// ring: the client publishes a submission, the daemon publishes a completion, and no
+// syscall is made unless the other side has announced that it is about to sleep.
+
+namespace RX784 {
+    inline const char* defaultDaemonSocket() {
+        const char* path = std::getenv("RX784D_SOCKET");
+        return path ? path : "/tmp/rx784d.sock";
+    }
+
+    struct SharedRing {
+        static constexpr uint32_t kCapacity = 64;
+
+        struct Completion {
+            uint32_t slot;  // submission sequence % kCapacity
+            Status status;
+            Device::Request request;
+        };
+
+        // Submissions: written by the client, consumed in order by the daemon.
+        alignas(64) std::atomic<uint32_t> submitHead;
+        alignas(64) std::atomic<uint32_t> submitTail;
+        std::atomic<uint32_t> isDaemonIdle;  // set before the daemon sleeps; ring the eventfd
+
+        // Completions: written by the daemon in the order the device finished them.
+        alignas(64) std::atomic<uint32_t> completeHead;  // also the client's futex word
+        alignas(64) std::atomic<uint32_t> completeTail;
+        std::atomic<uint32_t> isClientWaiting;  // set before the client sleeps; wake the futex
+
+        alignas(64) Device::Request submissions[kCapacity];
+        Completion completions[kCapacity];
+    };
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be plain 32-bit");
+
+    struct DaemonOpenRequest {
+        uint32_t version;
+        char port[256];
+    };
+
+    struct DaemonOpenReply {
+        uint32_t version;
+        Status status;
+    };
+
+    constexpr uint32_t kDaemonProtocolVersion = 1;
+
+    // Process-shared futex on a word inside the ring mapping.
+    inline void futexWait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::nanoseconds timeout) {
+        timespec ts = { static_cast<time_t>(timeout.count() / 1000000000),
+                        static_cast<long>(timeout.count() % 1000000000) };
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+    }
+
+    inline void futexWake(std::atomic<uint32_t>& word) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    // Carries a Device's frames to rx784d. Each frame becomes one submission and each
+    // completion is turned back into the response frame the Device expects to read.
+    // Completions can arrive out of order, since the daemon schedules by lane, so they
+    // are parked by slot and handed out in submission order.
+    class DaemonTransport : public Transport {
+    public:
+        DaemonTransport()
+            : socket(-1), doorbell(-1), ring(nullptr), nextSequence(0), nextResponse(0),
+              isReady{}, frameSize(0), frameOffset(0) {}
+
+        DaemonTransport(const DaemonTransport&) = delete;
+        DaemonTransport& operator=(const DaemonTransport&) = delete;
+
+        ~DaemonTransport() { close(); }
+
+        Status connect(const std::string& port, const std::string& socketPath) {
+            close();
+            DaemonOpenRequest request{};
+            DaemonOpenReply reply{};
+            int fds[2] = { -1, -1 };
+            sockaddr_un address{};
+            void* memory;
+
+            if (port.size() >= sizeof(request.port) || socketPath.size() >= sizeof(address.sun_path)) {
+                return Status::kInvalidSize;
+            }
+
+            socket = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+            if (socket < 0) return Status::kSerialError;
+
+            address.sun_family = AF_UNIX;
+            memcpy(address.sun_path, socketPath.data(), socketPath.size());
+            if (::connect(socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) goto Error;
+
+            request.version = kDaemonProtocolVersion;
+            memcpy(request.port, port.data(), port.size());
+            if (::send(socket, &request, sizeof(request), MSG_NOSIGNAL) != sizeof(request)) goto Error;
+
+            if (!recvReply(reply, fds)) {
+                closeFds(fds);
+                goto Error;
+            }
+            if (reply.status != Status::kSuccess) {
+                closeFds(fds);
+                ::close(socket);
+                socket = -1;
+                return reply.status;
+            }
+
+            memory = mmap(nullptr, sizeof(SharedRing), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+            ::close(fds[0]);
+            if (memory == MAP_FAILED) {
+                ::close(fds[1]);
+                goto Error;
+            }
+
+            ring = static_cast<SharedRing*>(memory);
+            doorbell = fds[1];
+            nextSequence = nextResponse = ring->submitHead.load(std::memory_order_relaxed);
+            return Status::kSuccess;
+        Error:
+            ::close(socket);
+            socket = -1;
+            return Status::kSerialError;
+        }
+
+        // Takes one frame or several back to back, each a submission of its own. The
+        // batch is published to the daemon only once every frame of it has a slot.
+        bool send(const void* buffer, size_t size) override {
+            const uint8_t* packet = static_cast<const uint8_t*>(buffer);
+            if (!ring || size == 0) return false;
+
+            uint32_t sequence = nextSequence;
+            for (size_t offset = 0; offset < size; offset += 4u + packet[offset + 2]) {
+                const uint8_t* at = &packet[offset];
+                if (size - offset < 4 || at[0] != 0xBE || at[2] > size - offset - 4 || at[3 + at[2]] != 0xED) return false;
+                if (sequence - nextResponse >= SharedRing::kCapacity) return false;
+                if (!Device::Request::relay(at[1], &at[3], at[2], ring->submissions[sequence % SharedRing::kCapacity])) return false;
+                ++sequence;
+            }
+            ring->submitHead.store(nextSequence = sequence, std::memory_order_release);
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (ring->isDaemonIdle.load(std::memory_order_relaxed)) {
+                uint64_t one = 1;
+                if (::write(doorbell, &one, sizeof(one)) != sizeof(one)) return false;
+            }
+            return true;
+        }
+
+        size_t recv(void* buffer, size_t size) override {
+            size_t copied = 0;
+            while (copied < size) {
+                if (frameOffset == frameSize && !nextFrame()) break;
+
+                size_t chunk = std::min(size - copied, frameSize - frameOffset);
+                memcpy(static_cast<uint8_t*>(buffer) + copied, &frame[frameOffset], chunk);
+                frameOffset += chunk;
+                copied += chunk;
+            }
+            return copied;
+        }
+
+        bool close() override {
+            if (ring) munmap(ring, sizeof(SharedRing));
+            if (doorbell >= 0) ::close(doorbell);
+            if (socket >= 0) ::close(socket);
+            ring = nullptr;
+            doorbell = socket = -1;
+            frameSize = frameOffset = 0;
+            std::fill(std::begin(isReady), std::end(isReady), false);
+            return true;
+        }
+
+    private:
+        int socket;
+        int doorbell;
+        SharedRing* ring;
+        uint32_t nextSequence;
+        uint32_t nextResponse;
+        SharedRing::Completion pending[SharedRing::kCapacity];
+        bool isReady[SharedRing::kCapacity];
+        uint8_t frame[4 + sizeof(Device::Request::response)];
+        size_t frameSize;
+        size_t frameOffset;
+
+        static void closeFds(int (&fds)[2]) {
+            for (int fd : fds) if (fd >= 0) ::close(fd);
+        }
+
+        bool recvReply(DaemonOpenReply& reply, int (&fds)[2]) {
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+            iovec iov = { &reply, sizeof(reply) };
+            msghdr message{};
+            message.msg_iov = &iov;
+            message.msg_iovlen = 1;
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+
+            if (recvmsg(socket, &message, MSG_CMSG_CLOEXEC) != sizeof(reply)) return false;
+            if (reply.version != kDaemonProtocolVersion) return false;
+
+            cmsghdr* header = CMSG_FIRSTHDR(&message);
+            if (header && header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS &&
+                header->cmsg_len == CMSG_LEN(sizeof(fds))) {
+                memcpy(fds, CMSG_DATA(header), sizeof(fds));
+            }
+            return reply.status != Status::kSuccess || (fds[0] >= 0 && fds[1] >= 0);
+        }
+
+        // Builds the response frame for the oldest outstanding submission. A failed
+        // completion yields no bytes, which the Device reports as a serial error.
+        bool nextFrame() {
+            frameSize = frameOffset = 0;
+            if (!ring || nextResponse == nextSequence) return false;
+
+            uint32_t slot = nextResponse % SharedRing::kCapacity;
+            while (!isReady[slot]) {
+                if (!collect()) return false;
+            }
+            isReady[slot] = false;
+            ++nextResponse;
+
+            const SharedRing::Completion& completion = pending[slot];
+            if (completion.status != Status::kSuccess) return false;
+
+            const Device::Request& request = completion.request;
+            frame[0] = 0xBE;
+            frame[1] = static_cast<uint8_t>(request.cmd);
+            frame[2] = request.responseSize;
+            memcpy(&frame[3], request.response, request.responseSize);
+            frame[3 + request.responseSize] = 0xED;
+            frameSize = 4u + request.responseSize;
+            return true;
+        }
+
+        // Spins briefly, then sleeps on the futex. Fails only once the daemon has gone away.
+        bool collect() {
+            using Clock = std::chrono::steady_clock;
+            uint32_t tail = ring->completeTail.load(std::memory_order_relaxed);
+            uint32_t head = ring->completeHead.load(std::memory_order_acquire);
+
+            Clock::time_point spinEnd = Clock::now() + std::chrono::microseconds(50);
+            while (head == tail && Clock::now() < spinEnd) {
+                head = ring->completeHead.load(std::memory_order_acquire);
+            }
+
+            while (head == tail) {
+                ring->isClientWaiting.store(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                head = ring->completeHead.load(std::memory_order_acquire);
+                if (head == tail) futexWait(ring->completeHead, head, std::chrono::milliseconds(100));
+                ring->isClientWaiting.store(0, std::memory_order_relaxed);
+
+                head = ring->completeHead.load(std::memory_order_acquire);
+                if (head == tail && !isDaemonAlive()) return false;
+            }
+
+            for (; tail != head; ++tail) {
+                const SharedRing::Completion& completion = ring->completions[tail % SharedRing::kCapacity];
+                uint32_t slot = completion.slot % SharedRing::kCapacity;
+                pending[slot] = completion;
+                isReady[slot] = true;
+            }
+            ring->completeTail.store(tail, std::memory_order_release);
+            return true;
+        }
+
+        bool isDaemonAlive() {
+            pollfd pfd = { socket, POLLIN, 0 };
+            return poll(&pfd, 1, 0) == 0;
+        }
+    };
+
+    // A Device that goes through rx784d instead of opening the port itself; every
+    // Device method works unchanged.
+    class ClientDevice : public Device {
+    public:
+        Status open(const std::string& port) {
+            return open(port, defaultDaemonSocket());
+        }
+
+        Status open(const std::string& port, const std::string& socketPath) {
+            Status status = link.connect(port, socketPath);
+            if (status != Status::kSuccess) return status;
+            return Device::open(link);
+        }
+
+    private:
+        DaemonTransport link;
+    };
+};
@@ -0,0 +1,261 @@
+#pragma once
+#include "rx784.hpp"
+#include <condition_variable>
+
+namespace RX784 {
+    // Plays relative paths on a thread of its own, one moveRel per tick, and lets the
+    // caller change its mind while one is running:
+    //
+    //     RX784::PathQueue queue(device);
+    //     queue.append(300, 0, 200, path);    // after whatever is queued
+    //     queue.retarget(0, 200, 200, path);  // instead of it, from where the pointer is now
+    //     queue.wait();
+    //
+    // A path that takes over from a running one starts where the pointer is, and for the
+    // first `blend` of it the velocity the old path had is carried on and eased out, so
+    // the motion bends towards the new target instead of stopping dead. The blend has
+    // died away by the end of the path, which lands on its target as movePathRel would.
+    //
+    // A new path is picked up on the next tick, or at once when the queue is idle, so
+    // retargeting adds at most one tick. Paths are held in a fixed ring; nothing is
+    // allocated after construction. The Device must not be used elsewhere meanwhile.
+    // Ticks are paced by `clock`, which wait() also goes through.
+    class PathQueue {
+    public:
+        static constexpr size_t kCapacity = 16;
+
+        struct Stats {
+            uint64_t paths;                           // paths started
+            uint64_t retargets;                       // paths that cut a running one short
+            uint64_t ticks;
+            uint64_t moves;                           // moveRel packets sent
+            uint64_t errors;                          // moveRel packets that failed; the motion goes on
+            int32_t maxVelocityStep;                  // largest tick-to-tick change of a delta, in pixels
+            std::chrono::nanoseconds maxPickupDelay;  // longest retarget, or append to an idle queue, to its first tick
+        };
+
+        explicit PathQueue(Device& device, uint32_t pollingRate = 250,
+                           std::chrono::milliseconds blend = std::chrono::milliseconds(48), Clock& clock = steadyClock())
+            : device(device), clock(clock), pollingRate(std::max<uint32_t>(1, pollingRate)),
+              blendTicks(static_cast<uint32_t>(blend.count() * this->pollingRate / 1000)),
+              period(std::chrono::nanoseconds(1000000000ull / this->pollingRate)),
+              ring{}, head(0), count(0), replacement{}, hasReplacement(false), tailX(0), tailY(0),
+              positionX(0), positionY(0), isRunning(false), isStopping(false), stats{},
+              sampler(0, 0, 0, this->pollingRate, LinearPath{}), tick(0), originX(0), originY(0),
+              blendX(0), blendY(0), blendLength(0), lastDeltaX(0), lastDeltaY(0) {
+            clock.attach();
+            thread = std::thread(&PathQueue::run, this);
+        }
+
+        PathQueue(const PathQueue&) = delete;
+        PathQueue& operator=(const PathQueue&) = delete;
+
+        ~PathQueue() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                isStopping = true;
+            }
+            clock.notifyOne(condition);
+            thread.join();
+            clock.detach();
+        }
+
+        // Replaces the running path and everything queued with a move of (x, y) from
+        // where the pointer is now.
+        void retarget(int16_t x, int16_t y, uint32_t duration, const LinearPath& path) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                tailX = positionX + x;
+                tailY = positionY + y;
+                replacement = { tailX, tailY, duration, path, clock.now() };
+                hasReplacement = true;
+                head = count = 0;
+            }
+            clock.notifyOne(condition);
+        }
+
+        // Queues a move of (x, y) from where the last queued path ends. Returns false,
+        // and queues nothing, when kCapacity paths are already waiting.
+        bool append(int16_t x, int16_t y, uint32_t duration, const LinearPath& path) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (count == kCapacity) return false;
+                tailX += x;
+                tailY += y;
+                ring[(head + count) % kCapacity] = { tailX, tailY, duration, path, clock.now() };
+                ++count;
+            }
+            clock.notifyOne(condition);
+            return true;
+        }
+
+        // Drops every path; the pointer stops on the next tick, where it is.
+        void cancel() {
+            std::lock_guard<std::mutex> lock(mutex);
+            head = count = 0;
+            hasReplacement = false;
+            isRunning = false;
+            tailX = positionX;
+            tailY = positionY;
+        }
+
+        // Blocks until the last path has played out.
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex);
+            clock.wait(lock, idle, [&] { return !isRunning && !hasReplacement && count == 0; });
+        }
+
+        // Where the queue has put the pointer, counted from where it was at construction.
+        void getPosition(int32_t& x, int32_t& y) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            x = positionX;
+            y = positionY;
+        }
+
+        Stats getStats() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return stats;
+        }
+
+        void resetStats() {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats = Stats{};
+        }
+
+    private:
+        // Target in the queue's own coordinates, so a queued path does not depend on how
+        // far the one before it got.
+        struct Segment {
+            int32_t targetX;
+            int32_t targetY;
+            uint32_t duration;
+            LinearPath path;
+            Clock::time_point submitted;
+        };
+
+        Device& device;
+        Clock& clock;
+        const uint32_t pollingRate;
+        const uint32_t blendTicks;
+        const Clock::duration period;
+
+        mutable std::mutex mutex;
+        std::condition_variable condition;
+        std::condition_variable idle;
+        Segment ring[kCapacity];
+        size_t head;
+        size_t count;
+        Segment replacement;
+        bool hasReplacement;
+        int32_t tailX;
+        int32_t tailY;
+        int32_t positionX;
+        int32_t positionY;
+        bool isRunning;
+        bool isStopping;
+        Stats stats;
+
+        // The running path; only the queue's thread touches these.
+        PathSampler sampler;
+        uint32_t tick;
+        int32_t originX;
+        int32_t originY;
+        double blendX;  // velocity carried over from the path before, less the new path's own
+        double blendY;
+        uint32_t blendLength;
+        int32_t lastDeltaX;
+        int32_t lastDeltaY;
+
+        std::thread thread;
+
+        void start(const Segment& segment) {
+            originX = positionX;
+            originY = positionY;
+            sampler = PathSampler(segment.targetX - originX, segment.targetY - originY, segment.duration, pollingRate,
+                                  segment.path);
+            tick = 0;
+
+            int32_t firstX, firstY;
+            sampler.at(1, firstX, firstY);
+            blendLength = std::min(blendTicks, sampler.ticks());
+            blendX = blendLength >= 2 ? lastDeltaX - firstX : 0;
+            blendY = blendLength >= 2 ? lastDeltaY - firstY : 0;
+            isRunning = true;
+            ++stats.paths;
+        }
+
+        // Eases from slope 1 at the start of the blend to 0 at its end, where it is 0 too.
+        double blendAt(uint32_t tick) const {
+            if (tick >= blendLength) return 0;
+            double remaining = 1 - static_cast<double>(tick) / blendLength;
+            return tick * remaining * remaining;
+        }
+
+        void run() {
+            Clock::time_point next = clock.now();
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                if (!isRunning && !hasReplacement && count == 0) {
+                    lastDeltaX = lastDeltaY = 0;
+                    clock.notifyAll(idle);
+                    clock.wait(lock, condition, [&] { return isStopping || hasReplacement || count != 0; });
+                    next = clock.now();
+                }
+                if (isStopping) return;
+
+                Clock::time_point now = clock.now();
+                if (hasReplacement) {
+                    if (isRunning) ++stats.retargets;
+                    stats.maxPickupDelay = std::max<std::chrono::nanoseconds>(stats.maxPickupDelay, now - replacement.submitted);
+                    hasReplacement = false;
+                    start(replacement);
+                } else if (!isRunning || tick == sampler.ticks()) {
+                    if (count == 0) {
+                        isRunning = false;
+                        continue;
+                    }
+                    if (!isRunning) {
+                        stats.maxPickupDelay = std::max<std::chrono::nanoseconds>(stats.maxPickupDelay, now - ring[head].submitted);
+                    }
+                    start(ring[head]);
+                    head = (head + 1) % kCapacity;
+                    --count;
+                }
+
+                int32_t posX, posY;
+                sampler.at(++tick, posX, posY);
+                double carried = blendAt(tick);
+                int32_t deltaX = originX + posX + static_cast<int32_t>(std::lround(blendX * carried)) - positionX;
+                int32_t deltaY = originY + posY + static_cast<int32_t>(std::lround(blendY * carried)) - positionY;
+                int16_t moveX = saturateInt16(deltaX), moveY = saturateInt16(deltaY);
+
+                Status status = Status::kSuccess;
+                if (moveX != 0 || moveY != 0) {
+                    lock.unlock();
+                    status = device.moveRel(moveX, moveY);
+                    lock.lock();
+                    ++stats.moves;
+                    if (status != Status::kSuccess) ++stats.errors;
+                }
+
+                // A failed packet is not retried; the next delta is taken from where the
+                // pointer should be, so it makes up the loss.
+                if (status == Status::kSuccess) {
+                    positionX += moveX;
+                    positionY += moveY;
+                }
+                ++stats.ticks;
+                stats.maxVelocityStep = std::max(stats.maxVelocityStep,
+                                                 std::max(std::abs(moveX - lastDeltaX), std::abs(moveY - lastDeltaY)));
+                lastDeltaX = moveX;
+                lastDeltaY = moveY;
+                if (!hasReplacement && count == 0 && tick == sampler.ticks()) isRunning = false;
+
+                next += period;
+                lock.unlock();
+                clock.sleepUntil(next);
+                lock.lock();
+            }
+        }
+    };
+};
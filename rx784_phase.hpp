@@ -0,0 +1,113 @@
+#pragma once
+#include "rx784.hpp"
+#include <random>
+
+namespace RX784 {
+    // The host polls the board's HID endpoint at a fixed interval, so a command that
+    // arrives just after a poll is not seen for almost a whole interval. calibratePollPhase
+    // recovers that interval and its phase from the sawtooth it leaves in probe round trips.
+    // The probes are timed on the device's clock (Device::setClock), which should be the
+    // one the CommandQueue given the phase runs on.
+    struct PollPhase {
+        using Clock = RX784::Clock;
+
+        std::chrono::nanoseconds interval;       // host polling interval
+        Clock::time_point anchor;                // a send instant that reaches the board right at a poll
+        std::chrono::nanoseconds oneWayLatency;  // half of the round trip without poll wait
+        std::chrono::nanoseconds jitter;         // spread of the round trip around the fitted sawtooth
+        std::chrono::nanoseconds meanPollWait;   // what an unaligned command waits for its poll on average
+        double fit;                              // share of round-trip variance explained by the sawtooth
+
+        // Below this fit the sawtooth is not told apart from jitter, and aligning to it
+        // only holds commands back.
+        static constexpr double kMinFit = 0.5;
+
+        bool isUsable() const { return fit >= kMinFit; }
+
+        std::chrono::nanoseconds phase() const {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(anchor.time_since_epoch()) % interval;
+        }
+
+        // Time saved per command by sending it `margin` ahead of a poll instead of at random.
+        std::chrono::nanoseconds savedLatency(std::chrono::nanoseconds margin) const {
+            return std::max(std::chrono::nanoseconds(0), meanPollWait - margin);
+        }
+
+        // Earliest instant at or after `now` from which a command arrives `margin` before a poll.
+        Clock::time_point nextSendTime(Clock::time_point now, std::chrono::nanoseconds margin) const {
+            auto offset = std::chrono::duration_cast<std::chrono::nanoseconds>(anchor - margin - now) % interval;
+            if (offset.count() < 0) offset += interval;
+            return now + offset;
+        }
+    };
+
+    inline Status calibratePollPhase(Device& device, PollPhase& phase, size_t probeCount = 256) {
+        using Clock = PollPhase::Clock;
+        Clock& clock = device.getClock();
+        static const std::chrono::nanoseconds kIntervals[] = {
+            std::chrono::microseconds(125), std::chrono::microseconds(250), std::chrono::microseconds(500),
+            std::chrono::milliseconds(1), std::chrono::milliseconds(2), std::chrono::milliseconds(4),
+            std::chrono::milliseconds(8)
+        };
+        const size_t kPhaseSteps = 128;
+
+        std::vector<double> sendTimes(probeCount), roundTrips(probeCount);
+        std::minstd_rand random(784);
+        Clock::time_point origin = clock.now();
+
+        for (size_t i = 0; i < probeCount; ++i) {
+            Device::Request request = Device::Request::getAxes();
+            Clock::time_point sent = clock.now();
+            Status status = device.transact(request);
+            if (status != Status::kSuccess) return status;
+            Clock::time_point received = clock.now();
+
+            sendTimes[i]  = std::chrono::duration<double, std::nano>(sent - origin).count();
+            roundTrips[i] = std::chrono::duration<double, std::nano>(received - sent).count();
+
+            // The offsets only need to be spread over the intervals, not exact, so sleep.
+            clock.sleepFor(std::chrono::nanoseconds(random() % 8000000));
+        }
+
+        double mean = 0, variance = 0;
+        for (double roundTrip : roundTrips) mean += roundTrip / probeCount;
+        for (double roundTrip : roundTrips) variance += (roundTrip - mean) * (roundTrip - mean) / probeCount;
+
+        double bestVariance = INFINITY, bestPhase = 0, bestBase = mean, bestWait = 0;
+        std::chrono::nanoseconds bestInterval = kIntervals[0];
+
+        for (std::chrono::nanoseconds candidate : kIntervals) {
+            double interval = static_cast<double>(candidate.count());
+            for (size_t step = 0; step < kPhaseSteps; ++step) {
+                double theta = interval * step / kPhaseSteps;
+                double residualMean = 0, residualSquares = 0, waitMean = 0;
+
+                for (size_t i = 0; i < probeCount; ++i) {
+                    double wait = std::fmod(theta - sendTimes[i], interval);
+                    if (wait < 0) wait += interval;
+                    double residual = roundTrips[i] - wait;
+                    residualMean += residual / probeCount;
+                    residualSquares += residual * residual / probeCount;
+                    waitMean += wait / probeCount;
+                }
+
+                double residualVariance = residualSquares - residualMean * residualMean;
+                if (residualVariance < bestVariance) {
+                    bestVariance = residualVariance;
+                    bestPhase = theta;
+                    bestBase = residualMean;
+                    bestWait = waitMean;
+                    bestInterval = candidate;
+                }
+            }
+        }
+
+        phase.interval      = bestInterval;
+        phase.anchor        = origin + std::chrono::nanoseconds(static_cast<int64_t>(bestPhase));
+        phase.oneWayLatency = std::chrono::nanoseconds(static_cast<int64_t>(std::max(0.0, bestBase) / 2));
+        phase.jitter        = std::chrono::nanoseconds(static_cast<int64_t>(std::sqrt(std::max(0.0, bestVariance))));
+        phase.meanPollWait  = std::chrono::nanoseconds(static_cast<int64_t>(bestWait));
+        phase.fit           = variance > 0 ? std::max(0.0, 1 - bestVariance / variance) : 0;
+        return Status::kSuccess;
+    }
+};
@@ -0,0 +1,764 @@
+#pragma once
+#include "rx784.hpp"
+#include "rx784_phase.hpp"
+#include "rx784_fusion.hpp"
+#include <mutex>
+#include <condition_variable>
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+namespace RX784 {
+    // Log-linear latency buckets: four per power of two, so a reported percentile is at
+    // most 25% above the true value. Fixed size, no allocation.
+    class LatencyHistogram {
+    public:
+        LatencyHistogram() : counts{}, total(0), maxValue(0) {}
+
+        void record(std::chrono::nanoseconds latency) {
+            uint64_t value = latency.count() > 0 ? static_cast<uint64_t>(latency.count()) : 0;
+            ++counts[bucketOf(value)];
+            ++total;
+            maxValue = std::max(maxValue, value);
+        }
+
+        void merge(const LatencyHistogram& other) {
+            for (size_t i = 0; i < kBucketCount; ++i) counts[i] += other.counts[i];
+            total += other.total;
+            maxValue = std::max(maxValue, other.maxValue);
+        }
+
+        uint64_t count() const { return total; }
+        std::chrono::nanoseconds maximum() const { return std::chrono::nanoseconds(maxValue); }
+
+        // Upper bound of the bucket holding the given fraction (0.99 for p99) of samples.
+        std::chrono::nanoseconds percentile(double fraction) const {
+            uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * total));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < kBucketCount; ++i) {
+                seen += counts[i];
+                if (seen != 0 && seen >= rank) return std::chrono::nanoseconds(std::min(upperBound(i), maxValue));
+            }
+            return std::chrono::nanoseconds(maxValue);
+        }
+
+    private:
+        static constexpr size_t kSubBuckets = 4;
+        static constexpr size_t kBucketCount = 64 * kSubBuckets;
+
+        uint64_t counts[kBucketCount];
+        uint64_t total;
+        uint64_t maxValue;
+
+        static size_t bucketOf(uint64_t value) {
+            if (value < kSubBuckets) return static_cast<size_t>(value);
+            size_t exponent = log2Floor(value);
+            size_t sub = static_cast<size_t>(value >> (exponent - 2)) & (kSubBuckets - 1);
+            return (exponent - 1) * kSubBuckets + sub;
+        }
+
+        static uint64_t upperBound(size_t bucket) {
+            if (bucket < kSubBuckets) return bucket;
+            size_t exponent = bucket / kSubBuckets + 1;
+            uint64_t lower = static_cast<uint64_t>(kSubBuckets + bucket % kSubBuckets) << (exponent - 2);
+            return lower + (uint64_t(1) << (exponent - 2)) - 1;
+        }
+
+        static size_t log2Floor(uint64_t value) {
+#if defined(__GNUC__)
+            return 63 - static_cast<size_t>(__builtin_clzll(value));
+#else
+            size_t exponent = 0;
+            while (value >>= 1) ++exponent;
+            return exponent;
+#endif
+        }
+    };
+
+    // What a request and its reply cost on an 8N1 link: a frame of 4 + dataSize bytes
+    // each way, ten bits a byte. A variable-size reply is costed at its largest.
+    class WireBudget {
+    public:
+        explicit WireBudget(uint32_t baudRate = 250000) : baudRate(std::max<uint32_t>(1, baudRate)) {}
+
+        uint32_t getBaudRate() const { return baudRate; }
+
+        std::chrono::nanoseconds frameTime(size_t bytes) const {
+            return std::chrono::nanoseconds(bytes * 10 * 1000000000ull / baudRate);
+        }
+
+        std::chrono::nanoseconds cost(const Device::Request& request) const {
+            size_t reply = request.isVariableResponse ? sizeof(request.response) : request.responseSize;
+            return frameTime(4u + request.dataSize) + frameTime(4u + reply);
+        }
+
+    private:
+        uint32_t baudRate;
+    };
+
+    // Runs requests against a Device on a dedicated I/O thread. Entries are owned by
+    // the caller and must stay alive until onComplete has been called.
+    //
+    // Requests wait in one of three lanes. Whenever the link is free the oldest entry of
+    // the highest non-empty lane goes next, so a release overtakes queued motion at the
+    // next packet boundary while each lane stays FIFO.
+    //
+    // Entries marked isPollAligned are held until they will reach the board just ahead
+    // of the next host poll, once a PollPhase has been installed with setPollPhase. A
+    // calibration that found no clear sawtooth is refused and nothing is held.
+    //
+    // setLatencyMode opts the I/O thread into trading a core for tail latency; the
+    // latency histogram covers both modes so the two can be compared.
+    //
+    // With setFusion(true), a run of adjacent entries in one lane that a CommandFuser
+    // can fold goes out as one state packet; every entry of the run completes with that
+    // packet's status. Poll-aligned entries are never fused.
+    //
+    // setCoalescing opts into writing several frames at once: entries already waiting
+    // when the link comes free go out together, and while commands arrive closer
+    // together than maxDelay the first frame is held up to that long for more to join
+    // it. A command that follows a quiet spell longer than maxDelay is never held. The
+    // responses are then read in order, so a batch is committed once written and an
+    // urgent entry waits for it as it would for a single packet.
+    //
+    // Every entry is costed in wire time as it is submitted (see WireBudget), which gives
+    // an estimate of how long a new entry would wait and of how busy the link is. The
+    // estimate is scaled by how much longer than their wire time frames have recently
+    // taken from write to reply, so it covers the board's turnaround as well. The
+    // budget's maxDelay is the credit producers may draw on: trySubmit refuses an entry
+    // whose reply is not expected back within it, unless nothing is queued ahead of it or
+    // in flight, submitWhenCredited waits until it is, and submitDroppingOldest makes
+    // room by failing the oldest queued motion with kSerialError, leaving button changes
+    // and other bulk entries queued. Plain submit ignores the credit.
+    //
+    // Holds, poll alignment and the delays in the stats all read `clock`.
+    class CommandQueue {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        enum class Lane : uint8_t {
+            kControl,   // releaseAll*, reboot
+            kDiscrete,  // key and button events, queries, configuration
+            kBulk       // motion and scrolling
+        };
+
+        struct LaneStats {
+            uint64_t count;
+            size_t depth;
+            std::chrono::nanoseconds totalDelay;
+            std::chrono::nanoseconds maxDelay;
+        };
+
+        struct FusionStats {
+            uint64_t packets;  // fused packets sent
+            uint64_t saved;    // packets that did not have to be sent
+        };
+
+        struct Coalescing {
+            std::chrono::nanoseconds maxDelay;  // longest the first frame of a batch is held
+            size_t maxBytes;                    // write as soon as this many bytes wait; 0 turns coalescing off
+        };
+
+        static constexpr size_t kMaxBatch = Device::Request::maxBatchFrames();
+
+        struct BatchStats {
+            uint64_t writes;
+            uint64_t frames;
+            uint64_t sizes[kMaxBatch];  // sizes[n - 1]: writes that carried n frames
+        };
+
+        struct Budget {
+            uint32_t baudRate;
+            std::chrono::nanoseconds maxDelay;  // longest an entry may expect to wait for its reply
+        };
+
+        struct BudgetStats {
+            double utilization;                // share of the link's time spent on frames, over about 100 ms
+            std::chrono::nanoseconds backlog;  // estimated time to clear everything queued or in flight
+            double serviceRatio;               // write-to-reply time over wire time, at least 1
+            uint64_t rejected;                 // refused by trySubmit or a submitWhenCredited that timed out
+            uint64_t waited;                   // submitWhenCredited calls that had to wait
+            uint64_t dropped;                  // motion failed by submitDroppingOldest
+        };
+
+        struct LatencyMode {
+            int cpu;                              // core to pin the I/O thread to, -1 for any
+            int priority;                         // SCHED_FIFO priority, 0 for the normal scheduler
+            bool isMemoryLocked;                  // mlockall, so no page fault lands on the I/O path
+            std::chrono::nanoseconds spinBudget;  // see Device::setSpinBudget
+        };
+
+        struct Entry {
+            Device::Request request;
+            Status status;
+            void (*onComplete)(Entry& entry);
+            void* context;
+            Entry* next;
+            Lane lane;
+            bool isPollAligned;
+            Clock::time_point enqueueTime;
+            std::chrono::nanoseconds wireTime;
+        };
+
+        explicit CommandQueue(Device& device, RX784::Clock& clock = steadyClock())
+            : device(device), clock(clock), lanes{}, stats{}, pollPhase{}, pollMargin(0), hasPollPhase(false), spinBudget(0),
+              isMemoryLocked(false), isFusing(false), fusionStats{}, coalescing{}, batchStats{}, lastArrival{},
+              lastGap(0), meanGap(0), budget{ 250000, std::chrono::milliseconds(10) }, queuedWire{}, inFlightWire(0),
+              busyTime(0), busyStamp{}, serviceRatio(1), creditWaiters(0), budgetStats{}, units{}, frames{}, isStopping(false) {
+            clock.attach();
+            thread = std::thread(&CommandQueue::run, this);
+        }
+
+        CommandQueue(const CommandQueue&) = delete;
+        CommandQueue& operator=(const CommandQueue&) = delete;
+
+        ~CommandQueue() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                isStopping = true;
+            }
+            clock.notifyOne(condition);
+            thread.join();
+            clock.detach();
+        }
+
+        RX784::Clock& getClock() const { return clock; }
+
+        static Lane laneOf(const Device::Request& request) {
+            switch (request.cmd)
+            {
+            case Device::Command::kReboot:
+            case Device::Command::kReleaseAllKeys:
+            case Device::Command::kReleaseAllButtons:
+                return Lane::kControl;
+            case Device::Command::kMoveRel:
+            case Device::Command::kScrollRel:
+            case Device::Command::kSendRelMouseState:
+            case Device::Command::kMoveAbs:
+            case Device::Command::kScrollAbs:
+            case Device::Command::kSetPos:
+            case Device::Command::kSetWheelAxis:
+            case Device::Command::kSetAxes:
+            case Device::Command::kSendAbsMouseState:
+                return Lane::kBulk;
+            default:
+                return Lane::kDiscrete;
+            }
+        }
+
+        // Whether `request` only moves the pointer or wheel: a move or scroll, or a mouse
+        // state packet that changes no button. Such a request can be lost without leaving
+        // anything held on the board.
+        static bool isMotion(const Device::Request& request) {
+            switch (request.cmd)
+            {
+            case Device::Command::kMoveRel:
+            case Device::Command::kScrollRel:
+            case Device::Command::kMoveAbs:
+            case Device::Command::kScrollAbs:
+                return true;
+            case Device::Command::kSendRelMouseState:
+            case Device::Command::kSendAbsMouseState:
+                return (request.data[0] & 0x07) == 0;  // MouseStateMask::Buttons
+            default:
+                return false;
+            }
+        }
+
+        void submit(Entry& entry) {
+            submit(entry, laneOf(entry.request));
+        }
+
+        void submit(Entry& entry, Lane lane) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                enqueue(entry, lane);
+            }
+            clock.notifyOne(condition);
+        }
+
+        bool trySubmit(Entry& entry) {
+            return trySubmit(entry, laneOf(entry.request));
+        }
+
+        // Submits only if the entry's reply is expected back within the budget's maxDelay.
+        bool trySubmit(Entry& entry, Lane lane) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!hasCredit(entry, lane)) {
+                    ++budgetStats.rejected;
+                    return false;
+                }
+                enqueue(entry, lane);
+            }
+            clock.notifyOne(condition);
+            return true;
+        }
+
+        bool submitWhenCredited(Entry& entry, Clock::time_point deadline = Clock::time_point::max()) {
+            return submitWhenCredited(entry, laneOf(entry.request), deadline);
+        }
+
+        // Waits until trySubmit would succeed, or returns false at `deadline`.
+        bool submitWhenCredited(Entry& entry, Lane lane, Clock::time_point deadline = Clock::time_point::max()) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (!hasCredit(entry, lane)) {
+                    ++budgetStats.waited;
+                    ++creditWaiters;
+                    bool isCredited = clock.waitUntil(lock, credited, deadline, [&] { return hasCredit(entry, lane); });
+                    --creditWaiters;
+                    if (!isCredited) {
+                        ++budgetStats.rejected;
+                        return false;
+                    }
+                }
+                enqueue(entry, lane);
+            }
+            clock.notifyOne(condition);
+            return true;
+        }
+
+        // Submits into the bulk lane after failing its oldest motion (see isMotion), on the
+        // calling thread, until the new entry fits the budget or no motion is left queued.
+        // Other bulk entries, such as setPos or a button change, are never dropped.
+        void submitDroppingOldest(Entry& entry) {
+            Entry* dropped = nullptr;
+            Entry** last = &dropped;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                Fifo& fifo = lanes[static_cast<size_t>(Lane::kBulk)];
+                Entry* previous = nullptr;
+                for (Entry* oldest = fifo.head; oldest && !hasCredit(entry, Lane::kBulk); ) {
+                    Entry* next = oldest->next;
+                    if (!isMotion(oldest->request)) {
+                        previous = oldest;
+                        oldest = next;
+                        continue;
+                    }
+                    (previous ? previous->next : fifo.head) = next;
+                    if (fifo.tail == oldest) fifo.tail = previous;
+                    --stats[static_cast<size_t>(Lane::kBulk)].depth;
+                    queuedWire[static_cast<size_t>(Lane::kBulk)] -= oldest->wireTime;
+                    ++budgetStats.dropped;
+
+                    oldest->next = nullptr;
+                    *last = oldest;
+                    last = &oldest->next;
+                    oldest = next;
+                }
+                enqueue(entry, Lane::kBulk);
+            }
+            clock.notifyOne(condition);
+
+            while (dropped) {
+                Entry* next = dropped->next;
+                dropped->status = Status::kSerialError;
+                dropped->onComplete(*dropped);
+                dropped = next;
+            }
+        }
+
+        // How long an entry submitted into `lane` now would wait before it is written:
+        // the time of what is in flight and of everything queued ahead of it.
+        std::chrono::nanoseconds estimateDelay(Lane lane) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return delayAhead(lane);
+        }
+
+        void setBudget(const Budget& budget) {
+            std::lock_guard<std::mutex> lock(mutex);
+            this->budget = budget;
+            wire = WireBudget(budget.baudRate);
+            clock.notifyAll(credited);
+        }
+
+        BudgetStats getBudgetStats() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            BudgetStats current = budgetStats;
+            current.utilization = decayedBusyTime(clock.now()) / kBusyWindow;
+            current.backlog = delayAhead(Lane::kBulk);
+            current.serviceRatio = serviceRatio;
+            return current;
+        }
+
+        void resetBudgetStats() {
+            std::lock_guard<std::mutex> lock(mutex);
+            budgetStats = BudgetStats{};
+        }
+
+        // Blocking convenience for callers that are not event driven.
+        Status execute(Device::Request& request) {
+            return execute(request, laneOf(request));
+        }
+
+        Status execute(Device::Request& request, Lane lane) {
+            struct Waiter {
+                std::mutex mutex;
+                std::condition_variable condition;
+                RX784::Clock* clock;
+                bool isDone = false;
+            } waiter;
+            waiter.clock = &clock;
+
+            Entry entry{};
+            entry.request = request;
+            entry.context = &waiter;
+            entry.onComplete = [](Entry& entry) {
+                Waiter& waiter = *static_cast<Waiter*>(entry.context);
+                std::lock_guard<std::mutex> lock(waiter.mutex);
+                waiter.isDone = true;
+                waiter.clock->notifyOne(waiter.condition);
+            };
+            submit(entry, lane);
+
+            std::unique_lock<std::mutex> lock(waiter.mutex);
+            clock.wait(lock, waiter.condition, [&] { return waiter.isDone; });
+            request = entry.request;
+            return entry.status;
+        }
+
+        // Returns false, and leaves poll-aligned entries unheld, when the calibration is
+        // not usable (fit below PollPhase::kMinFit).
+        bool setPollPhase(const PollPhase& phase, std::chrono::nanoseconds margin) {
+            std::lock_guard<std::mutex> lock(mutex);
+            hasPollPhase = phase.isUsable();
+            if (!hasPollPhase) return false;
+            pollPhase = phase;
+            pollMargin = margin;
+            return true;
+        }
+
+        void clearPollPhase() {
+            std::lock_guard<std::mutex> lock(mutex);
+            hasPollPhase = false;
+        }
+
+        LaneStats laneStats(Lane lane) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return stats[static_cast<size_t>(lane)];
+        }
+
+        void setFusion(bool isEnabled) {
+            std::lock_guard<std::mutex> lock(mutex);
+            isFusing = isEnabled;
+        }
+
+        FusionStats getFusionStats() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return fusionStats;
+        }
+
+        void setCoalescing(const Coalescing& policy) {
+            std::lock_guard<std::mutex> lock(mutex);
+            coalescing = policy;
+        }
+
+        BatchStats getBatchStats() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return batchStats;
+        }
+
+        void resetBatchStats() {
+            std::lock_guard<std::mutex> lock(mutex);
+            batchStats = BatchStats{};
+        }
+
+        // Time from submit to completion of every entry since the last reset.
+        LatencyHistogram latencyHistogram() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return latency;
+        }
+
+        void resetLatencyHistogram() {
+            std::lock_guard<std::mutex> lock(mutex);
+            latency = LatencyHistogram();
+        }
+
+        // Applies each setting as far as the OS permits and returns what took effect:
+        // cpu is -1 if pinning failed, priority 0 if SCHED_FIFO was refused. Passing
+        // { -1, 0, false, 0 } returns the thread to normal.
+        LatencyMode setLatencyMode(const LatencyMode& mode) {
+            LatencyMode applied = mode;
+#ifdef _WIN32
+            HANDLE handle = thread.native_handle();
+            DWORD_PTR processMask, systemMask;
+            if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) ||
+                !SetThreadAffinityMask(handle, mode.cpu >= 0 ? DWORD_PTR(1) << mode.cpu : processMask)) {
+                applied.cpu = -1;
+            }
+            if (!SetThreadPriority(handle, mode.priority > 0 ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_NORMAL)) {
+                applied.priority = 0;
+            }
+            applied.isMemoryLocked = false;
+#else
+            pthread_t handle = thread.native_handle();
+#ifdef __linux__
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            if (mode.cpu >= 0) CPU_SET(mode.cpu, &cpus);
+            else sched_getaffinity(0, sizeof(cpus), &cpus);
+            if (pthread_setaffinity_np(handle, sizeof(cpus), &cpus) != 0) applied.cpu = -1;
+#else
+            applied.cpu = -1;
+#endif
+            sched_param param{};
+            param.sched_priority = mode.priority;
+            if (pthread_setschedparam(handle, mode.priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param) != 0) {
+                applied.priority = 0;
+            }
+
+            if (mode.isMemoryLocked && !isMemoryLocked) {
+                isMemoryLocked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+            } else if (!mode.isMemoryLocked && isMemoryLocked) {
+                isMemoryLocked = munlockall() != 0;
+            }
+            applied.isMemoryLocked = isMemoryLocked;
+#endif
+
+            std::lock_guard<std::mutex> lock(mutex);
+            spinBudget = mode.spinBudget;
+            return applied;
+        }
+
+    private:
+        static constexpr size_t kLaneCount = 3;
+        static constexpr double kBusyWindow = 0.1;  // seconds
+
+        struct Fifo {
+            Entry* head;
+            Entry* tail;
+        };
+
+        // One frame of a batch: an entry, or a fused run of entries sent as `packet`.
+        struct Unit {
+            Entry* head;
+            Device::Request* request;
+            Device::Request packet;
+        };
+
+        Device& device;
+        RX784::Clock& clock;
+        mutable std::mutex mutex;
+        std::condition_variable condition;
+        Fifo lanes[kLaneCount];
+        LaneStats stats[kLaneCount];
+        PollPhase pollPhase;
+        std::chrono::nanoseconds pollMargin;
+        bool hasPollPhase;
+        LatencyHistogram latency;
+        std::chrono::nanoseconds spinBudget;
+        bool isMemoryLocked;
+        bool isFusing;
+        CommandFuser fuser;
+        FusionStats fusionStats;
+        Coalescing coalescing;
+        BatchStats batchStats;
+        Clock::time_point lastArrival;
+        std::chrono::nanoseconds lastGap;
+        std::chrono::nanoseconds meanGap;
+        Budget budget;
+        WireBudget wire;
+        std::chrono::nanoseconds queuedWire[kLaneCount];
+        std::chrono::nanoseconds inFlightWire;
+        double busyTime;  // seconds of frames, decayed over kBusyWindow
+        Clock::time_point busyStamp;
+        double serviceRatio;
+        std::condition_variable credited;
+        size_t creditWaiters;
+        BudgetStats budgetStats;
+        Unit units[kMaxBatch];
+        uint8_t frames[kMaxBatch * Device::Request::maxFrameSize()];
+        bool isStopping;
+        std::thread thread;
+
+        void enqueue(Entry& entry, Lane lane) {
+            entry.next = nullptr;
+            entry.lane = lane;
+            entry.enqueueTime = clock.now();
+            entry.wireTime = wire.cost(entry.request);
+            lastGap = std::min<Clock::duration>(entry.enqueueTime - lastArrival, std::chrono::seconds(1));
+            meanGap += (lastGap - meanGap) / 8;
+            lastArrival = entry.enqueueTime;
+
+            Fifo& fifo = lanes[static_cast<size_t>(lane)];
+            if (fifo.tail) fifo.tail->next = &entry;
+            else fifo.head = &entry;
+            fifo.tail = &entry;
+            ++stats[static_cast<size_t>(lane)].depth;
+            queuedWire[static_cast<size_t>(lane)] += entry.wireTime;
+        }
+
+        std::chrono::nanoseconds delayAhead(Lane lane) const {
+            std::chrono::nanoseconds delay = inFlightWire;
+            for (size_t i = 0; i <= static_cast<size_t>(lane); ++i) delay += queuedWire[i];
+            return std::chrono::nanoseconds(static_cast<int64_t>(delay.count() * serviceRatio));
+        }
+
+        // An entry with nothing ahead of it is always credited, however long it takes on
+        // its own, since waiting would not make it any shorter.
+        bool hasCredit(const Entry& entry, Lane lane) const {
+            std::chrono::nanoseconds ahead = delayAhead(lane);
+            if (ahead.count() == 0) return true;
+            auto own = std::chrono::nanoseconds(static_cast<int64_t>(wire.cost(entry.request).count() * serviceRatio));
+            return ahead + own <= budget.maxDelay;
+        }
+
+        double decayedBusyTime(Clock::time_point now) const {
+            double elapsed = std::chrono::duration<double>(now - busyStamp).count();
+            return busyTime * std::exp(-std::max(0.0, elapsed) / kBusyWindow);
+        }
+
+        Entry* pop() {
+            for (size_t i = 0; i < kLaneCount; ++i) {
+                Fifo& fifo = lanes[i];
+                if (!fifo.head) continue;
+
+                Entry* entry = fifo.head;
+                fifo.head = entry->next;
+                if (!fifo.head) fifo.tail = nullptr;
+                queuedWire[i] -= entry->wireTime;
+                inFlightWire += entry->wireTime;
+
+                auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(clock.now() - entry->enqueueTime);
+                LaneStats& laneStats = stats[i];
+                ++laneStats.count;
+                --laneStats.depth;
+                laneStats.totalDelay += delay;
+                laneStats.maxDelay = std::max(laneStats.maxDelay, delay);
+                return entry;
+            }
+            return nullptr;
+        }
+
+        Entry* peek() const {
+            for (const Fifo& fifo : lanes) {
+                if (fifo.head) return fifo.head;
+            }
+            return nullptr;
+        }
+
+        // Makes `entry`, and when fusing the run that follows it in its lane, one unit.
+        void take(Entry* entry, Unit& unit) {
+            entry->next = nullptr;
+            unit.head = entry;
+            unit.request = &entry->request;
+            if (!isFusing || entry->isPollAligned || !fuser.begin(entry->request)) return;
+
+            // The entry's lane was the highest non-empty one, so the next pop takes from it too.
+            Fifo& fifo = lanes[static_cast<size_t>(entry->lane)];
+            for (Entry* last = entry; fifo.head && !fifo.head->isPollAligned && fuser.append(fifo.head->request); ) {
+                last = last->next = pop();
+                last->next = nullptr;
+            }
+            if (fuser.isWorthSending()) {
+                ++fusionStats.packets;
+                fusionStats.saved += fuser.size() - 1;
+                unit.packet = fuser.packet();
+                unit.request = &unit.packet;
+            }
+        }
+
+        // Fills units[] behind the first one and returns how many there are. A unit the
+        // fuser must observe ends the batch, so the next run starts from its outcome.
+        size_t gather(std::unique_lock<std::mutex>& lock) {
+            size_t count = 1, bytes = 4u + units[0].request->dataSize;
+            if (coalescing.maxBytes == 0 || CommandFuser::isObserved(*units[0].request)) return count;
+
+            std::chrono::nanoseconds hold(0);
+            if (lastGap < coalescing.maxDelay && meanGap < coalescing.maxDelay) hold = std::min(2 * meanGap, coalescing.maxDelay);
+            Clock::time_point deadline = clock.now() + hold;
+
+            while (count < kMaxBatch && bytes < coalescing.maxBytes) {
+                Entry* entry = peek();
+                if (!entry) {
+                    if (isStopping || !clock.waitUntil(lock, condition, deadline, [&] { return isStopping || peek(); })) break;
+                    continue;
+                }
+                if (entry->isPollAligned && hasPollPhase) break;
+
+                Unit& unit = units[count++];
+                take(pop(), unit);
+                bytes += 4u + unit.request->dataSize;
+                if (CommandFuser::isObserved(*unit.request)) break;
+            }
+            return count;
+        }
+
+        void run() {
+            for (;;) {
+                size_t count = 1;
+                Clock::time_point sendTime{};
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    Entry* entry;
+                    clock.wait(lock, condition, [&] { return (entry = pop()) != nullptr || isStopping; });
+                    if (!entry) return;
+                    device.setSpinBudget(spinBudget);
+
+                    take(entry, units[0]);
+                    if (entry->isPollAligned && hasPollPhase) sendTime = pollPhase.nextSendTime(clock.now(), pollMargin);
+                    else count = gather(lock);
+
+                    ++batchStats.writes;
+                    batchStats.frames += count;
+                    ++batchStats.sizes[count - 1];
+                }
+
+                if (sendTime > clock.now() + std::chrono::milliseconds(2)) {
+                    clock.sleepUntil(sendTime - std::chrono::milliseconds(2));
+                }
+                clock.spinUntil(sendTime);
+
+                size_t size = 0;
+                for (size_t i = 0; i < count; ++i) size += units[i].request->encode(&frames[size]);
+                Clock::time_point writeTime = clock.now();
+                Status sent = device.sendFrame(frames, size);
+
+                for (size_t i = 0; i < count; ++i) {
+                    Unit& unit = units[i];
+                    Status status = sent == Status::kSuccess ? device.recvResponse(*unit.request) : sent;
+                    fuser.observe(*unit.request, status);
+                    for (Entry* member = unit.head; member; member = member->next) {
+                        member->status = status;
+                        if (unit.request == &unit.packet) {
+                            member->request.responseSize = unit.packet.responseSize;
+                            memcpy(member->request.response, unit.packet.response, unit.packet.responseSize);
+                        }
+                    }
+                }
+
+                Clock::time_point completeTime = clock.now();
+                bool isCreditWaited;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    std::chrono::nanoseconds sentWire(0);
+                    for (size_t i = 0; i < count; ++i) {
+                        sentWire += wire.cost(*units[i].request);
+                        for (Entry* member = units[i].head; member; member = member->next) {
+                            latency.record(completeTime - member->enqueueTime);
+                            inFlightWire -= member->wireTime;
+                        }
+                    }
+                    busyTime = decayedBusyTime(completeTime) + std::chrono::duration<double>(sentWire).count();
+                    busyStamp = completeTime;
+                    if (sent == Status::kSuccess && sentWire.count() > 0) {
+                        double ratio = static_cast<double>((completeTime - writeTime).count()) / sentWire.count();
+                        serviceRatio += (std::max(1.0, ratio) - serviceRatio) / 16;
+                    }
+                    isCreditWaited = creditWaiters != 0;
+                }
+                if (isCreditWaited) clock.notifyAll(credited);
+                for (size_t i = 0; i < count; ++i) {
+                    for (Entry* entry = units[i].head; entry; ) {
+                        Entry* next = entry->next;
+                        entry->onComplete(*entry);
+                        entry = next;
+                    }
+                }
+            }
+        }
+    };
+};
@@ -0,0 +1,305 @@
+#pragma once
+#include "rx784.hpp"
+#include "rx784_queue.hpp"
+
+namespace RX784 {
+    // Holds keys through a CommandQueue and repeats them the way a keyboard's typematic
+    // does: `delay` after press() a held key is released and pressed again, `rate` times
+    // a second, until release().
+    //
+    //     RX784::KeyRepeater repeater(queue);
+    //     repeater.press(RX784::VirtualKeyCode::kArrowDown, { std::chrono::milliseconds(250), 30 });
+    //     ...
+    //     repeater.release(RX784::VirtualKeyCode::kArrowDown);
+    //
+    // One timer drives every held key. It fires on a grid of `resolution` and sends one
+    // sendKeyboardState per tick with every key due on it, releases and presses alike.
+    // A key stays up for `upTime` before it goes down again, so the host sees the gap;
+    // the timer never fires twice on one tick, so upTime is in effect at least one
+    // resolution, and a period is at least two. Modifiers are held but do not repeat.
+    //
+    // Keys go into free slots of the board's keyboard report, which the repeater learns
+    // with one getKeyboardState and then keeps track of. Other keyboard traffic on the
+    // queue while the repeater holds keys may take the same slots. press() returns
+    // kInvalidSize when all seven are taken. Ticks are paced by the queue's clock.
+    class KeyRepeater {
+    public:
+        using Clock = CommandQueue::Clock;
+
+        struct Timing {
+            std::chrono::milliseconds delay;
+            double rate;  // repeats a second
+        };
+
+        struct Stats {
+            uint64_t repeats;                      // presses sent by the timer
+            uint64_t packets;                      // sendKeyboardState packets sent by the timer
+            uint64_t transitions;                  // key releases and presses they carried
+            uint64_t errors;
+            std::chrono::nanoseconds maxLateness;  // longest a tick went out after its time
+        };
+
+        static Timing defaultTiming() { return { std::chrono::milliseconds(500), 30 }; }
+
+        explicit KeyRepeater(CommandQueue& queue,
+                             std::chrono::microseconds resolution = std::chrono::milliseconds(8),
+                             std::chrono::microseconds upTime = std::chrono::milliseconds(8))
+            : queue(queue), clock(queue.getClock()), resolution(std::max<Clock::duration>(resolution, std::chrono::microseconds(100))),
+              upTime(upTime), held{}, modifierKeys(0), isLayoutKnown(false), layout{}, lastTick{}, stats{},
+              isChanged(false), isStopping(false) {
+            epoch = lastTick = clock.now();
+            clock.attach();
+            thread = std::thread(&KeyRepeater::run, this);
+        }
+
+        KeyRepeater(const KeyRepeater&) = delete;
+        KeyRepeater& operator=(const KeyRepeater&) = delete;
+
+        // Releases whatever is still held.
+        ~KeyRepeater() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                isStopping = true;
+            }
+            clock.notifyOne(condition);
+            thread.join();
+            clock.detach();
+            releaseAll();
+        }
+
+        // Presses `key` now. Pressing a held key again only changes its timing: the delay
+        // starts over, unless the key is up between repeats, when it goes down as planned
+        // and repeats at the new rate from there.
+        Status press(VirtualKeyCode key, const Timing& timing = defaultTiming()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            uint8_t modifier = modifierBit(key);
+            if (modifier != 0) {
+                KeyboardState state{};
+                KeyboardStateMask mask{};
+                setModifiers(state, mask, modifier, modifier);
+                Status status = send(state, mask);
+                if (status == Status::kSuccess) modifierKeys |= modifier;
+                return status;
+            }
+
+            Held* entry = find(key);
+            if (!entry) {
+                Status status = learnLayout();
+                if (status != Status::kSuccess) return status;
+                size_t slot = 0;
+                while (slot < 7 && layout[slot] != key) ++slot;
+                if (slot == 7) {
+                    slot = 0;
+                    while (slot < 7 && layout[slot] != VirtualKeyCode::kInvalid) ++slot;
+                }
+                if (slot == 7) return Status::kInvalidSize;
+
+                KeyboardState state{};
+                KeyboardStateMask mask{};
+                state.regularKeys[slot] = key;
+                mask.regularKeys[slot] = true;
+                status = send(state, mask);
+                if (status != Status::kSuccess) return status;
+                layout[slot] = key;
+                entry = &held[slot];
+                entry->key = key;
+                entry->isUp = false;
+            }
+
+            Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1 / std::max(timing.rate, 1e-3)));
+            entry->period = std::max<Clock::duration>(period, 2 * resolution);
+            if (!entry->isUp) {
+                entry->repeatAt = clock.now() + timing.delay;
+                entry->next = entry->repeatAt - upTime;
+            }
+            isChanged = true;
+            clock.notifyOne(condition);
+            return Status::kSuccess;
+        }
+
+        Status release(VirtualKeyCode key) {
+            std::lock_guard<std::mutex> lock(mutex);
+            KeyboardState state{};
+            KeyboardStateMask mask{};
+            uint8_t modifier = modifierBit(key);
+            if (modifier != 0) {
+                setModifiers(state, mask, modifier, 0);
+                modifierKeys &= static_cast<uint8_t>(~modifier);
+                return send(state, mask);
+            }
+
+            Held* entry = find(key);
+            if (!entry) {
+                Device::Request request = Device::Request::keyUp(key);
+                Status status = queue.execute(request);
+                return status == Status::kSuccess ? request.result() : status;
+            }
+            size_t slot = static_cast<size_t>(entry - held);
+            mask.regularKeys[slot] = true;
+            layout[slot] = VirtualKeyCode::kInvalid;
+            entry->key = VirtualKeyCode::kInvalid;
+            isChanged = true;
+            clock.notifyOne(condition);
+            return send(state, mask);
+        }
+
+        // Releases every key the repeater holds, in one packet.
+        Status releaseAll() {
+            std::lock_guard<std::mutex> lock(mutex);
+            KeyboardState state{};
+            KeyboardStateMask mask{};
+            bool isAny = modifierKeys != 0;
+            setModifiers(state, mask, modifierKeys, 0);
+            modifierKeys = 0;
+            for (size_t slot = 0; slot < 7; ++slot) {
+                if (held[slot].key == VirtualKeyCode::kInvalid) continue;
+                mask.regularKeys[slot] = true;
+                layout[slot] = held[slot].key = VirtualKeyCode::kInvalid;
+                isAny = true;
+            }
+            isChanged = true;
+            clock.notifyOne(condition);
+            return isAny ? send(state, mask) : Status::kSuccess;
+        }
+
+        Stats getStats() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return stats;
+        }
+
+    private:
+        // Indexed by slot; key is kInvalid when the slot is not the repeater's.
+        struct Held {
+            VirtualKeyCode key;
+            bool isUp;                     // released for a repeat
+            Clock::duration period;
+            Clock::time_point repeatAt;    // when the next repeat goes down
+            Clock::time_point next;        // when the key next changes
+        };
+
+        CommandQueue& queue;
+        RX784::Clock& clock;
+        const Clock::duration resolution;
+        const Clock::duration upTime;
+        Held held[7];
+        uint8_t modifierKeys;
+        bool isLayoutKnown;
+        VirtualKeyCode layout[7];  // the board's regular key slots as far as the repeater knows
+        Clock::time_point epoch;
+        Clock::time_point lastTick;
+        Stats stats;
+        mutable std::mutex mutex;
+        std::condition_variable condition;
+        bool isChanged;
+        bool isStopping;
+        std::thread thread;
+
+        static uint8_t modifierBit(VirtualKeyCode key) {
+            switch (key)
+            {
+            case VirtualKeyCode::kControl:
+            case VirtualKeyCode::kControlLeft:  return 1u << 0;
+            case VirtualKeyCode::kShift:
+            case VirtualKeyCode::kShiftLeft:    return 1u << 1;
+            case VirtualKeyCode::kAlt:
+            case VirtualKeyCode::kAltLeft:      return 1u << 2;
+            case VirtualKeyCode::kOSLeft:       return 1u << 3;
+            case VirtualKeyCode::kControlRight: return 1u << 4;
+            case VirtualKeyCode::kShiftRight:   return 1u << 5;
+            case VirtualKeyCode::kAltRight:     return 1u << 6;
+            case VirtualKeyCode::kOSRight:      return 1u << 7;
+            default:                            return 0;
+            }
+        }
+
+        static void setModifiers(KeyboardState& state, KeyboardStateMask& mask, uint8_t bits, uint8_t values) {
+            memcpy(&mask.modifierKeys, &bits, sizeof(bits));
+            memcpy(&state.modifierKeys, &values, sizeof(values));
+        }
+
+        Held* find(VirtualKeyCode key) {
+            if (key == VirtualKeyCode::kInvalid) return nullptr;
+            for (Held& entry : held) if (entry.key == key) return &entry;
+            return nullptr;
+        }
+
+        Status learnLayout() {
+            if (isLayoutKnown) return Status::kSuccess;
+            Device::Request request = Device::Request::getKeyboardState();
+            Status status = queue.execute(request);
+            if (status != Status::kSuccess) return status;
+            KeyboardState state = request.keyboardState();
+            memcpy(layout, state.regularKeys, sizeof(layout));
+            isLayoutKnown = true;
+            return Status::kSuccess;
+        }
+
+        // Called with the mutex held, so packets go out in the order the table changes.
+        Status send(const KeyboardState& state, const KeyboardStateMask& mask) {
+            Device::Request request = Device::Request::sendKeyboardState(state, mask);
+            Status status = queue.execute(request);
+            if (status == Status::kSuccess) status = request.result();
+            if (status != Status::kSuccess) isLayoutKnown = false;
+            return status;
+        }
+
+        Clock::time_point earliest() const {
+            Clock::time_point due = Clock::time_point::max();
+            for (const Held& entry : held) {
+                if (entry.key != VirtualKeyCode::kInvalid) due = std::min(due, entry.next);
+            }
+            return due;
+        }
+
+        // The first tick of the grid at or after `due` and after the last one fired.
+        Clock::time_point tickFor(Clock::time_point due) const {
+            auto offset = std::max<Clock::duration>(due - epoch, lastTick - epoch + resolution);
+            return epoch + (offset + resolution - Clock::duration(1)) / resolution * resolution;
+        }
+
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!isStopping) {
+                isChanged = false;
+                Clock::time_point due = earliest();
+                if (due == Clock::time_point::max()) {
+                    clock.wait(lock, condition, [&] { return isStopping || isChanged; });
+                    continue;
+                }
+                Clock::time_point tick = tickFor(due);
+                if (clock.waitUntil(lock, condition, tick, [&] { return isStopping || isChanged; })) continue;
+                fire(tick);
+            }
+        }
+
+        void fire(Clock::time_point tick) {
+            KeyboardState state{};
+            KeyboardStateMask mask{};
+            size_t transitions = 0;
+            for (size_t slot = 0; slot < 7; ++slot) {
+                Held& entry = held[slot];
+                if (entry.key == VirtualKeyCode::kInvalid || entry.next > tick) continue;
+
+                mask.regularKeys[slot] = true;
+                ++transitions;
+                if (!entry.isUp) {
+                    entry.isUp = true;
+                    entry.next = entry.repeatAt;
+                    continue;
+                }
+                state.regularKeys[slot] = entry.key;
+                entry.isUp = false;
+                ++stats.repeats;
+                entry.repeatAt += entry.period;
+                if (entry.repeatAt <= tick) entry.repeatAt = tick + entry.period;
+                entry.next = entry.repeatAt - upTime;
+            }
+
+            lastTick = tick;
+            stats.maxLateness = std::max<std::chrono::nanoseconds>(stats.maxLateness, clock.now() - tick);
+            ++stats.packets;
+            stats.transitions += transitions;
+            if (send(state, mask) != Status::kSuccess) ++stats.errors;
+        }
+    };
+};
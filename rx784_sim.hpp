@@ -0,0 +1,439 @@
+#pragma once
+#include "rx784.hpp"
+#include <atomic>
+#include <cstdlib>
+
+// A software RX784 behind a pseudo-terminal, for benchmarks and tools that need a board
+// without hardware. POSIX only.
+//
+//     RX784::SimulatedBoard board;
+//     board.start();
+//     device.open(board.portName());
+
+namespace RX784 {
+    class SimulatedBoard {
+    public:
+        struct Stats {
+            uint64_t frames;
+            uint64_t invalidBytes;
+            uint64_t flashWrites;
+            std::chrono::steady_clock::time_point lastFrameTime;  // when the latest frame was parsed
+        };
+
+        SimulatedBoard()
+            : master(-1), keeper(-1), responseDelay(0), flashWriteDelay(0), isStopping(false), stats{},
+              modifierKeys(0), regularKeys{}, buttons(0), leds(0), axes{}, screen{},
+              vendorID(0x1A86), productID(0xE784), versionNumber(0x0100),
+              manufacturerString{}, productString{}, manufacturerStringSize(0), productStringSize(0),
+              serialNumber{}, absScale(1), absRefuseRate(0), random(1) {
+            for (uint8_t i = 0; i < sizeof(serialNumber); ++i) serialNumber[i] = static_cast<uint8_t>(0x78 ^ i);
+        }
+
+        SimulatedBoard(const SimulatedBoard&) = delete;
+        SimulatedBoard& operator=(const SimulatedBoard&) = delete;
+
+        ~SimulatedBoard() { stop(); }
+
+        bool start() {
+            if (thread.joinable()) return true;
+            char name[128];
+
+            master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+            if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0 || ptsname_r(master, name, sizeof(name)) != 0) {
+                stop();
+                return false;
+            }
+            port = name;
+
+            // A fresh start is a power cycle: nothing held, the pointer back at the origin.
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                modifierKeys = buttons = leds = 0;
+                memset(regularKeys, 0, sizeof(regularKeys));
+                memset(axes, 0, sizeof(axes));
+                memset(screen, 0, sizeof(screen));
+            }
+
+            // Hold the terminal side open in raw mode so that nothing is echoed back and the
+            // master does not report a hangup between clients.
+            keeper = openSerialPort(name, 250000);
+            if (keeper < 0) {
+                stop();
+                return false;
+            }
+
+            if (!linkPath.empty()) {
+                ::unlink(linkPath.c_str());
+                if (::symlink(name, linkPath.c_str()) != 0) {
+                    stop();
+                    return false;
+                }
+            }
+
+            isStopping = false;
+            thread = std::thread(&SimulatedBoard::run, this);
+            return true;
+        }
+
+        void stop() {
+            isStopping = true;
+            if (thread.joinable()) thread.join();
+            if (!linkPath.empty()) ::unlink(linkPath.c_str());
+            if (keeper >= 0) ::close(keeper);
+            if (master >= 0) ::close(master);
+            keeper = master = -1;
+        }
+
+        const std::string& portName() const { return port; }
+
+        // Keeps a symlink at `path` pointing to the current terminal, like a udev by-id
+        // name, so stop() and start() look like unplugging and replugging the board.
+        void setLinkPath(const std::string& path) { linkPath = path; }
+
+        // Added before every response, standing in for USB and firmware latency.
+        void setResponseDelay(std::chrono::microseconds delay) { responseDelay = delay.count(); }
+
+        // Added on top for the config commands, which write flash on a real board.
+        void setFlashWriteDelay(std::chrono::microseconds delay) { flashWriteDelay = delay.count(); }
+
+        void setSerialNumber(const uint8_t (&number)[20]) {
+            std::lock_guard<std::mutex> lock(mutex);
+            memcpy(serialNumber, number, sizeof(serialNumber));
+        }
+
+        // Makes moveAbs land off target by `scale`, as when initAbsSystem was given the
+        // wrong screen size, and refuses a share of moveAbs frames without moving. The
+        // refusals are drawn from `seed`, so runs repeat.
+        void setAbsFaults(double scale, double refuseRate, uint64_t seed = 1) {
+            std::lock_guard<std::mutex> lock(mutex);
+            absScale = scale;
+            absRefuseRate = refuseRate;
+            random = seed;
+        }
+
+        Stats getStats() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return stats;
+        }
+
+        void getAxes(int16_t& x, int16_t& y, int16_t& w) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            x = axes[0];
+            y = axes[1];
+            w = axes[2];
+        }
+
+    private:
+        int master;
+        int keeper;
+        std::string port;
+        std::string linkPath;
+        std::atomic<int64_t> responseDelay;
+        std::atomic<int64_t> flashWriteDelay;
+        std::atomic<bool> isStopping;
+        std::thread thread;
+        mutable std::mutex mutex;
+        Stats stats;
+
+        uint8_t modifierKeys;
+        uint8_t regularKeys[7];
+        uint8_t buttons;
+        uint8_t leds;
+        int16_t axes[3];
+        int16_t screen[2];
+        uint16_t vendorID;
+        uint16_t productID;
+        uint16_t versionNumber;
+        uint8_t manufacturerString[60];
+        uint8_t productString[60];
+        uint8_t manufacturerStringSize;
+        uint8_t productStringSize;
+        uint8_t serialNumber[20];
+        double absScale;
+        double absRefuseRate;
+        uint64_t random;
+
+        bool isRefused() {
+            if (absRefuseRate <= 0) return false;
+            random = random * 6364136223846793005ull + 1442695040888963407ull;
+            return static_cast<double>(random >> 11) / 9007199254740992.0 < absRefuseRate;
+        }
+
+        void run() {
+            uint8_t buffer[1024];
+            size_t size = 0;
+
+            while (!isStopping) {
+                pollfd pfd = { master, POLLIN, 0 };
+                if (poll(&pfd, 1, 20) <= 0) continue;
+
+                ssize_t n = ::read(master, &buffer[size], sizeof(buffer) - size);
+                if (n <= 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    continue;
+                }
+                size += static_cast<size_t>(n);
+
+                size_t offset = 0;
+                while (size - offset >= 4) {
+                    if (buffer[offset] != 0xBE) {
+                        ++offset;
+                        std::lock_guard<std::mutex> lock(mutex);
+                        ++stats.invalidBytes;
+                        continue;
+                    }
+                    size_t frameSize = 4u + buffer[offset + 2];
+                    if (size - offset < frameSize) break;
+
+                    if (buffer[offset + frameSize - 1] == 0xED) {
+                        handle(buffer[offset + 1], &buffer[offset + 3], buffer[offset + 2]);
+                        offset += frameSize;
+                    } else {
+                        ++offset;
+                        std::lock_guard<std::mutex> lock(mutex);
+                        ++stats.invalidBytes;
+                    }
+                }
+                memmove(buffer, &buffer[offset], size - offset);
+                size -= offset;
+                if (size == sizeof(buffer)) size = 0;
+            }
+        }
+
+        void reply(uint8_t cmd, const void* data, size_t dataSize) {
+            uint8_t frame[4 + UINT8_MAX];
+            frame[0] = 0xBE;
+            frame[1] = cmd;
+            frame[2] = static_cast<uint8_t>(dataSize);
+            memcpy(&frame[3], data, dataSize);
+            frame[3 + dataSize] = 0xED;
+
+            int64_t delay = responseDelay;
+            if (delay > 0) std::this_thread::sleep_for(std::chrono::microseconds(delay));
+
+            const uint8_t* bytes = frame;
+            size_t remaining = 4 + dataSize;
+            while (remaining != 0) {
+                ssize_t n = ::write(master, bytes, remaining);
+                if (n <= 0) return;
+                bytes += n;
+                remaining -= static_cast<size_t>(n);
+            }
+        }
+
+        void replyStatus(uint8_t cmd, Status status) { reply(cmd, &status, 1); }
+
+        static int16_t int16At(const uint8_t* data, size_t index) {
+            int16_t value;
+            memcpy(&value, &data[index * 2], sizeof(value));
+            return value;
+        }
+
+        void setKey(uint8_t key, bool isDown) {
+            if (key >= 0xE0 && key <= 0xE7) {
+                uint8_t bit = static_cast<uint8_t>(1u << (key - 0xE0));
+                modifierKeys = isDown ? (modifierKeys | bit) : (modifierKeys & ~bit);
+                return;
+            }
+            uint8_t* slot = std::find(regularKeys, regularKeys + 7, key);
+            if (isDown && slot == regularKeys + 7) slot = std::find(regularKeys, regularKeys + 7, 0);
+            if (slot != regularKeys + 7) *slot = isDown ? key : 0;
+        }
+
+        void setButtons(uint8_t mask, uint8_t state) {
+            buttons = static_cast<uint8_t>((buttons & ~mask) | (state & mask));
+        }
+
+        void handle(uint8_t cmd, const uint8_t* data, uint8_t size) {
+            std::unique_lock<std::mutex> lock(mutex);
+            ++stats.frames;
+            stats.lastFrameTime = std::chrono::steady_clock::now();
+            uint8_t out[64] = {};
+
+            switch (cmd)
+            {
+            case 1:   // reboot
+                modifierKeys = buttons = 0;
+                memset(regularKeys, 0, sizeof(regularKeys));
+                lock.unlock();
+                return replyStatus(cmd, Status::kSuccess);
+            case 11:  // keyDown
+            case 12:  // keyUp
+                if (size != 1) break;
+                setKey(data[0], cmd == 11);
+                lock.unlock();
+                return replyStatus(cmd, Status::kSuccess);
+            case 13:  // releaseAllKeys
+                modifierKeys = 0;
+                memset(regularKeys, 0, sizeof(regularKeys));
+                lock.unlock();
+                return replyStatus(cmd, Status::kSuccess);
+            case 14:  // getKeyState
+                if (size != 1) break;
+                out[0] = data[0] >= 0xE0 && data[0] <= 0xE7 ? (modifierKeys >> (data[0] - 0xE0)) & 1
+                                                              : std::find(regularKeys, regularKeys + 7, data[0]) != regularKeys + 7;
+                lock.unlock();
+                return reply(cmd, out, 1);
+            case 15:  // getKeyboardLEDsState
+                out[0] = leds;
+                lock.unlock();
+                return reply(cmd, out, 1);
+            case 16:  // getKeyboardState
+                out[0] = modifierKeys;
+                memcpy(&out[1], regularKeys, sizeof(regularKeys));
+                lock.unlock();
+                return reply(cmd, out, 8);
+            case 17:  // sendKeyboardState
+                if (size != 10) break;
+                modifierKeys = static_cast<uint8_t>((modifierKeys & ~data[0]) | (data[2] & data[0]));
+                for (size_t i = 0; i < 7; ++i) if (data[1] & (1u << i)) regularKeys[i] = data[3 + i];
+                lock.unlock();
+                return replyStatus(cmd, Status::kSuccess);
+            case 31:  // buttonDown
+            case 32:  // buttonUp
+                if (size != 1 || data[0] > 4) break;
+                setButtons(static_cast<uint8_t>(1u << data[0]), cmd == 31 ? 0xFF : 0);
+                lock.unlock();
+                return replyStatus(cmd, Status::kSuccess);
+            case 33:  // releaseAllButtons
+                buttons = 0;
+                lock.unlock();
+                return replyStatus(cmd, Status::kSuccess);
+            case 34:  // getButtonsState
+            case 53:  // getRelMouseState
+                out[0] = buttons;
+                lock.unlock();
+                return reply(cmd, out, 1);
+            case 51:  // moveRel
+                if (size != 4) break;
+                axes[0] = saturateInt16(axes[0] + int16At(data, 0));
+                axes[1] = saturateInt16(axes[1] + int16At(data, 1));
+                lock.unlock();
+                return replyStatus(cmd, Status::kSuccess);
+            case 52:  // scrollRel
+                if (size != 2) break;
+                axes[2] = saturateInt16(axes[2] + int16At(data, 0));
+                lock.unlock();
+                return replyStatus(cmd, Status::kSuccess);
+            case 54:  // sendRelMouseState
+                if (size != 8) break;
+                setButtons(data[0] & 0x07, data[1]);
+                if (data[0] & 0x08) axes[0] = saturateInt16(axes[0] + int16At(&data[2], 0));
+                if (data[0] & 0x10) axes[1] = saturateInt16(axes[1] + int16At(&data[2], 1));
+                if (data[0] & 0x20) axes[2] = saturateInt16(axes[2] + int16At(&data[2], 2));
+                lock.unlock();
+                return replyStatus(cmd, Status::kSuccess);
+            case 71:  // initAbsSystem
+                if (size != 4) break;
+                screen[0] = int16At(data, 0);
+                screen[1] = int16At(data, 1);
+                lock.unlock();
+                return replyStatus(cmd, Status::kSuccess);
+            case 72:  // moveAbs
+                if (size != 4) break;
+                if (isRefused()) break;
+                axes[0] = saturateInt16(static_cast<int32_t>(std::lround(int16At(data, 0) * absScale)));
+                axes[1] = saturateInt16(static_cast<int32_t>(std::lround(int16At(data, 1) * absScale)));
+                lock.unlock();
+                return replyStatus(cmd, Status::kSuccess);
+            case 75:  // setPos
+                if (size != 4) break;
+                axes[0] = int16At(data, 0);
+                axes[1] = int16At(data, 1);
+                lock.unlock();
+                return replyStatus(cmd, Status::kSuccess);
+            case 73:  // scrollAbs
+            case 77:  // setWheelAxis
+                if (size != 2) break;
+                axes[2] = int16At(data, 0);
+                lock.unlock();
+                return replyStatus(cmd, Status::kSuccess);
+            case 74:  // getPos
+                memcpy(out, axes, 4);
+                lock.unlock();
+                return reply(cmd, out, 4);
+            case 76:  // getWheelAxis
+                memcpy(out, &axes[2], 2);
+                lock.unlock();
+                return reply(cmd, out, 2);
+            case 78:  // getAxes
+                memcpy(out, axes, 6);
+                lock.unlock();
+                return reply(cmd, out, 6);
+            case 79:  // setAxes
+                if (size != 6) break;
+                for (size_t i = 0; i < 3; ++i) axes[i] = int16At(data, i);
+                lock.unlock();
+                return replyStatus(cmd, Status::kSuccess);
+            case 80:  // getAbsMouseState
+                out[0] = buttons;
+                memcpy(&out[1], axes, 6);
+                lock.unlock();
+                return reply(cmd, out, 7);
+            case 81:  // sendAbsMouseState
+                if (size != 8) break;
+                setButtons(data[0] & 0x07, data[1]);
+                if (data[0] & 0x08) axes[0] = int16At(&data[2], 0);
+                if (data[0] & 0x10) axes[1] = int16At(&data[2], 1);
+                if (data[0] & 0x20) axes[2] = int16At(&data[2], 2);
+                lock.unlock();
+                return replyStatus(cmd, Status::kSuccess);
+            case 91:  // getVendorID
+            case 92:  // getProductID
+            case 93: {  // getVersionNumber
+                uint16_t value = cmd == 91 ? vendorID : cmd == 92 ? productID : versionNumber;
+                memcpy(&out[1], &value, 2);
+                lock.unlock();
+                return reply(cmd, out, 3);
+            }
+            case 94:  // getManufacturerString
+            case 95: {  // getProductString
+                const uint8_t* string = cmd == 94 ? manufacturerString : productString;
+                uint8_t stringSize = cmd == 94 ? manufacturerStringSize : productStringSize;
+                memcpy(&out[1], string, stringSize);
+                lock.unlock();
+                return reply(cmd, out, 1u + stringSize + 2u);
+            }
+            case 111:  // configVendorID
+            case 112:  // configProductID
+            case 113: {  // configVersionNumber
+                if (size != 2) break;
+                uint16_t& value = cmd == 111 ? vendorID : cmd == 112 ? productID : versionNumber;
+                memcpy(&value, data, 2);
+                ++stats.flashWrites;
+                lock.unlock();
+                std::this_thread::sleep_for(std::chrono::microseconds(flashWriteDelay));
+                return replyStatus(cmd, Status::kSuccess);
+            }
+            case 114:  // configManufacturerString
+            case 115:  // configProductString
+                if (size > 60 || size % 2 != 0) break;
+                memcpy(cmd == 114 ? manufacturerString : productString, data, size);
+                (cmd == 114 ? manufacturerStringSize : productStringSize) = size;
+                ++stats.flashWrites;
+                lock.unlock();
+                std::this_thread::sleep_for(std::chrono::microseconds(flashWriteDelay));
+                return replyStatus(cmd, Status::kSuccess);
+            case 131:  // getDeviceID
+                out[0] = 0x84;
+                out[1] = 0x07;
+                lock.unlock();
+                return reply(cmd, out, 2);
+            case 132:  // getDeviceSerialNumber
+                memcpy(out, serialNumber, sizeof(serialNumber));
+                lock.unlock();
+                return reply(cmd, out, sizeof(serialNumber));
+            case 133:  // getFirmwareVersion
+                out[0] = 0x01;
+                out[1] = 0x01;
+                lock.unlock();
+                return reply(cmd, out, 2);
+            default:
+                break;
+            }
+
+            lock.unlock();
+            replyStatus(cmd, Status::kInvalidCommandPacket);
+        }
+    };
+};
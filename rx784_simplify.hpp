@@ -0,0 +1,237 @@
+#pragma once
+#include "rx784.hpp"
+
+// Turns recorded or generated motion, often thousands of one- and two-pixel moveRel
+// steps, into the few straight timed segments that reproduce it within a tolerance:
+//
+//     RX784::SimplifyTolerance tolerance = { 1.5, 4000 };  // 1.5 px, 4 ms
+//     RX784::SimplifyStats stats;
+//     auto segments = RX784::MotionSimplifier::simplify(steps.data(), steps.size(), tolerance, &stats);
+//     RX784::playSegments(device, segments.data(), segments.size(), 250);
+//
+// A recorded point is within tolerance when the segments pass within `pixels` of it at
+// some time no more than `time` from when it was recorded, so a timing tolerance of 0
+// holds the pointer to the recording's schedule and a large one only to its shape.
+// Segment ends fall on recorded points, so the total displacement is exact, and on
+// whole milliseconds, which the fit already accounts for.
+//
+// simplify() is Ramer-Douglas-Peucker over the whole trace. A MotionSimplifier fed one
+// step at a time grows each segment for as long as every point since its start still
+// fits, and needs no more than kWindow points of memory. Neither reliably finds fewer
+// segments than the other.
+
+namespace RX784 {
+    // The pointer moved by (x, y) at `time` microseconds into the trace.
+    struct MotionStep {
+        int16_t x;
+        int16_t y;
+        uint64_t time;
+    };
+
+    // A straight move of (x, y) at constant speed over `duration` ms, from where the
+    // segment before it ended.
+    struct MotionSegment {
+        int16_t x;
+        int16_t y;
+        uint32_t duration;
+    };
+
+    struct SimplifyTolerance {
+        double pixels;
+        uint32_t time;  // microseconds either side of a point's own time
+    };
+
+    struct SimplifyStats {
+        uint64_t steps;
+        uint64_t segments;
+        double maxDeviation;  // pixels, the largest distance found with the timing tolerance applied
+
+        double ratio() const { return segments != 0 ? static_cast<double>(steps) / segments : 0; }
+    };
+
+    // The LinearPath of a MotionSegment: straight, and linear in time.
+    inline LinearPath straightPath() {
+        return { 1.0 / 3, 1.0 / 3, 2.0 / 3, 2.0 / 3, 1.0 / 3, 1.0 / 3, 2.0 / 3, 2.0 / 3 };
+    }
+
+    class MotionSimplifier {
+    public:
+        static constexpr size_t kWindow = 512;
+
+        explicit MotionSimplifier(const SimplifyTolerance& tolerance)
+            : tolerance(tolerance), stats{}, last{}, fitDeviation(0) {
+            window.reserve(kWindow);
+            window.push_back(Point{});
+        }
+
+        // Takes the next step. Returns true, with `segment` set, when the step closed one.
+        bool push(const MotionStep& step, MotionSegment& segment) {
+            ++stats.steps;
+            last = { static_cast<int64_t>(step.time), last.x + step.x, last.y + step.y };
+
+            // A segment of one point is taken whatever its rounding to the millisecond costs.
+            double deviation;
+            bool isFit = fits(window.data(), window.size(), last, deviation);
+            if (window.size() == 1 || (isFit && window.size() < kWindow)) {
+                window.push_back(last);
+                fitDeviation = deviation;
+                return false;
+            }
+
+            // The points so far end a segment; the new one starts the next.
+            segment = close(window.back());
+            Point anchor = window.back();
+            window.clear();
+            window.push_back(anchor);
+            fits(window.data(), window.size(), last, fitDeviation);
+            window.push_back(last);
+            return true;
+        }
+
+        // Closes the last segment. Returns false when there is none.
+        bool finish(MotionSegment& segment) {
+            if (window.size() < 2) return false;
+            segment = close(window.back());
+            Point anchor = window.back();
+            window.clear();
+            window.push_back(anchor);
+            return true;
+        }
+
+        SimplifyStats getStats() const { return stats; }
+
+        static std::vector<MotionSegment> simplify(const MotionStep* steps, size_t count, const SimplifyTolerance& tolerance,
+                                                   SimplifyStats* statsOut = nullptr) {
+            std::vector<Point> points(count + 1);
+            for (size_t i = 0; i < count; ++i) {
+                points[i + 1] = { static_cast<int64_t>(steps[i].time), points[i].x + steps[i].x, points[i].y + steps[i].y };
+            }
+
+            MotionSimplifier fitter(tolerance);
+            std::vector<bool> isVertex(points.size(), false);
+            isVertex.front() = isVertex.back() = true;
+            double maxDeviation = 0;
+
+            std::vector<std::pair<size_t, size_t>> spans;
+            if (count != 0) spans.push_back({ 0, count });
+            while (!spans.empty()) {
+                size_t a = spans.back().first, b = spans.back().second;
+                spans.pop_back();
+
+                double worst = 0;
+                size_t split = a + (b - a) / 2;
+                for (size_t i = a + 1; i <= b; ++i) {
+                    double deviation = fitter.deviation(points[a], points[b], points[i]);
+                    if (deviation > worst && i != b) split = i;
+                    worst = std::max(worst, deviation);
+                }
+                if (b - a < 2 || (worst <= tolerance.pixels && isSpanned(points[a], points[b]))) {
+                    maxDeviation = std::max(maxDeviation, worst);
+                    continue;
+                }
+                isVertex[split] = true;
+                spans.push_back({ split, b });
+                spans.push_back({ a, split });
+            }
+
+            std::vector<MotionSegment> segments;
+            for (size_t a = 0, b = 1; b < points.size(); ++b) {
+                if (!isVertex[b]) continue;
+                segments.push_back(segmentBetween(points[a], points[b]));
+                a = b;
+            }
+            if (statsOut) *statsOut = { count, segments.size(), maxDeviation };
+            return segments;
+        }
+
+    private:
+        // Position accumulated from the start of the trace.
+        struct Point {
+            int64_t time;  // microseconds
+            int32_t x;
+            int32_t y;
+        };
+
+        SimplifyTolerance tolerance;
+        SimplifyStats stats;
+        std::vector<Point> window;  // window[0] starts the open segment
+        Point last;
+        double fitDeviation;        // of the open segment as it stands
+
+        static int64_t vertexTime(const Point& point) { return (point.time + 500) / 1000 * 1000; }
+
+        static bool isSpanned(const Point& from, const Point& to) {
+            return std::abs(to.x - from.x) <= INT16_MAX && std::abs(to.y - from.y) <= INT16_MAX;
+        }
+
+        static MotionSegment segmentBetween(const Point& from, const Point& to) {
+            return { static_cast<int16_t>(to.x - from.x), static_cast<int16_t>(to.y - from.y),
+                     static_cast<uint32_t>((vertexTime(to) - vertexTime(from)) / 1000) };
+        }
+
+        // Distance from `point` to the segment from -> to over the times it may be met at.
+        double deviation(const Point& from, const Point& to, const Point& point) const {
+            double start = static_cast<double>(vertexTime(from)), end = static_cast<double>(vertexTime(to));
+            auto at = [&](double time, double& x, double& y) {
+                double progress = end > start ? std::max(0.0, std::min(1.0, (time - start) / (end - start))) : 1;
+                x = from.x + (to.x - from.x) * progress;
+                y = from.y + (to.y - from.y) * progress;
+            };
+
+            double time = static_cast<double>(point.time);
+            double lo = std::max(start, time - tolerance.time), hi = std::min(end, time + tolerance.time);
+            if (lo > hi) lo = hi = std::max(start, std::min(end, time));
+
+            double ax, ay, bx, by;
+            at(lo, ax, ay);
+            at(hi, bx, by);
+            double dx = bx - ax, dy = by - ay, length = dx * dx + dy * dy;
+            double t = length > 0 ? std::max(0.0, std::min(1.0, ((point.x - ax) * dx + (point.y - ay) * dy) / length)) : 0;
+            return std::hypot(point.x - (ax + t * dx), point.y - (ay + t * dy));
+        }
+
+        // Whether the segment from points[0] to `end` holds every point after the first and
+        // `end` itself.
+        bool fits(const Point* points, size_t count, const Point& end, double& worst) const {
+            worst = deviation(points[0], end, end);
+            if (!isSpanned(points[0], end) || worst > tolerance.pixels) return false;
+            for (size_t i = 1; i < count; ++i) {
+                worst = std::max(worst, deviation(points[0], end, points[i]));
+                if (worst > tolerance.pixels) return false;
+            }
+            return true;
+        }
+
+        MotionSegment close(const Point& end) {
+            ++stats.segments;
+            stats.maxDeviation = std::max(stats.maxDeviation, fitDeviation);
+            return segmentBetween(window.front(), end);
+        }
+    };
+
+    // Plays segments from now on one schedule, a moveRel per tick of `pollingRate`
+    // where the pointer moves, so time lost in one segment is made up in the next.
+    inline Status playSegments(Device& device, const MotionSegment* segments, size_t count, uint32_t pollingRate,
+                               bool isIgnoreErrors = false) {
+        Clock& clock = device.getClock();
+        Clock::time_point start = clock.now();
+        for (size_t i = 0; i < count; ++i) {
+            const MotionSegment& segment = segments[i];
+            PathSampler sampler(segment.x, segment.y, segment.duration, pollingRate, straightPath());
+            int32_t lastX = 0, lastY = 0;
+            for (uint32_t tick = 1; tick <= sampler.ticks(); ++tick) {
+                int32_t posX, posY;
+                sampler.at(tick, posX, posY);
+                if (posX != lastX || posY != lastY) {
+                    Status status = device.moveRel(saturateInt16(posX - lastX), saturateInt16(posY - lastY));
+                    if (status != Status::kSuccess && !isIgnoreErrors) return status;
+                    lastX = posX;
+                    lastY = posY;
+                }
+                clock.sleepUntil(start + sampler.elapsed(tick));
+            }
+            start += std::chrono::milliseconds(segment.duration);
+        }
+        return Status::kSuccess;
+    }
+};
@@ -0,0 +1,437 @@
+#pragma once
+#include "rx784.hpp"
+#include "rx784_queue.hpp"
+
+// Survives the board being replugged or re-enumerating, e.g. after reboot().
+//
+//     RX784::SupervisedDevice device;
+//     device.open("/dev/serial/by-id/usb-...");  // a name that survives re-enumeration
+//
+// When the port fails, the transport reopens it, checks with getDeviceSerialNumber that
+// the same unit came back, and puts back the keys, buttons and axes the host believes
+// are held before anything else goes out. Requests caught by the loss are then replayed
+// or dropped: motion (CommandQueue::isMotion) is dropped by default, since a move the
+// board already acted on would otherwise be applied twice; everything else, setPos and
+// mouse-state packets that change a button included, is replayed. A dropped request
+// fails with kSerialError, as it would have without supervision. A reboot is never
+// replayed: a loss while one is in flight is the reboot taking effect, so it succeeds,
+// and the requests ahead of it, whose effect the reboot has undone, are dropped.
+
+namespace RX784 {
+    class SupervisedTransport : public Transport {
+    public:
+        enum class Policy : uint8_t { kReplay, kDrop };
+
+        struct Options {
+            Policy motion;                           // requests CommandQueue::isMotion accepts
+            Policy other;
+            std::chrono::milliseconds timeout;       // longest outage before calls fail
+            std::chrono::microseconds retryInterval;
+        };
+
+        struct Stats {
+            uint64_t losses;
+            uint64_t recoveries;
+            uint64_t wrongUnits;     // a different serial number answered on the port
+            uint64_t replayed;
+            uint64_t dropped;
+            std::chrono::nanoseconds lastRecovery;  // from detecting the loss to the state being restored
+            std::chrono::nanoseconds maxRecovery;
+        };
+
+        static Options defaultOptions() {
+            return { Policy::kDrop, Policy::kReplay, std::chrono::milliseconds(5000), std::chrono::microseconds(500) };
+        }
+
+        SupervisedTransport()
+            : clock(&steadyClock()), options(defaultOptions()), inFlightHead(0), inFlightCount(0), held{},
+              isOnline(false), stats{}, frameSize(0), frameOffset(0) {}
+
+        SupervisedTransport(const SupervisedTransport&) = delete;
+        SupervisedTransport& operator=(const SupervisedTransport&) = delete;
+
+        ~SupervisedTransport() { close(); }
+
+        Status open(const std::string& port, const Options& options = defaultOptions()) {
+            close();
+            Status status = link.open(port);
+            if (status != Status::kSuccess) return status;
+
+            status = link.getDeviceSerialNumber(serialNumber);
+            if (status != Status::kSuccess) {
+                link.close();
+                return status;
+            }
+            this->port = port;
+            this->options = options;
+            held = Held{};
+            isOnline = true;
+            return Status::kSuccess;
+        }
+
+        // Takes one frame or several back to back, as CommandQueue coalesces them. Each
+        // frame is a request in flight of its own. Once any frame of a batch is in flight
+        // the send succeeds, and a frame dropped by a loss fails when its response is read.
+        bool send(const void* buffer, size_t size) override {
+            const uint8_t* packet = static_cast<const uint8_t*>(buffer);
+            size_t count = 0;
+            for (size_t offset = 0; offset < size; offset += 4u + packet[offset + 2], ++count) {
+                const uint8_t* at = &packet[offset];
+                if (size - offset < 4 || at[0] != 0xBE || at[2] > size - offset - 4 || at[3 + at[2]] != 0xED) return false;
+            }
+            if (port.empty() || count == 0 || inFlightCount + count > kCapacity) return false;
+
+            // After a loss that outlasted the timeout, each new request tries the port once.
+            if (!isOnline && !recover(clock->now())) return false;
+
+            size_t first = inFlightCount;
+            for (size_t offset = 0; offset < size; offset += 4u + packet[offset + 2]) {
+                const uint8_t* at = &packet[offset];
+                Slot& slot = inFlight[(inFlightHead + inFlightCount) % kCapacity];
+                slot.isDropped = !Device::Request::relay(at[1], &at[3], at[2], slot.request);
+                slot.isAnswered = false;
+                ++inFlightCount;
+
+                if (slot.isDropped) continue;
+                if (!isOnline) {
+                    slot.isDropped = true;
+                    ++stats.dropped;
+                    continue;
+                }
+                if (link.sendRequest(slot.request) != Status::kSuccess) handleLoss();
+            }
+
+            for (size_t i = first; i < inFlightCount; ++i) {
+                if (!inFlight[(inFlightHead + i) % kCapacity].isDropped) return true;
+            }
+            // The Device will not wait for answers to a send that failed.
+            inFlightCount = first;
+            return false;
+        }
+
+        size_t recv(void* buffer, size_t size) override {
+            size_t copied = 0;
+            while (copied < size) {
+                if (frameOffset == frameSize && !nextFrame()) break;
+
+                size_t chunk = std::min(size - copied, frameSize - frameOffset);
+                memcpy(static_cast<uint8_t*>(buffer) + copied, &frame[frameOffset], chunk);
+                frameOffset += chunk;
+                copied += chunk;
+            }
+            return copied;
+        }
+
+        bool close() override {
+            bool ok = port.empty() || !isOnline || link.close() == Status::kSuccess;
+            port.clear();
+            isOnline = false;
+            inFlightHead = inFlightCount = 0;
+            frameSize = frameOffset = 0;
+            return ok;
+        }
+
+        bool isConnected() const { return isOnline; }
+        Stats getStats() const { return stats; }
+
+        // Outage deadlines, retry waits and recovery times are measured on `clock`.
+        void setClock(Clock& clock) { this->clock = &clock; }
+
+    private:
+        static constexpr size_t kCapacity = 64;
+
+        struct Slot {
+            Device::Request request;
+            bool isDropped;
+            bool isAnswered;  // a reboot the loss completed; no response will be read
+        };
+
+        // What the board should be holding, in wire encoding.
+        struct Held {
+            uint8_t modifierKeys;
+            uint8_t regularKeys[7];
+            uint8_t buttons;
+            int16_t axes[3];
+            int16_t screen[2];
+            bool hasScreen;
+        };
+
+        Clock* clock;
+        Device link;
+        std::string port;
+        Options options;
+        std::vector<uint8_t> serialNumber;
+        Slot inFlight[kCapacity];
+        size_t inFlightHead;
+        size_t inFlightCount;
+        Held held;
+        bool isOnline;
+        Stats stats;
+        uint8_t frame[4 + sizeof(Device::Request::response)];
+        size_t frameSize;
+        size_t frameOffset;
+
+        // Answers the oldest request. A dropped or failed one yields no bytes, which the
+        // Device reports as a serial error.
+        bool nextFrame() {
+            frameSize = frameOffset = 0;
+            if (inFlightCount == 0) return false;
+
+            Slot& slot = inFlight[inFlightHead];
+            Status status = slot.isAnswered ? Status::kSuccess : Status::kSerialError;
+            while (!slot.isDropped && !slot.isAnswered) {
+                status = link.recvResponse(slot.request);
+                if (status != Status::kSerialError || !handleLoss()) break;
+            }
+            inFlightHead = (inFlightHead + 1) % kCapacity;
+            --inFlightCount;
+            if (slot.isDropped || status != Status::kSuccess) return false;
+
+            const Device::Request& request = slot.request;
+            track(request);
+            frame[0] = 0xBE;
+            frame[1] = static_cast<uint8_t>(request.cmd);
+            frame[2] = request.responseSize;
+            memcpy(&frame[3], request.response, request.responseSize);
+            frame[3 + request.responseSize] = 0xED;
+            frameSize = 4u + request.responseSize;
+            return true;
+        }
+
+        // Reconnects, restores and resends what is in flight. On false every request in
+        // flight has been dropped.
+        bool handleLoss() {
+            Clock::time_point start = clock->now();
+            ++stats.losses;
+            isOnline = false;
+            completeReboot();
+
+            Clock::time_point deadline = start + options.timeout;
+            bool isRecovered = recover(deadline);
+            for (bool isResent = false; isRecovered && !isResent; ) {
+                isResent = true;
+                for (size_t i = 0; i < inFlightCount && isResent; ++i) {
+                    Slot& slot = inFlight[(inFlightHead + i) % kCapacity];
+                    if (slot.isDropped || slot.isAnswered) continue;
+
+                    if (slot.request.cmd == Device::Command::kReboot ||
+                        (CommandQueue::isMotion(slot.request) ? options.motion : options.other) == Policy::kDrop) {
+                        slot.isDropped = true;
+                        ++stats.dropped;
+                        continue;
+                    }
+                    isResent = link.sendRequest(slot.request) == Status::kSuccess;
+                    if (isResent) ++stats.replayed;
+                }
+                if (!isResent) {
+                    isOnline = false;
+                    isRecovered = recover(deadline);
+                }
+            }
+
+            if (!isRecovered) {
+                for (size_t i = 0; i < inFlightCount; ++i) {
+                    Slot& slot = inFlight[(inFlightHead + i) % kCapacity];
+                    slot.isDropped = !slot.isAnswered;
+                }
+                return false;
+            }
+
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock->now() - start);
+            ++stats.recoveries;
+            stats.lastRecovery = elapsed;
+            stats.maxRecovery = std::max(stats.maxRecovery, elapsed);
+            return true;
+        }
+
+        // Answers the first reboot in flight as the board would have and drops what is
+        // ahead of it. The held state is cleared now, so recover() does not put back keys
+        // and buttons the reboot released.
+        void completeReboot() {
+            size_t reboot = 0;
+            for (; reboot < inFlightCount; ++reboot) {
+                const Slot& slot = inFlight[(inFlightHead + reboot) % kCapacity];
+                if (!slot.isDropped && !slot.isAnswered && slot.request.cmd == Device::Command::kReboot) break;
+            }
+            if (reboot == inFlightCount) return;
+
+            for (size_t i = 0; i < reboot; ++i) {
+                Slot& slot = inFlight[(inFlightHead + i) % kCapacity];
+                if (slot.isDropped || slot.isAnswered) continue;
+                slot.isDropped = true;
+                ++stats.dropped;
+            }
+            Slot& slot = inFlight[(inFlightHead + reboot) % kCapacity];
+            slot.isAnswered = true;
+            slot.request.responseSize = 1;
+            slot.request.response[0] = static_cast<uint8_t>(Status::kSuccess);
+            track(slot.request);
+        }
+
+        // Reopens the port until the same unit answers and takes the held state, or the
+        // deadline passes. Tries at least once.
+        bool recover(Clock::time_point deadline) {
+            for (;;) {
+                link.close();
+                std::vector<uint8_t> number;
+                if (link.open(port) == Status::kSuccess && link.getDeviceSerialNumber(number) == Status::kSuccess) {
+                    if (number != serialNumber) {
+                        ++stats.wrongUnits;
+                    } else if (restore()) {
+                        isOnline = true;
+                        return true;
+                    }
+                }
+                if (clock->now() + options.retryInterval > deadline) {
+                    link.close();
+                    return false;
+                }
+                clock->sleepFor(options.retryInterval);
+            }
+        }
+
+        bool restore() {
+            Device::Request requests[8];
+            size_t count = 0;
+
+            if (held.modifierKeys != 0 || std::any_of(std::begin(held.regularKeys), std::end(held.regularKeys), [](uint8_t key) { return key != 0; })) {
+                uint8_t state[10] = { 0xFF, 0x7F, held.modifierKeys };
+                memcpy(&state[3], held.regularKeys, sizeof(held.regularKeys));
+                Device::Request::relay(static_cast<uint8_t>(Device::Command::kSendKeyboardState), state, sizeof(state), requests[count++]);
+            }
+            for (uint8_t button = 0; button < 5; ++button) {
+                if (held.buttons & (1u << button)) {
+                    Device::Request::relay(static_cast<uint8_t>(Device::Command::kButtonDown), &button, 1, requests[count++]);
+                }
+            }
+            if (held.hasScreen) {
+                Device::Request::relay(static_cast<uint8_t>(Device::Command::kInitAbsSystem), held.screen, sizeof(held.screen), requests[count++]);
+            }
+            if (held.hasScreen || held.axes[0] != 0 || held.axes[1] != 0 || held.axes[2] != 0) {
+                Device::Request::relay(static_cast<uint8_t>(Device::Command::kSetAxes), held.axes, sizeof(held.axes), requests[count++]);
+            }
+
+            for (size_t i = 0; i < count; ++i) {
+                if (link.sendRequest(requests[i]) != Status::kSuccess) return false;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                if (link.recvResponse(requests[i]) != Status::kSuccess || requests[i].result() != Status::kSuccess) return false;
+            }
+            return true;
+        }
+
+        static int16_t int16At(const uint8_t* data, size_t index) {
+            int16_t value;
+            memcpy(&value, &data[index * 2], sizeof(value));
+            return value;
+        }
+
+        void setKey(uint8_t key, bool isDown) {
+            if (key >= 0xE0 && key <= 0xE7) {
+                uint8_t bit = static_cast<uint8_t>(1u << (key - 0xE0));
+                held.modifierKeys = isDown ? (held.modifierKeys | bit) : (held.modifierKeys & ~bit);
+                return;
+            }
+            uint8_t* end = held.regularKeys + sizeof(held.regularKeys);
+            uint8_t* slot = std::find(held.regularKeys, end, key);
+            if (isDown && slot == end) slot = std::find(held.regularKeys, end, 0);
+            if (slot != end) *slot = isDown ? key : 0;
+        }
+
+        void setButtons(uint8_t mask, uint8_t state) {
+            held.buttons = static_cast<uint8_t>((held.buttons & ~mask) | (state & mask));
+        }
+
+        // Mirrors a request the board has acknowledged.
+        void track(const Device::Request& request) {
+            if (request.responseSize != 1 || request.result() != Status::kSuccess) return;
+            const uint8_t* data = request.data;
+            uint8_t size = request.dataSize;
+
+            switch (request.cmd)
+            {
+            case Device::Command::kReboot:
+            case Device::Command::kReleaseAllKeys:
+                held.modifierKeys = 0;
+                memset(held.regularKeys, 0, sizeof(held.regularKeys));
+                if (request.cmd == Device::Command::kReboot) held.buttons = 0;
+                break;
+            case Device::Command::kKeyDown:
+            case Device::Command::kKeyUp:
+                if (size == 1) setKey(data[0], request.cmd == Device::Command::kKeyDown);
+                break;
+            case Device::Command::kSendKeyboardState:
+                if (size != 10) break;
+                held.modifierKeys = static_cast<uint8_t>((held.modifierKeys & ~data[0]) | (data[2] & data[0]));
+                for (size_t i = 0; i < 7; ++i) if (data[1] & (1u << i)) held.regularKeys[i] = data[3 + i];
+                break;
+            case Device::Command::kButtonDown:
+            case Device::Command::kButtonUp:
+                if (size == 1 && data[0] < 5) {
+                    setButtons(static_cast<uint8_t>(1u << data[0]), request.cmd == Device::Command::kButtonDown ? 0xFF : 0);
+                }
+                break;
+            case Device::Command::kReleaseAllButtons:
+                held.buttons = 0;
+                break;
+            case Device::Command::kMoveRel:
+                if (size != 4) break;
+                held.axes[0] = saturateInt16(held.axes[0] + int16At(data, 0));
+                held.axes[1] = saturateInt16(held.axes[1] + int16At(data, 1));
+                break;
+            case Device::Command::kScrollRel:
+                if (size == 2) held.axes[2] = saturateInt16(held.axes[2] + int16At(data, 0));
+                break;
+            case Device::Command::kSendRelMouseState:
+            case Device::Command::kSendAbsMouseState: {
+                if (size != 8) break;
+                bool isRelative = request.cmd == Device::Command::kSendRelMouseState;
+                setButtons(data[0] & 0x07, data[1]);
+                for (size_t i = 0; i < 3; ++i) {
+                    if (!(data[0] & (0x08 << i))) continue;
+                    int16_t value = int16At(&data[2], i);
+                    held.axes[i] = isRelative ? saturateInt16(held.axes[i] + value) : value;
+                }
+                break;
+            }
+            case Device::Command::kInitAbsSystem:
+                if (size != 4) break;
+                held.screen[0] = int16At(data, 0);
+                held.screen[1] = int16At(data, 1);
+                held.hasScreen = true;
+                break;
+            case Device::Command::kMoveAbs:
+            case Device::Command::kSetPos:
+                if (size != 4) break;
+                held.axes[0] = int16At(data, 0);
+                held.axes[1] = int16At(data, 1);
+                break;
+            case Device::Command::kScrollAbs:
+            case Device::Command::kSetWheelAxis:
+                if (size == 2) held.axes[2] = int16At(data, 0);
+                break;
+            case Device::Command::kSetAxes:
+                if (size != 6) break;
+                for (size_t i = 0; i < 3; ++i) held.axes[i] = int16At(data, i);
+                break;
+            default:
+                break;
+            }
+        }
+    };
+
+    class SupervisedDevice : public Device {
+    public:
+        Status open(const std::string& port,
+                    const SupervisedTransport::Options& options = SupervisedTransport::defaultOptions()) {
+            Status status = link.open(port, options);
+            if (status != Status::kSuccess) return status;
+            return Device::open(link);
+        }
+
+        SupervisedTransport::Stats getSupervisionStats() const { return link.getStats(); }
+
+    private:
+        SupervisedTransport link;
+    };
+};
@@ -0,0 +1,135 @@
+#pragma once
+#include "rx784.hpp"
+#include <atomic>
+#include <cstdio>
+
+namespace RX784 {
+    // Captures every frame on the wire into a preallocated lock-free ring. Producers never
+    // lock or allocate; when the ring is full the record is dropped and counted. A background
+    // thread appends the ring to a compact binary file that tools/rx784_trace.cpp prints.
+    class Tracer : public TraceSink {
+    public:
+        static constexpr uint8_t kFailed    = 1;
+        static constexpr uint8_t kTruncated = 2;
+
+#pragma pack(push, 1)
+        struct FileHeader {
+            char magic[8];       // "RX784TRC"
+            uint32_t version;
+            uint32_t captureSize;
+            uint64_t startTime;  // Unix time in ns when the tracer was created
+        };
+
+        struct RecordHeader {
+            uint64_t timestamp;  // ns since startTime, from the monotonic clock
+            Direction direction;
+            uint8_t channel;
+            uint8_t cmd;
+            uint8_t flags;
+            uint16_t frameSize;
+            uint8_t capturedSize;  // bytes of the frame that follow the header
+        };
+#pragma pack(pop)
+
+        // `capacity` is rounded up to a power of two.
+        explicit Tracer(const std::string& path, size_t capacity = 4096)
+            : mask(1), dequeuePos(0), enqueuePos(0), droppedCount(0), isStopping(false),
+              startTime(std::chrono::steady_clock::now()), file(std::fopen(path.c_str(), "wb")) {
+            while (mask < capacity) mask <<= 1;
+            slots.reset(new Slot[mask]);
+            for (size_t i = 0; i < mask; ++i) slots[i].sequence.store(i, std::memory_order_relaxed);
+            --mask;
+
+            if (!file) return;
+
+            FileHeader header = { { 'R', 'X', '7', '8', '4', 'T', 'R', 'C' }, 1, maxCaptureSize(),
+                static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count()) };
+            std::fwrite(&header, sizeof(header), 1, file);
+            writer = std::thread(&Tracer::writeLoop, this);
+        }
+
+        Tracer(const Tracer&) = delete;
+        Tracer& operator=(const Tracer&) = delete;
+
+        ~Tracer() {
+            if (!file) return;
+            isStopping.store(true, std::memory_order_release);
+            writer.join();
+            std::fclose(file);
+        }
+
+        bool isOpen() const { return file != nullptr; }
+        uint64_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+        void record(Direction direction, uint8_t channel, uint8_t cmd, const void* frame, size_t frameSize,
+                    bool isFailed) override {
+            uint64_t pos = enqueuePos.load(std::memory_order_relaxed);
+            Slot* slot;
+            for (;;) {
+                slot = &slots[pos & mask];
+                int64_t diff = static_cast<int64_t>(slot->sequence.load(std::memory_order_acquire) - pos);
+                if (diff == 0) {
+                    if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                } else if (diff < 0) {
+                    droppedCount.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                } else {
+                    pos = enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            size_t capturedSize = std::min(frameSize, maxCaptureSize());
+            slot->header.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - startTime).count());
+            slot->header.direction = direction;
+            slot->header.channel = channel;
+            slot->header.cmd = cmd;
+            slot->header.flags = static_cast<uint8_t>((isFailed ? kFailed : 0) | (capturedSize < frameSize ? kTruncated : 0));
+            slot->header.frameSize = static_cast<uint16_t>(std::min<size_t>(frameSize, UINT16_MAX));
+            slot->header.capturedSize = static_cast<uint8_t>(capturedSize);
+            if (capturedSize) memcpy(slot->frame, frame, capturedSize);
+            slot->sequence.store(pos + 1, std::memory_order_release);
+        }
+
+    private:
+        static constexpr size_t kCaptureSize = maxCaptureSize();
+
+        struct Slot {
+            std::atomic<uint64_t> sequence;
+            RecordHeader header;
+            uint8_t frame[kCaptureSize];
+        };
+
+        std::unique_ptr<Slot[]> slots;
+        size_t mask;
+        uint64_t dequeuePos;
+        alignas(64) std::atomic<uint64_t> enqueuePos;
+        alignas(64) std::atomic<uint64_t> droppedCount;
+        std::atomic<bool> isStopping;
+        std::chrono::steady_clock::time_point startTime;
+        FILE* file;
+        std::thread writer;
+
+        void drain() {
+            for (;;) {
+                Slot& slot = slots[dequeuePos & mask];
+                if (slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1) break;
+
+                std::fwrite(&slot.header, sizeof(slot.header), 1, file);
+                std::fwrite(slot.frame, 1, slot.header.capturedSize, file);
+                slot.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+                ++dequeuePos;
+            }
+        }
+
+        void writeLoop() {
+            while (!isStopping.load(std::memory_order_acquire)) {
+                drain();
+                std::fflush(file);
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            drain();
+        }
+    };
+};
@@ -0,0 +1,354 @@
+#pragma once
+#include "rx784.hpp"
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+// Serial transport on io_uring, for hosts that drive many boards. Linux 5.11 or later.
+//
+//     RX784::UringTransport link;
+//     if (link.open("/dev/ttyACM0") == RX784::Status::kSuccess) device.open(link);
+//
+// A read is always posted on the port, so response bytes land in a local buffer without
+// a syscall of their own. Writes passed to send(), a frame or a coalesced batch of
+// them, are queued as linked write SQEs and go out together with the next wait for a
+// response, so a request/response exchange costs one io_uring_enter instead of a write
+// plus a poll and read per field of the response. Completions are reaped in bulk. Each
+// transport owns its ring, like each Device owns its port, so no locking is needed.
+
+namespace RX784 {
+    class UringTransport : public Transport {
+    public:
+        struct Stats {
+            uint64_t enters;
+            uint64_t submitted;
+            uint64_t completed;
+        };
+
+        UringTransport()
+            : fd(-1), ringFd(-1), ring{}, txSlots{}, txBusy(0), txQueued{}, txQueuedCount(0), writesInFlight(0),
+              isReadPosted(false), isFailed(false), rxBegin(0), rxEnd(0), stats{} {}
+
+        UringTransport(const UringTransport&) = delete;
+        UringTransport& operator=(const UringTransport&) = delete;
+
+        ~UringTransport() { close(); }
+
+        Status open(const std::string& port) {
+            close();
+            fd = openSerialPort(port.c_str(), 250000);
+            if (fd < 0) return Status::kSerialError;
+
+            // Posted reads must wait for data: with VMIN = 0 a terminal read returns 0 at once.
+            struct termios2 tio{};
+            if (ioctl(fd, TCGETS2, &tio) != 0) goto Error;
+            tio.c_cc[VMIN] = 1;
+            if (ioctl(fd, TCSETS2, &tio) != 0) goto Error;
+
+            if (!setupRing()) goto Error;
+            isFailed = false;
+            rxBegin = rxEnd = 0;
+            postRead();
+            return Status::kSuccess;
+        Error:
+            close();
+            return Status::kSerialError;
+        }
+
+        bool send(const void* buffer, size_t size) override {
+            if (fd < 0 || isFailed || size > kTxSlotSize) return false;
+
+            while (txBusy == kTxSlotMask) {
+                if (!flushWrites() || !enter(0, 1, std::chrono::milliseconds(50))) return false;
+                reap();
+            }
+            size_t slot = 0;
+            while (txBusy & (1u << slot)) ++slot;
+            txBusy |= 1u << slot;
+
+            memcpy(txSlots[slot].data, buffer, size);
+            txSlots[slot].size = size;
+            txQueued[txQueuedCount++] = static_cast<uint8_t>(slot);
+            return true;
+        }
+
+        // Same timeouts as the plain serial path: 50 ms + 10 ms per byte in total.
+        size_t recv(void* buffer, size_t size) override {
+            using Clock = std::chrono::steady_clock;
+            Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(50 + 10 * size);
+
+            while (rxEnd - rxBegin < size && fd >= 0 && !isFailed) {
+                auto remaining = deadline - Clock::now();
+                if (remaining <= Clock::duration::zero()) break;
+                if (!flushWrites()) break;
+                if (!enter(pendingSubmissions(), 1, std::min<Clock::duration>(remaining, std::chrono::milliseconds(50)))) break;
+                reap();
+            }
+
+            size_t copied = std::min(size, rxEnd - rxBegin);
+            memcpy(buffer, &rxBuffer[rxBegin], copied);
+            rxBegin += copied;
+            if (rxBegin == rxEnd) rxBegin = rxEnd = 0;
+            return copied;
+        }
+
+        bool close() override {
+            if (ringFd >= 0) {
+                isFailed = true;  // stops reap() from posting another read
+                if (isReadPosted) {
+                    io_uring_sqe* sqe = nextSqe();
+                    if (sqe) {
+                        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                        sqe->addr = kReadTag;
+                        sqe->user_data = kCancelTag;
+                    }
+                }
+                // The kernel must be done with rxBuffer and the write slots before they go away.
+                for (int i = 0; i < 20 && (isReadPosted || writesInFlight != 0); ++i) {
+                    if (!enter(pendingSubmissions(), 1, std::chrono::milliseconds(10))) break;
+                    reap();
+                }
+                unmapRing();
+                ::close(ringFd);
+                ringFd = -1;
+            }
+            bool ok = fd < 0 || ::close(fd) == 0;
+            fd = -1;
+            txBusy = 0;
+            txQueuedCount = 0;
+            writesInFlight = 0;
+            isReadPosted = false;
+            return ok;
+        }
+
+        Stats getStats() const { return stats; }
+
+    private:
+        static constexpr uint32_t kRingEntries = 64;
+        static constexpr size_t kTxSlotCount = 16;
+        static constexpr uint32_t kTxSlotMask = (1u << kTxSlotCount) - 1;
+        static constexpr size_t kTxSlotSize = Device::Request::maxBatchFrames() * Device::Request::maxFrameSize();
+        static constexpr size_t kReadSize = 256;
+        static constexpr uint64_t kReadTag = 1u << 16;
+        static constexpr uint64_t kCancelTag = kReadTag + 1;
+
+        struct Ring {
+            uint32_t* sqHead;
+            uint32_t* sqTail;
+            uint32_t sqMask;
+            uint32_t sqEntries;
+            uint32_t* sqArray;
+            io_uring_sqe* sqes;
+            uint32_t* cqHead;
+            uint32_t* cqTail;
+            uint32_t cqMask;
+            io_uring_cqe* cqes;
+            void* sqMapping;
+            size_t sqMappingSize;
+            void* cqMapping;
+            size_t cqMappingSize;
+            size_t sqesSize;
+            uint32_t localTail;
+            uint32_t submittedTail;
+        };
+
+        struct TxSlot {
+            uint8_t data[kTxSlotSize];
+            size_t size;
+        };
+
+        int fd;
+        int ringFd;
+        Ring ring;
+        TxSlot txSlots[kTxSlotCount];
+        uint32_t txBusy;
+        uint8_t txQueued[kTxSlotCount];
+        size_t txQueuedCount;
+        size_t writesInFlight;
+        bool isReadPosted;
+        bool isFailed;
+        uint8_t readBuffer[kReadSize];
+        uint8_t rxBuffer[4096];
+        size_t rxBegin;
+        size_t rxEnd;
+        Stats stats;
+
+        bool setupRing() {
+            io_uring_params params{};
+            ringFd = static_cast<int>(syscall(__NR_io_uring_setup, kRingEntries, &params));
+            if (ringFd < 0) return false;
+            if (!(params.features & IORING_FEAT_EXT_ARG)) return false;
+
+            ring.sqMappingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+            ring.cqMappingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                ring.sqMappingSize = ring.cqMappingSize = std::max(ring.sqMappingSize, ring.cqMappingSize);
+            }
+
+            ring.sqMapping = mmap(nullptr, ring.sqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                  ringFd, IORING_OFF_SQ_RING);
+            if (ring.sqMapping == MAP_FAILED) return false;
+            ring.cqMapping = ring.sqMapping;
+            if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+                ring.cqMapping = mmap(nullptr, ring.cqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                      ringFd, IORING_OFF_CQ_RING);
+                if (ring.cqMapping == MAP_FAILED) return false;
+            }
+            ring.sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            void* sqes = mmap(nullptr, ring.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              ringFd, IORING_OFF_SQES);
+            if (sqes == MAP_FAILED) return false;
+
+            uint8_t* sq = static_cast<uint8_t*>(ring.sqMapping);
+            uint8_t* cq = static_cast<uint8_t*>(ring.cqMapping);
+            ring.sqHead    = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+            ring.sqTail    = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+            ring.sqMask    = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+            ring.sqEntries = params.sq_entries;
+            ring.sqArray   = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+            ring.sqes      = static_cast<io_uring_sqe*>(sqes);
+            ring.cqHead    = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+            ring.cqTail    = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+            ring.cqMask    = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+            ring.cqes      = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            ring.localTail = ring.submittedTail = *ring.sqTail;
+            return true;
+        }
+
+        void unmapRing() {
+            auto isMapped = [](void* mapping) { return mapping && mapping != MAP_FAILED; };
+            if (isMapped(ring.sqes)) munmap(ring.sqes, ring.sqesSize);
+            if (isMapped(ring.cqMapping) && ring.cqMapping != ring.sqMapping) munmap(ring.cqMapping, ring.cqMappingSize);
+            if (isMapped(ring.sqMapping)) munmap(ring.sqMapping, ring.sqMappingSize);
+            ring = Ring{};
+        }
+
+        io_uring_sqe* nextSqe() {
+            if (ring.localTail - __atomic_load_n(ring.sqHead, __ATOMIC_ACQUIRE) >= ring.sqEntries) return nullptr;
+            uint32_t index = ring.localTail & ring.sqMask;
+            io_uring_sqe* sqe = &ring.sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            ring.sqArray[index] = index;
+            ++ring.localTail;
+            return sqe;
+        }
+
+        uint32_t pendingSubmissions() const { return ring.localTail - ring.submittedTail; }
+
+        bool enter(uint32_t toSubmit, uint32_t waitCount, std::chrono::nanoseconds timeout) {
+            __atomic_store_n(ring.sqTail, ring.localTail, __ATOMIC_RELEASE);
+
+            __kernel_timespec ts = { static_cast<int64_t>(timeout.count() / 1000000000),
+                                     static_cast<long long>(timeout.count() % 1000000000) };
+            io_uring_getevents_arg arg{};
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+
+            unsigned flags = waitCount ? IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG : 0;
+            long submitted = syscall(__NR_io_uring_enter, ringFd, toSubmit, waitCount, flags,
+                                     waitCount ? static_cast<void*>(&arg) : nullptr, waitCount ? sizeof(arg) : 0);
+            ++stats.enters;
+            if (submitted < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+                isFailed = true;
+                return false;
+            }
+            if (submitted > 0) {
+                ring.submittedTail += static_cast<uint32_t>(submitted);
+                stats.submitted += static_cast<uint64_t>(submitted);
+            }
+            return true;
+        }
+
+        void postRead() {
+            io_uring_sqe* sqe = nextSqe();
+            if (!sqe) return;
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = fd;
+            sqe->addr = reinterpret_cast<uint64_t>(readBuffer);
+            sqe->len = kReadSize;
+            sqe->off = static_cast<uint64_t>(-1);
+            sqe->user_data = kReadTag;
+            isReadPosted = true;
+        }
+
+        // Queues every frame handed to send() as one linked chain, so they reach the port
+        // in order. A new chain waits until the previous one has completed.
+        bool flushWrites() {
+            if (txQueuedCount == 0) return true;
+            while (writesInFlight != 0) {
+                if (!enter(pendingSubmissions(), 1, std::chrono::milliseconds(50))) return false;
+                reap();
+                if (isFailed) return false;
+            }
+            if (ring.sqEntries - (ring.localTail - __atomic_load_n(ring.sqHead, __ATOMIC_ACQUIRE)) < txQueuedCount) {
+                if (!enter(pendingSubmissions(), 0, std::chrono::nanoseconds(0))) return false;
+            }
+
+            for (size_t i = 0; i < txQueuedCount; ++i) {
+                size_t slot = txQueued[i];
+                io_uring_sqe* sqe = nextSqe();
+                sqe->opcode = IORING_OP_WRITE;
+                sqe->fd = fd;
+                sqe->addr = reinterpret_cast<uint64_t>(txSlots[slot].data);
+                sqe->len = static_cast<uint32_t>(txSlots[slot].size);
+                sqe->off = static_cast<uint64_t>(-1);
+                sqe->user_data = slot;
+                if (i + 1 < txQueuedCount) sqe->flags = IOSQE_IO_LINK;
+            }
+            writesInFlight += txQueuedCount;
+            txQueuedCount = 0;
+            return true;
+        }
+
+        void reap() {
+            uint32_t head = *ring.cqHead;
+            uint32_t tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+
+            for (; head != tail; ++head) {
+                const io_uring_cqe& cqe = ring.cqes[head & ring.cqMask];
+                ++stats.completed;
+
+                if (cqe.user_data == kReadTag) {
+                    isReadPosted = false;
+                    if (cqe.res > 0) {
+                        if (rxBegin != 0 && rxEnd + static_cast<size_t>(cqe.res) > sizeof(rxBuffer)) {
+                            memmove(rxBuffer, &rxBuffer[rxBegin], rxEnd - rxBegin);
+                            rxEnd -= rxBegin;
+                            rxBegin = 0;
+                        }
+                        size_t size = std::min<size_t>(static_cast<size_t>(cqe.res), sizeof(rxBuffer) - rxEnd);
+                        memcpy(&rxBuffer[rxEnd], readBuffer, size);
+                        rxEnd += size;
+                    } else if (cqe.res != -ECANCELED && cqe.res != -EINTR) {
+                        isFailed = true;
+                    }
+                    if (ringFd >= 0 && !isFailed && fd >= 0) postRead();
+                } else if (cqe.user_data < kTxSlotCount) {
+                    // A short write breaks the chain; finish it and the cancelled rest in order.
+                    TxSlot& slot = txSlots[cqe.user_data];
+                    size_t written = cqe.res > 0 ? static_cast<size_t>(cqe.res) : 0;
+                    if (written < slot.size && (cqe.res >= 0 || cqe.res == -ECANCELED)) {
+                        written += writeAll(&slot.data[written], slot.size - written);
+                    }
+                    if (written != slot.size) isFailed = true;
+
+                    txBusy &= ~(1u << cqe.user_data);
+                    --writesInFlight;
+                }
+            }
+            __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+        }
+
+        size_t writeAll(const uint8_t* data, size_t size) {
+            size_t written = 0;
+            while (written < size) {
+                pollfd pfd = { fd, POLLOUT, 0 };
+                if (poll(&pfd, 1, 50) <= 0) break;
+                ssize_t n = ::write(fd, &data[written], size - written);
+                if (n <= 0) break;
+                written += static_cast<size_t>(n);
+            }
+            return written;
+        }
+    };
+};
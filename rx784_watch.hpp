@@ -0,0 +1,249 @@
+#pragma once
+#include "rx784.hpp"
+#include "rx784_queue.hpp"
+
+namespace RX784 {
+    // Polls the board's keyboard, button and LED state through a CommandQueue and reports
+    // what changed. Each of the three fields has its own poll interval: it drops to
+    // Pacing::fastest whenever that field changes and grows by Pacing::backoff with every
+    // unchanged poll until it reaches Pacing::slowest.
+    //
+    // Polls go into the bulk lane with at most one outstanding per field, so they take
+    // their turn between queued motion instead of getting ahead of it. Callbacks run on
+    // the watcher's own thread and may use the queue themselves. The first successful
+    // poll of each field only sets the baseline and does not call back. Polls are paced
+    // by the queue's clock.
+    class StateWatcher {
+    public:
+        using Clock = CommandQueue::Clock;
+
+        struct Pacing {
+            std::chrono::microseconds fastest;
+            std::chrono::microseconds slowest;
+            double backoff;
+        };
+
+        struct Stats {
+            uint64_t polls;
+            uint64_t changes;
+            uint64_t errors;
+        };
+
+        using KeyCallback    = std::function<void(VirtualKeyCode key, bool isDown)>;
+        using ButtonCallback = std::function<void(Button button, bool isDown)>;
+        using LEDsCallback   = std::function<void(const KeyboardLEDsState& previous, const KeyboardLEDsState& current)>;
+
+        explicit StateWatcher(CommandQueue& queue,
+                              Pacing pacing = { std::chrono::milliseconds(2), std::chrono::milliseconds(50), 1.25 })
+            : queue(queue), clock(queue.getClock()), pacing(pacing), stats{}, isStopping(false) {
+            probes[kKeyboard].build = Device::Request::getKeyboardState;
+            probes[kButtons].build  = Device::Request::getButtonsState;
+            probes[kLEDs].build     = Device::Request::getKeyboardLEDsState;
+            for (Probe& probe : probes) {
+                probe.entry.context = this;
+                probe.entry.onComplete = complete;
+                probe.interval = pacing.slowest;
+            }
+        }
+
+        StateWatcher(const StateWatcher&) = delete;
+        StateWatcher& operator=(const StateWatcher&) = delete;
+
+        ~StateWatcher() { stop(); }
+
+        // Callbacks are set before start() and stay fixed while the watcher runs.
+        void onKey(KeyCallback callback)          { keyCallback = std::move(callback); }
+        void onButton(ButtonCallback callback)    { buttonCallback = std::move(callback); }
+        void onKeyboardLEDs(LEDsCallback callback) { ledsCallback = std::move(callback); }
+
+        void start() {
+            if (thread.joinable()) return;
+            isStopping = false;
+            clock.attach();
+            thread = std::thread(&StateWatcher::run, this);
+        }
+
+        void stop() {
+            if (!thread.joinable()) return;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                isStopping = true;
+            }
+            clock.notifyOne(condition);
+            thread.join();
+            clock.detach();
+        }
+
+        Stats getStats() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return stats;
+        }
+
+    private:
+        enum Field { kKeyboard, kButtons, kLEDs, kFieldCount };
+
+        struct Probe {
+            CommandQueue::Entry entry{};
+            Device::Request (*build)();
+            Device::Request last{};
+            std::chrono::nanoseconds interval{};
+            Clock::time_point due{};
+            bool isInFlight = false;
+            bool isDone = false;
+            bool hasBaseline = false;
+        };
+
+        CommandQueue& queue;
+        RX784::Clock& clock;
+        Pacing pacing;
+        Probe probes[kFieldCount];
+        KeyCallback keyCallback;
+        ButtonCallback buttonCallback;
+        LEDsCallback ledsCallback;
+        Stats stats;
+        mutable std::mutex mutex;
+        std::condition_variable condition;
+        bool isStopping;
+        std::thread thread;
+
+        // Runs on the queue's I/O thread; the diffing happens on the watcher thread.
+        static void complete(CommandQueue::Entry& entry) {
+            StateWatcher& watcher = *static_cast<StateWatcher*>(entry.context);
+            {
+                std::lock_guard<std::mutex> lock(watcher.mutex);
+                for (Probe& probe : watcher.probes) {
+                    if (&probe.entry == &entry) probe.isDone = true;
+                }
+            }
+            watcher.clock.notifyOne(watcher.condition);
+        }
+
+        bool isIdle() const {
+            for (const Probe& probe : probes) if (probe.isInFlight) return false;
+            return true;
+        }
+
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex);
+            Clock::time_point now = clock.now();
+            for (Probe& probe : probes) probe.due = now;
+
+            while (!isStopping) {
+                now = clock.now();
+                Clock::time_point wake = Clock::time_point::max();
+
+                for (size_t field = 0; field < kFieldCount; ++field) {
+                    Probe& probe = probes[field];
+                    if (probe.isDone) {
+                        probe.isDone = probe.isInFlight = false;
+                        lock.unlock();
+                        bool isChanged = inspect(static_cast<Field>(field));
+                        lock.lock();
+
+                        ++stats.polls;
+                        if (probe.entry.status != Status::kSuccess) ++stats.errors;
+                        if (isChanged) ++stats.changes;
+
+                        auto grown = std::chrono::duration_cast<std::chrono::nanoseconds>(probe.interval * pacing.backoff);
+                        probe.interval = isChanged ? std::chrono::nanoseconds(pacing.fastest)
+                                                   : std::min<std::chrono::nanoseconds>(grown, pacing.slowest);
+                        now = clock.now();
+                        probe.due = now + probe.interval;
+                    }
+
+                    if (!probe.isInFlight && probe.due <= now) {
+                        probe.entry.request = probe.build();
+                        probe.entry.isPollAligned = false;
+                        probe.isInFlight = true;
+                        queue.submit(probe.entry, CommandQueue::Lane::kBulk);
+                    }
+                    if (!probe.isInFlight) wake = std::min(wake, probe.due);
+                }
+
+                auto isReady = [&] {
+                    if (isStopping) return true;
+                    for (const Probe& probe : probes) if (probe.isDone) return true;
+                    return false;
+                };
+                clock.waitUntil(lock, condition, wake, isReady);
+            }
+
+            clock.wait(lock, condition, [&] {
+                for (Probe& probe : probes) if (probe.isDone) probe.isDone = probe.isInFlight = false;
+                return isIdle();
+            });
+        }
+
+        // Diffs a finished poll against the previous one and calls back for what changed.
+        bool inspect(Field field) {
+            Probe& probe = probes[field];
+            const Device::Request& current = probe.entry.request;
+            if (probe.entry.status != Status::kSuccess) return false;
+
+            bool isChanged = probe.hasBaseline && memcmp(current.response, probe.last.response, current.responseSize) != 0;
+            if (isChanged) {
+                switch (field)
+                {
+                case kKeyboard:
+                    diffKeys(probe.last.keyboardState(), current.keyboardState());
+                    break;
+                case kButtons:
+                    diffButtons(probe.last.buttonsState(), current.buttonsState());
+                    break;
+                case kLEDs:
+                    if (ledsCallback) ledsCallback(probe.last.keyboardLEDsState(), current.keyboardLEDsState());
+                    break;
+                default:
+                    break;
+                }
+            }
+            probe.last = current;
+            probe.hasBaseline = true;
+            return isChanged;
+        }
+
+        // Modifiers count as keys. Releases are reported before presses.
+        static size_t keysDown(const KeyboardState& state, VirtualKeyCode (&keys)[15]) {
+            static const VirtualKeyCode kModifiers[8] = {
+                VirtualKeyCode::kControlLeft,  VirtualKeyCode::kShiftLeft,  VirtualKeyCode::kAltLeft,  VirtualKeyCode::kOSLeft,
+                VirtualKeyCode::kControlRight, VirtualKeyCode::kShiftRight, VirtualKeyCode::kAltRight, VirtualKeyCode::kOSRight
+            };
+            uint8_t modifierBits;
+            memcpy(&modifierBits, &state.modifierKeys, sizeof(modifierBits));
+
+            size_t count = 0;
+            for (size_t i = 0; i < 8; ++i) {
+                if (modifierBits & (1u << i)) keys[count++] = kModifiers[i];
+            }
+            for (VirtualKeyCode key : state.regularKeys) {
+                if (key != VirtualKeyCode::kInvalid) keys[count++] = key;
+            }
+            return count;
+        }
+
+        void diffKeys(const KeyboardState& previous, const KeyboardState& current) {
+            if (!keyCallback) return;
+            VirtualKeyCode before[15], after[15];
+            size_t beforeCount = keysDown(previous, before), afterCount = keysDown(current, after);
+
+            for (size_t i = 0; i < beforeCount; ++i) {
+                if (std::find(after, after + afterCount, before[i]) == after + afterCount) keyCallback(before[i], false);
+            }
+            for (size_t i = 0; i < afterCount; ++i) {
+                if (std::find(before, before + beforeCount, after[i]) == before + beforeCount) keyCallback(after[i], true);
+            }
+        }
+
+        void diffButtons(const ButtonsState& previous, const ButtonsState& current) {
+            if (!buttonCallback) return;
+            uint8_t before, after;
+            memcpy(&before, &previous, sizeof(before));
+            memcpy(&after, &current, sizeof(after));
+
+            uint8_t changed = (before ^ after) & 0x1F;
+            for (uint8_t i = 0; i < 5; ++i) {
+                if (changed & (1u << i)) buttonCallback(static_cast<Button>(i), (after >> i) & 1);
+            }
+        }
+    };
+};
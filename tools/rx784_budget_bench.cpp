@@ -0,0 +1,118 @@
+// Offers moveRel to a CommandQueue at fractions and multiples of what a 250000 baud
+// link carries, through an ImpairedTransport capped at 25 kB/s each way, and compares
+// how each way of submitting copes once the link is oversubscribed.
+//
+//     rx784_budget_bench [-t <seconds per run>] [-m <max delay us>]
+//
+// "submit" ignores the budget, "try" drops what trySubmit refuses, "wait" blocks in
+// submitWhenCredited and "drop" sheds the oldest motion. Load is offered moveRel wire
+// time over the time spent offering it, done/s counts until the queue has drained, and
+// busy is the queue's utilization as the last command was offered. Estimate is the mean
+// of estimateDelay at each submission, to set against the latency the entries saw.
+#include "../rx784_impair.hpp"
+#include "../rx784_queue.hpp"
+#include "../rx784_sim.hpp"
+#include <atomic>
+#include <cstdio>
+
+namespace {
+    using namespace RX784;
+
+    enum class Mode : uint8_t { kSubmit, kTry, kWait, kDrop };
+
+    struct Counters {
+        std::atomic<uint64_t> succeeded{ 0 };
+        std::atomic<uint64_t> failed{ 0 };
+    };
+
+    void complete(CommandQueue::Entry& entry) {
+        Counters& counters = *static_cast<Counters*>(entry.context);
+        if (entry.status == Status::kSuccess) ++counters.succeeded;
+        else ++counters.failed;
+    }
+
+    void run(CommandQueue& queue, Mode mode, double load, double seconds) {
+        const std::chrono::nanoseconds cost = WireBudget().cost(Device::Request::moveRel(1, 0));
+        const auto period = std::chrono::nanoseconds(static_cast<int64_t>(cost.count() / load));
+        const size_t count = static_cast<size_t>(seconds * 1e9 / period.count());
+
+        Counters counters;
+        std::vector<CommandQueue::Entry> entries(count);
+        queue.resetLatencyHistogram();
+        queue.resetBudgetStats();
+
+        double totalEstimate = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            std::this_thread::sleep_until(begin + period * i);
+            CommandQueue::Entry& entry = entries[i];
+            entry.request = Device::Request::moveRel(i % 2 ? -1 : 1, 0);
+            entry.onComplete = complete;
+            entry.context = &counters;
+            totalEstimate += std::chrono::duration<double, std::micro>(queue.estimateDelay(CommandQueue::Lane::kBulk)).count();
+
+            switch (mode)
+            {
+            case Mode::kSubmit:
+                queue.submit(entry);
+                break;
+            case Mode::kTry:
+                if (!queue.trySubmit(entry)) ++counters.failed;
+                break;
+            case Mode::kWait:
+                queue.submitWhenCredited(entry);
+                break;
+            case Mode::kDrop:
+                queue.submitDroppingOldest(entry);
+                break;
+            }
+        }
+        CommandQueue::BudgetStats stats = queue.getBudgetStats();
+        double offered = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        while (counters.succeeded + counters.failed < count) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        LatencyHistogram latency = queue.latencyHistogram();
+        static const char* const names[] = { "submit", "try", "wait", "drop" };
+        std::printf("%-6s  %5.2f  %8.0f  %6.0f%%  %9.0f  %9.0f  %9.0f  %8llu  %8llu\n", names[static_cast<size_t>(mode)],
+                    count * cost.count() / 1e9 / offered, counters.succeeded / elapsed, stats.utilization * 100,
+                    totalEstimate / count, latency.percentile(0.5).count() / 1e3, latency.percentile(0.99).count() / 1e3,
+                    static_cast<unsigned long long>(stats.rejected), static_cast<unsigned long long>(stats.dropped));
+    }
+}
+
+int main(int argc, char** argv) {
+    double seconds = 1;
+    uint32_t maxDelay = 10000;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        const char* value = argv[i + 1];
+        if (option == "-t") seconds = std::strtod(value, nullptr);
+        else if (option == "-m") maxDelay = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+    }
+
+    SimulatedBoard board;
+    ImpairedTransport link;
+    Device device;
+    if (!board.start() || link.open(board.portName()) != Status::kSuccess || device.open(link) != Status::kSuccess) {
+        std::fprintf(stderr, "cannot start a simulated board\n");
+        return 1;
+    }
+    ImpairedTransport::Profile profile{};
+    profile.bytesPerSecond = 25000;
+    link.setProfile(ImpairedTransport::Direction::kToBoard, profile);
+    link.setProfile(ImpairedTransport::Direction::kToHost, profile);
+
+    CommandQueue queue(device);
+    queue.setBudget({ 250000, std::chrono::microseconds(maxDelay) });
+
+    std::printf("moveRel at 250000 baud, %g s per run, %u us of credit\n\n", seconds, maxDelay);
+    std::printf("%-6s  %5s  %8s  %7s  %9s  %9s  %9s  %8s  %8s\n",
+                "mode", "load", "done/s", "busy", "est us", "p50 us", "p99 us", "refused", "dropped");
+    for (double load : { 0.5, 0.9, 1.5 }) {
+        for (Mode mode : { Mode::kSubmit, Mode::kTry, Mode::kWait, Mode::kDrop }) run(queue, mode, load, seconds);
+        std::printf("\n");
+    }
+    return 0;
+}
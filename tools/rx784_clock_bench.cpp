@@ -0,0 +1,128 @@
+// Runs minutes of paced motion against a simulated board on a VirtualClock, twice, and
+// checks that both runs agree: movePathRel back to back, then a PathQueue retargeted
+// every 100 ms by a planner that sleeps on the same clock. The planner wakes half a tick
+// off the queue's ticks; two threads acting on the same virtual instant would race.
+//
+//     rx784_clock_bench [-m <path minutes>] [-q <queue minutes>] [-d <path ms>] [--real]
+//
+// --real runs a third pass on the steady clock, which takes as long as the motion does.
+#include "../rx784_clock.hpp"
+#include "../rx784_path.hpp"
+#include "../rx784_sim.hpp"
+#include <cstdio>
+
+namespace {
+    using namespace RX784;
+
+    const LinearPath kPath = { 0.42, 0, 0.58, 1, 0.2, 0.1, 0.8, 0.9 };
+
+    struct Result {
+        double virtualSeconds;
+        double wallSeconds;
+        uint64_t frames;
+        int16_t x;
+        int16_t y;
+        PathQueue::Stats queue;
+    };
+
+    Result run(SimulatedBoard& board, Device& device, Clock& clock, uint32_t pathMinutes, uint32_t queueMinutes,
+               uint32_t duration) {
+        clock.attach();
+        device.setClock(clock);
+        device.setPos(960, 540);
+        uint64_t framesBefore = board.getStats().frames;
+        auto wallStart = std::chrono::steady_clock::now();
+        Clock::time_point start = clock.now();
+
+        uint64_t seed = 5;
+        auto next = [&](int32_t range) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            return static_cast<int16_t>(static_cast<int32_t>((seed >> 33) % static_cast<uint64_t>(range)) - range / 2);
+        };
+
+        // Out and back, so the pointer stays on the screen.
+        size_t paths = static_cast<size_t>(pathMinutes) * 60000 / duration / 2;
+        for (size_t i = 0; i < paths; ++i) {
+            int16_t x = next(1200), y = next(800);
+            device.movePathRel(x, y, duration, 250, true, kPath);
+            device.movePathRel(-x, -y, duration, 250, true, kPath);
+        }
+
+        Result result{};
+        {
+            PathQueue queue(device, 250, std::chrono::milliseconds(48), clock);
+            const Clock::duration every = std::chrono::milliseconds(100);
+            Clock::time_point begin = clock.now() + std::chrono::milliseconds(2);
+            for (uint64_t i = 1; every * i <= std::chrono::minutes(queueMinutes); ++i) {
+                int32_t atX, atY;
+                queue.getPosition(atX, atY);
+                queue.retarget(static_cast<int16_t>(next(1200) - atX / 2), static_cast<int16_t>(next(800) - atY / 2),
+                               duration, kPath);
+                clock.sleepUntil(begin + every * i);
+            }
+            queue.wait();
+            result.queue = queue.getStats();
+        }
+
+        result.virtualSeconds = std::chrono::duration<double>(clock.now() - start).count();
+        result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+        result.frames = board.getStats().frames - framesBefore;
+        int16_t w;
+        board.getAxes(result.x, result.y, w);
+        device.setClock(steadyClock());
+        clock.detach();
+        return result;
+    }
+
+    void print(const char* name, const Result& result) {
+        std::printf("%-9s  %9.1f  %8.2f  %8.0fx  %8llu  %6llu  %9.2f  %5d,%-5d\n", name,
+                    result.virtualSeconds, result.wallSeconds, result.virtualSeconds / result.wallSeconds,
+                    static_cast<unsigned long long>(result.frames),
+                    static_cast<unsigned long long>(result.queue.retargets),
+                    result.queue.maxPickupDelay.count() / 1e6, result.x, result.y);
+    }
+
+    bool isSame(const Result& a, const Result& b) {
+        return a.virtualSeconds == b.virtualSeconds && a.frames == b.frames && a.x == b.x && a.y == b.y &&
+               a.queue.ticks == b.queue.ticks && a.queue.moves == b.queue.moves &&
+               a.queue.maxVelocityStep == b.queue.maxVelocityStep;
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t pathMinutes = 5, queueMinutes = 2, duration = 200;
+    bool isReal = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--real") { isReal = true; continue; }
+        if (i + 1 >= argc) break;
+        const char* value = argv[++i];
+        if (option == "-m") pathMinutes = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (option == "-q") queueMinutes = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (option == "-d") duration = std::max<uint32_t>(1, static_cast<uint32_t>(std::strtoul(value, nullptr, 10)));
+    }
+
+    SimulatedBoard board;
+    Device device;
+    if (!board.start() || device.open(board.portName()) != Status::kSuccess) {
+        std::fprintf(stderr, "cannot start a simulated board\n");
+        return 1;
+    }
+    device.initAbsSystem(1920, 1080);
+
+    std::printf("%u min of %u ms paths, then %u min of retargets every 100 ms, at 250 Hz\n\n",
+                pathMinutes, duration, queueMinutes);
+    std::printf("%-9s  %9s  %8s  %9s  %8s  %6s  %9s  %s\n",
+                "clock", "virtual s", "wall s", "speed-up", "frames", "cut", "pickup ms", "end");
+
+    VirtualClock first, second;
+    Result a = run(board, device, first, pathMinutes, queueMinutes, duration);
+    print("virtual", a);
+    Result b = run(board, device, second, pathMinutes, queueMinutes, duration);
+    print("virtual", b);
+    if (isReal) print("steady", run(board, device, steadyClock(), pathMinutes, queueMinutes, duration));
+
+    std::printf("\nvirtual runs %s\n", isSame(a, b) ? "agree" : "DIFFER");
+    return isSame(a, b) ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+// Compares CommandQueue with and without write coalescing on a bursty client: bursts of
+// moveRel submitted a few microseconds apart, each followed by a quiet spell and one
+// isolated getPos.
+//
+//     rx784_coalesce_bench [-p <port>] [-n <bursts>] [-b <burst size>] [-g <gap us>]
+//                          [-w <window us>] [-t <byte threshold>]
+//
+// Without -p it runs against a simulated board. Reports how long a burst takes to
+// complete, the isolated command's latency, and the batch-size distribution, plain and
+// coalesced on a Device, then coalesced on a SupervisedDevice.
+#include "../rx784_queue.hpp"
+#include "../rx784_sim.hpp"
+#include "../rx784_supervise.hpp"
+#include <atomic>
+#include <cstdio>
+
+namespace {
+    using namespace RX784;
+    using Clock = CommandQueue::Clock;
+
+    struct Options {
+        size_t bursts = 500;
+        size_t burstSize = 8;
+        std::chrono::microseconds gap{20};
+    };
+
+    void run(CommandQueue& queue, const char* name, const Options& options) {
+        std::vector<CommandQueue::Entry> entries(options.burstSize);
+        std::atomic<size_t> pending(0);
+        LatencyHistogram bursts, isolated;
+        uint64_t failures = 0;
+        queue.resetBatchStats();
+
+        for (size_t round = 0; round < options.bursts; ++round) {
+            Clock::time_point start = Clock::now(), next = start;
+            pending = entries.size();
+            for (CommandQueue::Entry& entry : entries) {
+                entry = CommandQueue::Entry{};
+                entry.request = Device::Request::moveRel(round % 2 ? -1 : 1, 0);
+                entry.context = &pending;
+                entry.onComplete = [](CommandQueue::Entry& entry) { --*static_cast<std::atomic<size_t>*>(entry.context); };
+                queue.submit(entry);
+                next += options.gap;
+                while (Clock::now() < next) {}
+            }
+            while (pending != 0) std::this_thread::yield();
+            bursts.record(Clock::now() - start);
+            for (const CommandQueue::Entry& entry : entries) {
+                if (entry.status != Status::kSuccess) ++failures;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            Device::Request request = Device::Request::getPos();
+            start = Clock::now();
+            if (queue.execute(request) != Status::kSuccess) ++failures;
+            isolated.record(Clock::now() - start);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+
+        CommandQueue::BatchStats stats = queue.getBatchStats();
+        auto us = [](std::chrono::nanoseconds value) { return value.count() / 1000.0; };
+        std::printf("%-8s  %9.1f  %9.1f  %9.1f  %9.1f  %8.2f  %8llu\n", name,
+                    us(bursts.percentile(0.5)), us(bursts.percentile(0.99)),
+                    us(isolated.percentile(0.5)), us(isolated.percentile(0.99)),
+                    stats.writes ? double(stats.frames) / stats.writes : 0.0, static_cast<unsigned long long>(failures));
+        std::printf("          frames per write:");
+        for (size_t i = 0; i < CommandQueue::kMaxBatch; ++i) {
+            if (stats.sizes[i]) std::printf(" %zu:%llu", i + 1, static_cast<unsigned long long>(stats.sizes[i]));
+        }
+        std::printf("\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string port;
+    Options options;
+    CommandQueue::Coalescing coalescing = { std::chrono::microseconds(100), 64 };
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        const char* value = argv[i + 1];
+        if (option == "-p") port = value;
+        else if (option == "-n") options.bursts = std::strtoul(value, nullptr, 10);
+        else if (option == "-b") options.burstSize = std::max<size_t>(1, std::strtoul(value, nullptr, 10));
+        else if (option == "-g") options.gap = std::chrono::microseconds(std::strtol(value, nullptr, 10));
+        else if (option == "-w") coalescing.maxDelay = std::chrono::microseconds(std::strtol(value, nullptr, 10));
+        else if (option == "-t") coalescing.maxBytes = std::strtoul(value, nullptr, 10);
+    }
+
+    SimulatedBoard board;
+    if (port.empty()) {
+        board.setResponseDelay(std::chrono::microseconds(50));
+        if (!board.start()) {
+            std::fprintf(stderr, "cannot start a simulated board\n");
+            return 1;
+        }
+        port = board.portName();
+    }
+
+    std::printf("%zu bursts of %zu moveRel, %lld us apart; window %lld us, threshold %zu bytes\n\n",
+                options.bursts, options.burstSize, static_cast<long long>(options.gap.count()),
+                static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(coalescing.maxDelay).count()),
+                coalescing.maxBytes);
+    std::printf("%-8s  %9s  %9s  %9s  %9s  %8s  %8s\n",
+                "mode", "burst p50", "burst p99", "lone p50", "lone p99", "frames/w", "failures");
+    {
+        Device device;
+        if (device.open(port) != Status::kSuccess) {
+            std::fprintf(stderr, "cannot open %s\n", port.c_str());
+            return 1;
+        }
+        CommandQueue queue(device);
+        run(queue, "single", options);
+
+        queue.setCoalescing(coalescing);
+        run(queue, "coalesce", options);
+    }
+
+    // The supervised transport takes each write apart into its frames.
+    SupervisedDevice device;
+    if (device.open(port) != Status::kSuccess) {
+        std::fprintf(stderr, "cannot open %s supervised\n", port.c_str());
+        return 1;
+    }
+    CommandQueue queue(device);
+    queue.setCoalescing(coalescing);
+    run(queue, "superv.", options);
+    return 0;
+}
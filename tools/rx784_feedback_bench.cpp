@@ -0,0 +1,134 @@
+// Plays the same absolute paths open loop, with a getPos after every tick, and with
+// sparse feedback, against a simulated board whose moveAbs lands off target and now
+// and then refuses a frame.
+//
+//     rx784_feedback_bench [-n <moves>] [-d <duration ms>] [-r <polling rate>]
+//                          [-i <interval ticks>] [-b <error budget px>]
+//                          [-s <scale error>] [-f <refuse rate>]
+//
+// Tracking error is measured on the board after every tick against where the path
+// should be; final error is taken once the move has returned.
+#include "../rx784_sim.hpp"
+#include <cstdio>
+
+namespace {
+    using namespace RX784;
+
+    struct Options {
+        size_t moves = 40;
+        uint32_t duration = 200;
+        uint32_t pollingRate = 250;
+    };
+
+    struct Result {
+        double totalTracking = 0;
+        int32_t maxTracking = 0;
+        uint64_t ticks = 0;
+        double totalFinal = 0;
+        int32_t maxFinal = 0;
+        uint64_t roundTrips = 0;
+        uint64_t frames = 0;
+    };
+
+    const LinearPath kPath = { 0.42, 0, 0.58, 1, 0.2, 0.1, 0.8, 0.9 };
+
+    int32_t distance(int32_t ax, int32_t ay, int32_t bx, int32_t by) {
+        return std::max(std::abs(ax - bx), std::abs(ay - by));
+    }
+
+    // `feedback` null for open loop.
+    Result run(SimulatedBoard& board, Device& device, const Options& options, const PathFeedback* feedback) {
+        Result result;
+        uint64_t seed = 7;
+        auto next = [&](int32_t range) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            return static_cast<int32_t>((seed >> 33) % static_cast<uint64_t>(range));
+        };
+
+        device.setPos(960, 540);
+        uint64_t framesBefore = board.getStats().frames;
+        for (size_t move = 0; move < options.moves; ++move) {
+            int16_t targetX = static_cast<int16_t>(100 + next(1720)), targetY = static_cast<int16_t>(100 + next(880));
+            int16_t startX, startY, w;
+            board.getAxes(startX, startY, w);
+            PathSampler ideal(targetX - startX, targetY - startY, options.duration, options.pollingRate, kPath);
+
+            uint32_t tick = 0;
+            auto track = [&] {
+                int32_t posX, posY;
+                int16_t atX, atY;
+                ideal.at(++tick, posX, posY);
+                board.getAxes(atX, atY, w);
+                int32_t error = distance(atX, atY, startX + posX, startY + posY);
+                result.totalTracking += error;
+                result.maxTracking = std::max(result.maxTracking, error);
+                ++result.ticks;
+            };
+
+            if (feedback) {
+                PathFeedbackStats stats{};
+                device.movePathAbs(targetX, targetY, options.duration, options.pollingRate, true, kPath, *feedback, stats, track);
+                result.roundTrips += stats.roundTrips;
+            } else {
+                device.movePathAbs(targetX, targetY, options.duration, options.pollingRate, true, kPath, track);
+                ++result.roundTrips;
+            }
+
+            int16_t endX, endY;
+            board.getAxes(endX, endY, w);
+            int32_t error = distance(endX, endY, targetX, targetY);
+            result.totalFinal += error;
+            result.maxFinal = std::max(result.maxFinal, error);
+        }
+        result.frames = board.getStats().frames - framesBefore;
+        return result;
+    }
+
+    void print(const char* name, const Result& result, const Options& options) {
+        std::printf("%-12s  %9.2f  %9d  %9.2f  %9d  %11.2f  %11.1f\n", name,
+                    result.totalTracking / result.ticks, result.maxTracking,
+                    result.totalFinal / options.moves, result.maxFinal,
+                    static_cast<double>(result.roundTrips) / options.moves,
+                    static_cast<double>(result.frames) / options.moves);
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    PathFeedback sparse = { 10, 3 };
+    double scale = 1.02, refuseRate = 0.02;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        const char* value = argv[i + 1];
+        if (option == "-n") options.moves = std::strtoul(value, nullptr, 10);
+        else if (option == "-d") options.duration = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (option == "-r") options.pollingRate = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (option == "-i") sparse.interval = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (option == "-b") sparse.errorBudget = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (option == "-s") scale = std::strtod(value, nullptr);
+        else if (option == "-f") refuseRate = std::strtod(value, nullptr);
+    }
+
+    SimulatedBoard board;
+    Device device;
+    if (!board.start() || device.open(board.portName()) != Status::kSuccess) {
+        std::fprintf(stderr, "cannot start a simulated board\n");
+        return 1;
+    }
+    board.setAbsFaults(scale, refuseRate);
+    device.initAbsSystem(1920, 1080);
+
+    std::printf("%zu moves of %u ms at %u Hz; moveAbs scaled by %g, %g of frames refused\n\n",
+                options.moves, options.duration, options.pollingRate, scale, refuseRate);
+    std::printf("%-12s  %9s  %9s  %9s  %9s  %11s  %11s\n",
+                "mode", "track avg", "track max", "final avg", "final max", "reads/move", "frames/move");
+    print("open loop", run(board, device, options, nullptr), options);
+
+    PathFeedback everyTick = { 1, 0 };
+    print("every tick", run(board, device, options, &everyTick), options);
+    print("sparse", run(board, device, options, &sparse), options);
+    std::printf("\nsparse: a read every %u ticks, or sooner past %u px of estimated error\n",
+                sparse.interval, sparse.errorBudget);
+    return 0;
+}
@@ -0,0 +1,92 @@
+// Sends the same moveRel to a set of simulated boards, one Device after another and
+// then through DeviceGroup::broadcast, and compares the skew between the first and the
+// last board to receive it.
+//
+//     rx784_group_bench [boards] [rounds] [response delay us]
+//
+// Board skew is taken from when each simulated board parsed the frame; host skew is
+// DeviceGroup's own sendSkew.
+#include "../rx784_group.hpp"
+#include "../rx784_sim.hpp"
+#include <cstdio>
+#include <memory>
+
+namespace {
+    using namespace RX784;
+    using Clock = DeviceGroup::Clock;
+
+    std::chrono::nanoseconds boardSkew(const std::vector<std::unique_ptr<SimulatedBoard>>& boards) {
+        Clock::time_point first = Clock::time_point::max(), last = Clock::time_point::min();
+        for (const auto& board : boards) {
+            Clock::time_point parsed = board->getStats().lastFrameTime;
+            first = std::min(first, parsed);
+            last = std::max(last, parsed);
+        }
+        return last - first;
+    }
+
+    struct Summary {
+        double totalSkew = 0;
+        double maxSkew = 0;
+        double totalRound = 0;
+        size_t rounds = 0;
+
+        void add(std::chrono::nanoseconds skew, std::chrono::nanoseconds round) {
+            double us = skew.count() / 1000.0;
+            totalSkew += us;
+            maxSkew = std::max(maxSkew, us);
+            totalRound += round.count() / 1000.0;
+            ++rounds;
+        }
+    };
+}
+
+int main(int argc, char** argv) {
+    size_t boardCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 8;
+    size_t rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 500;
+    std::chrono::microseconds responseDelay(argc > 3 ? std::strtol(argv[3], nullptr, 10) : 100);
+
+    std::vector<std::unique_ptr<SimulatedBoard>> boards;
+    std::vector<std::unique_ptr<Device>> devices;
+    std::vector<Device*> pointers;
+    for (size_t i = 0; i < boardCount; ++i) {
+        boards.emplace_back(new SimulatedBoard);
+        devices.emplace_back(new Device);
+        boards.back()->setResponseDelay(responseDelay);
+        if (!boards.back()->start() || devices.back()->open(boards.back()->portName()) != Status::kSuccess) {
+            std::fprintf(stderr, "cannot start simulated board %zu\n", i);
+            return 1;
+        }
+        pointers.push_back(devices.back().get());
+    }
+
+    DeviceGroup group(pointers);
+    Summary sequential, broadcast;
+    double totalHostSkew = 0;
+    size_t failures = 0;
+
+    for (size_t round = 0; round < rounds; ++round) {
+        Device::Request request = Device::Request::moveRel(1, 0);
+        DeviceGroup::Clock::time_point start = DeviceGroup::Clock::now();
+        for (Device* device : pointers) {
+            Device::Request copy = request;
+            if (device->transact(copy) != Status::kSuccess) ++failures;
+        }
+        sequential.add(boardSkew(boards), DeviceGroup::Clock::now() - start);
+
+        DeviceGroup::Report report = group.broadcast(request);
+        failures += report.failures;
+        broadcast.add(boardSkew(boards), report.elapsed);
+        totalHostSkew += report.sendSkew.count() / 1000.0;
+    }
+
+    std::printf("%zu boards, %zu rounds, %lld us simulated response delay\n\n",
+                boardCount, rounds, static_cast<long long>(responseDelay.count()));
+    std::printf("%-10s  %16s  %15s  %14s\n", "method", "mean skew us", "max skew us", "round us");
+    std::printf("%-10s  %16.1f  %15.1f  %14.1f\n", "sequential",
+                sequential.totalSkew / rounds, sequential.maxSkew, sequential.totalRound / rounds);
+    std::printf("%-10s  %16.1f  %15.1f  %14.1f\n", "broadcast",
+                broadcast.totalSkew / rounds, broadcast.maxSkew, broadcast.totalRound / rounds);
+    std::printf("\nbroadcast host-side send skew: %.1f us mean; failures: %zu\n", totalHostSkew / rounds, failures);
+    return failures == 0 ? 0 : 1;
+}
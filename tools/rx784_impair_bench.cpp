@@ -0,0 +1,135 @@
+// Runs alternating moveRel and getPos against a simulated board through an
+// ImpairedTransport, once per fault profile, and reports what each profile costs.
+//
+//     rx784_impair_bench [-n <transactions>] [-s <seed>] [-r <fault rate>] [-p <profile>]
+//
+// Faults hit the board's responses, which is where recvPacketHead and recvPacket have
+// to resynchronize; "to board" profiles hit requests instead. Time to recover runs from
+// the start of the first failed transaction to the end of the next good one.
+#include "../rx784_impair.hpp"
+#include "../rx784_queue.hpp"
+#include "../rx784_sim.hpp"
+#include <cstdio>
+
+namespace {
+    using namespace RX784;
+    using Clock = ImpairedTransport::Clock;
+    using Direction = ImpairedTransport::Direction;
+
+    struct Scenario {
+        const char* name;
+        Direction direction;
+        ImpairedTransport::Profile profile;
+    };
+
+    std::vector<Scenario> scenarios(double rate) {
+        using std::chrono::microseconds;
+        ImpairedTransport::Profile clean{};
+        std::vector<Scenario> list;
+        list.push_back({ "clean", Direction::kToHost, clean });
+
+        ImpairedTransport::Profile profile = clean;
+        profile.latency = microseconds(1000);
+        profile.jitter = microseconds(500);
+        list.push_back({ "latency", Direction::kToHost, profile });
+
+        profile = clean;
+        profile.bytesPerSecond = 25000;  // 250000 baud, 8N1
+        list.push_back({ "baud cap", Direction::kToHost, profile });
+
+        profile = clean;
+        profile.dropRate = rate;
+        list.push_back({ "drops", Direction::kToHost, profile });
+        list.push_back({ "drops to board", Direction::kToBoard, profile });
+
+        profile = clean;
+        profile.flipRate = rate;
+        list.push_back({ "bit flips", Direction::kToHost, profile });
+        list.push_back({ "flips to board", Direction::kToBoard, profile });
+
+        profile = clean;
+        profile.spuriousRate = rate;
+        list.push_back({ "stray BE/ED", Direction::kToHost, profile });
+
+        profile.dropRate = profile.flipRate = rate;
+        profile.latency = microseconds(200);
+        profile.jitter = microseconds(200);
+        profile.bytesPerSecond = 25000;
+        list.push_back({ "everything", Direction::kToHost, profile });
+        return list;
+    }
+
+    void run(const char* port, const Scenario& scenario, size_t count, uint64_t seed) {
+        ImpairedTransport link(seed);
+        Device device;
+        if (link.open(port) != Status::kSuccess || device.open(link) != Status::kSuccess) {
+            std::fprintf(stderr, "cannot open %s\n", port);
+            return;
+        }
+        link.setProfile(scenario.direction, scenario.profile);
+
+        LatencyHistogram latency, recovery;
+        uint64_t failures = 0;
+        bool isFailing = false;
+        Clock::time_point failedAt{}, start = Clock::now();
+
+        for (size_t i = 0; i < count; ++i) {
+            Device::Request request = i % 2 ? Device::Request::getPos() : Device::Request::moveRel(i % 4 ? -1 : 1, 0);
+            Clock::time_point begin = Clock::now();
+            Status status = device.transact(request);
+            if (status == Status::kSuccess && request.responseSize == 1) status = request.result();
+            Clock::time_point end = Clock::now();
+
+            if (status == Status::kSuccess) {
+                latency.record(end - begin);
+                if (isFailing) recovery.record(end - failedAt);
+                isFailing = false;
+            } else {
+                ++failures;
+                if (!isFailing) failedAt = begin;
+                isFailing = true;
+            }
+        }
+        double wall = std::chrono::duration<double>(Clock::now() - start).count();
+
+        ImpairedTransport::Stats stats = link.getStats(scenario.direction);
+        auto us = [](std::chrono::nanoseconds value) { return value.count() / 1000.0; };
+        std::printf("%-15s  %9.0f  %8.1f  %8.1f  %7.2f%%  %8llu  %9.1f  %9.1f  %5llu/%llu/%llu\n", scenario.name,
+                    latency.count() / wall, us(latency.percentile(0.5)), us(latency.percentile(0.99)),
+                    100.0 * failures / count, static_cast<unsigned long long>(recovery.count()),
+                    us(recovery.percentile(0.5)), us(recovery.maximum()),
+                    static_cast<unsigned long long>(stats.dropped), static_cast<unsigned long long>(stats.flipped),
+                    static_cast<unsigned long long>(stats.inserted));
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t count = 20000;
+    uint64_t seed = 1;
+    double rate = 1e-3;
+    std::string only;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        const char* value = argv[i + 1];
+        if (option == "-n") count = std::strtoul(value, nullptr, 10);
+        else if (option == "-s") seed = std::strtoull(value, nullptr, 10);
+        else if (option == "-r") rate = std::strtod(value, nullptr);
+        else if (option == "-p") only = value;
+    }
+
+    SimulatedBoard board;
+    if (!board.start()) {
+        std::fprintf(stderr, "cannot start a simulated board\n");
+        return 1;
+    }
+
+    std::printf("%zu transactions per profile, seed %llu, fault rate %g per byte\n\n",
+                count, static_cast<unsigned long long>(seed), rate);
+    std::printf("%-15s  %9s  %8s  %8s  %8s  %8s  %9s  %9s  %s\n", "profile", "ok/s", "p50 us", "p99 us",
+                "errors", "outages", "ttr p50", "ttr max", "drop/flip/stray");
+    for (const Scenario& scenario : scenarios(rate)) {
+        if (only.empty() || only == scenario.name) run(board.portName().c_str(), scenario, count, seed);
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+// Measures CommandQueue command latency with and without the I/O thread's latency mode,
+// as a client sending one getPos per interval would see it.
+//
+//     rx784_latency_bench [-p <port>] [-n <commands>] [-i <interval us>]
+//                         [-c <cpu>] [-r <SCHED_FIFO priority>] [-s <spin us>] [-m]
+//
+// Without -p it runs against a simulated board. -m locks memory. Reports latency
+// percentiles and the CPU time the I/O thread used per wall second in each mode.
+#include "../rx784_queue.hpp"
+#include "../rx784_sim.hpp"
+#include <cstdio>
+#include <ctime>
+
+namespace {
+    using namespace RX784;
+    using Clock = CommandQueue::Clock;
+
+    double ioThreadSeconds;
+
+    // Completes on the I/O thread, so it can read that thread's CPU clock.
+    void markCpuTime(CommandQueue::Entry&) {
+        timespec now{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        ioThreadSeconds = now.tv_sec + now.tv_nsec / 1e9;
+    }
+
+    double ioThreadCpuTime(CommandQueue& queue) {
+        CommandQueue::Entry marker{};
+        marker.request = Device::Request::getAxes();
+        marker.onComplete = markCpuTime;
+        queue.submit(marker);
+        queue.execute(marker.request);  // same lane, so the marker has completed once this returns
+        return ioThreadSeconds;
+    }
+
+    void run(CommandQueue& queue, const char* name, size_t count, std::chrono::microseconds interval) {
+        uint64_t failures = 0;
+        double cpuStart = ioThreadCpuTime(queue);
+        queue.resetLatencyHistogram();
+
+        Clock::time_point start = Clock::now(), next = start;
+        for (size_t i = 0; i < count; ++i) {
+            Device::Request request = Device::Request::getPos();
+            if (queue.execute(request) != Status::kSuccess) ++failures;
+            next += interval;
+            std::this_thread::sleep_until(next);
+        }
+        double wall = std::chrono::duration<double>(Clock::now() - start).count();
+        LatencyHistogram latency = queue.latencyHistogram();
+        double cpu = ioThreadCpuTime(queue) - cpuStart;
+
+        auto us = [](std::chrono::nanoseconds value) { return value.count() / 1000.0; };
+        std::printf("%-8s  %9.1f  %9.1f  %9.1f  %9.1f  %9.1f  %8.1f%%  %8llu\n", name,
+                    us(latency.percentile(0.5)), us(latency.percentile(0.9)), us(latency.percentile(0.99)),
+                    us(latency.percentile(0.999)), us(latency.maximum()), 100 * cpu / wall,
+                    static_cast<unsigned long long>(failures));
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string port;
+    size_t count = 5000;
+    std::chrono::microseconds interval(1000);
+    CommandQueue::LatencyMode mode = { 0, 0, false, std::chrono::microseconds(200) };
+
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "-m") {
+            mode.isMemoryLocked = true;
+            continue;
+        }
+        if (i + 1 == argc) break;
+        const char* value = argv[++i];
+        if (option == "-p") port = value;
+        else if (option == "-n") count = std::strtoul(value, nullptr, 10);
+        else if (option == "-i") interval = std::chrono::microseconds(std::strtol(value, nullptr, 10));
+        else if (option == "-c") mode.cpu = std::atoi(value);
+        else if (option == "-r") mode.priority = std::atoi(value);
+        else if (option == "-s") mode.spinBudget = std::chrono::microseconds(std::strtol(value, nullptr, 10));
+    }
+
+    SimulatedBoard board;
+    if (port.empty()) {
+        if (!board.start()) {
+            std::fprintf(stderr, "cannot start a simulated board\n");
+            return 1;
+        }
+        port = board.portName();
+    }
+
+    Device device;
+    if (device.open(port) != Status::kSuccess) {
+        std::fprintf(stderr, "cannot open %s\n", port.c_str());
+        return 1;
+    }
+    CommandQueue queue(device);
+
+    std::printf("%zu getPos, one every %lld us\n\n", count, static_cast<long long>(interval.count()));
+    std::printf("%-8s  %9s  %9s  %9s  %9s  %9s  %9s  %8s\n",
+                "mode", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us", "io cpu", "failures");
+    run(queue, "normal", count, interval);
+
+    CommandQueue::LatencyMode applied = queue.setLatencyMode(mode);
+    run(queue, "latency", count, interval);
+
+    std::printf("\nlatency mode: cpu %d%s, priority %d%s, memory %s, spin %lld us\n",
+                applied.cpu, applied.cpu != mode.cpu ? " (refused)" : "",
+                applied.priority, applied.priority != mode.priority ? " (refused)" : "",
+                applied.isMemoryLocked ? "locked" : mode.isMemoryLocked ? "not locked (refused)" : "not locked",
+                static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(mode.spinBudget).count()));
+    return 0;
+}
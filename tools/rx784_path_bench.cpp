@@ -0,0 +1,90 @@
+// Drives a PathQueue against a simulated board the way a planner that keeps changing
+// its mind would: a new target every 100 ms or so, each meant to take
+// longer than that to reach.
+//
+//     rx784_path_bench [-n <targets>] [-e <ms between targets>] [-d <path ms>] [-b <blend ms>]
+//
+// "blend" retargets with velocity carried over, "abort" retargets with no blend, and
+// "wait" appends each target behind the last. Done is the time from the last target to
+// the pointer standing on it; the board's final position is checked against the queue's.
+#include "../rx784_path.hpp"
+#include "../rx784_sim.hpp"
+#include <cstdio>
+
+namespace {
+    using namespace RX784;
+
+    enum class Mode : uint8_t { kBlend, kAbort, kWait };
+
+    const LinearPath kPath = { 0.42, 0, 0.58, 1, 0.2, 0.1, 0.8, 0.9 };
+
+    void run(SimulatedBoard& board, Device& device, Mode mode, size_t targets, uint32_t every, uint32_t duration,
+             uint32_t blend) {
+        int16_t startX, startY, w;
+        board.getAxes(startX, startY, w);
+        PathQueue queue(device, 250, std::chrono::milliseconds(mode == Mode::kAbort ? 0 : blend));
+
+        uint64_t seed = 11;
+        auto next = [&](int32_t range) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            return static_cast<int16_t>(static_cast<int32_t>((seed >> 33) % static_cast<uint64_t>(range)) - range / 2);
+        };
+
+        auto begin = std::chrono::steady_clock::now(), last = begin;
+        for (size_t i = 0; i < targets; ++i) {
+            int16_t x = next(1200), y = next(800);
+            last = std::chrono::steady_clock::now();
+            if (mode == Mode::kWait) {
+                while (!queue.append(x, y, duration, kPath)) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            } else {
+                queue.retarget(x, y, duration, kPath);
+            }
+            std::this_thread::sleep_until(begin + std::chrono::milliseconds(every * (i + 1)));
+        }
+        queue.wait();
+        double done = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - last).count();
+
+        PathQueue::Stats stats = queue.getStats();
+        int32_t queueX, queueY;
+        int16_t endX, endY;
+        queue.getPosition(queueX, queueY);
+        board.getAxes(endX, endY, w);
+        bool isExact = endX - startX == queueX && endY - startY == queueY;
+
+        static const char* const names[] = { "blend", "abort", "wait" };
+        std::printf("%-6s  %9.1f  %9d  %9.2f  %7llu  %7llu  %s\n", names[static_cast<size_t>(mode)], done,
+                    stats.maxVelocityStep, stats.maxPickupDelay.count() / 1e6,
+                    static_cast<unsigned long long>(stats.retargets), static_cast<unsigned long long>(stats.moves),
+                    isExact ? "yes" : "NO");
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t targets = 30;
+    uint32_t every = 100, duration = 200, blend = 48;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        const char* value = argv[i + 1];
+        if (option == "-n") targets = std::strtoul(value, nullptr, 10);
+        else if (option == "-e") every = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (option == "-d") duration = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (option == "-b") blend = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+    }
+
+    SimulatedBoard board;
+    Device device;
+    if (!board.start() || device.open(board.portName()) != Status::kSuccess) {
+        std::fprintf(stderr, "cannot start a simulated board\n");
+        return 1;
+    }
+    device.initAbsSystem(1920, 1080);
+    device.setPos(960, 540);
+
+    std::printf("%zu targets %u ms apart, %u ms paths at 250 Hz, %u ms blend\n\n", targets, every, duration, blend);
+    std::printf("%-6s  %9s  %9s  %9s  %7s  %7s  %s\n", "mode", "done ms", "max dv", "pickup ms", "cut", "moves", "exact");
+    run(board, device, Mode::kBlend, targets, every, duration, blend);
+    run(board, device, Mode::kAbort, targets, every, duration, blend);
+    run(board, device, Mode::kWait, targets, every, duration, blend);
+    return 0;
+}
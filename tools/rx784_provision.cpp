@@ -0,0 +1,92 @@
+// Gives a set of boards the same HID identity, writing only the fields that differ.
+//
+//     rx784_provision -v <vendor id> -p <product id> -n <version number>
+//                     -m <manufacturer> -s <product> [-j <parallel>] <port>...
+//     rx784_provision ... -S <count>
+//
+// IDs and the version number are hexadecimal. -S provisions <count> simulated boards
+// twice, to show what the second, diffed pass saves.
+#include "../rx784_identity.hpp"
+#include "../rx784_sim.hpp"
+#include <cstdio>
+#include <memory>
+
+namespace {
+    using namespace RX784;
+
+    void print(const HIDProvisioningReport& report, const std::vector<std::string>& ports) {
+        for (size_t i = 0; i < ports.size(); ++i) {
+            const HIDIdentityReport& device = report.devices[i];
+            std::printf("%-24s  status %u, %u written, %u skipped, %.1f ms\n", ports[i].c_str(),
+                        static_cast<unsigned>(device.status), device.written, device.skipped, device.elapsed.count() / 1e6);
+        }
+        std::printf("%zu boards, %zu failed, %llu flash writes, %llu skipped, %.1f ms wall\n",
+                    ports.size(), report.failures, static_cast<unsigned long long>(report.written),
+                    static_cast<unsigned long long>(report.skipped), report.elapsed.count() / 1e6);
+    }
+}
+
+int main(int argc, char** argv) {
+    HIDIdentity profile{};
+    bool isGiven[5] = {};
+    size_t parallelism = 16, simulated = 0;
+    std::vector<std::string> ports;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option.size() != 2 || option[0] != '-') {
+            ports.push_back(option);
+            continue;
+        }
+        if (i + 1 == argc) break;
+        const char* value = argv[++i];
+        switch (option[1])
+        {
+        case 'v': profile.vendorID = static_cast<uint16_t>(std::strtoul(value, nullptr, 16)); isGiven[0] = true; break;
+        case 'p': profile.productID = static_cast<uint16_t>(std::strtoul(value, nullptr, 16)); isGiven[1] = true; break;
+        case 'n': profile.versionNumber = static_cast<uint16_t>(std::strtoul(value, nullptr, 16)); isGiven[2] = true; break;
+        case 'm': profile.manufacturerString = value; isGiven[3] = true; break;
+        case 's': profile.productString = value; isGiven[4] = true; break;
+        case 'j': parallelism = std::max<size_t>(1, std::strtoul(value, nullptr, 10)); break;
+        case 'S': simulated = std::strtoul(value, nullptr, 10); break;
+        default: break;
+        }
+    }
+    if (std::find(std::begin(isGiven), std::end(isGiven), false) != std::end(isGiven) || (ports.empty() && simulated == 0)) {
+        std::fprintf(stderr, "usage: rx784_provision -v <vid> -p <pid> -n <version> -m <manufacturer> -s <product> "
+                             "[-j <parallel>] (<port>... | -S <count>)\n");
+        return 2;
+    }
+
+    std::vector<std::unique_ptr<SimulatedBoard>> boards;
+    for (size_t i = 0; i < simulated; ++i) {
+        boards.emplace_back(new SimulatedBoard);
+        boards.back()->setResponseDelay(std::chrono::microseconds(200));
+        boards.back()->setFlashWriteDelay(std::chrono::milliseconds(20));
+        if (!boards.back()->start()) {
+            std::fprintf(stderr, "cannot start simulated board %zu\n", i);
+            return 1;
+        }
+        ports.push_back(boards.back()->portName());
+    }
+
+    std::vector<std::unique_ptr<Device>> devices;
+    std::vector<Device*> pointers;
+    for (const std::string& port : ports) {
+        devices.emplace_back(new Device);
+        if (devices.back()->open(port) != Status::kSuccess) {
+            std::fprintf(stderr, "cannot open %s\n", port.c_str());
+            return 1;
+        }
+        pointers.push_back(devices.back().get());
+    }
+
+    HIDProvisioningReport report = applyHIDIdentity(pointers, profile, parallelism);
+    print(report, ports);
+    if (simulated != 0) {
+        std::printf("\nsecond pass:\n");
+        report = applyHIDIdentity(pointers, profile, parallelism);
+        print(report, ports);
+    }
+    return report.failures == 0 ? 0 : 1;
+}
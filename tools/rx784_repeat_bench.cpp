@@ -0,0 +1,137 @@
+// Holds keys with different typematic timings against a simulated board, first through
+// a KeyRepeater and then with a thread per key sending keyUp and keyDown between sleeps,
+// and compares what each sent to get the same repeats.
+//
+//     rx784_repeat_bench [-k <keys, 1 to 7>] [-t <seconds held>] [-r <resolution us>]
+//
+// Expected is the repeats the timings ask for over the time held. Frames are the packets
+// the board parsed; late is the longest a repeater tick went out after its time. Both
+// runs must leave the board with no key down.
+#include "../rx784_repeat.hpp"
+#include "../rx784_sim.hpp"
+#include <atomic>
+#include <cstdio>
+
+namespace {
+    using namespace RX784;
+
+    const VirtualKeyCode kKeys[] = {
+        VirtualKeyCode::kArrowDown, VirtualKeyCode::kKeyA, VirtualKeyCode::kBackspace, VirtualKeyCode::kSpace,
+        VirtualKeyCode::kArrowRight, VirtualKeyCode::kKeyZ, VirtualKeyCode::kDelete,
+    };
+
+    const KeyRepeater::Timing kTimings[] = {
+        { std::chrono::milliseconds(500), 30 }, { std::chrono::milliseconds(250), 20 },
+        { std::chrono::milliseconds(300), 30 }, { std::chrono::milliseconds(400), 25 },
+        { std::chrono::milliseconds(250), 30 }, { std::chrono::milliseconds(600), 15 },
+        { std::chrono::milliseconds(350), 24 },
+    };
+
+    uint64_t expectedRepeats(size_t keys, double seconds) {
+        uint64_t total = 0;
+        for (size_t i = 0; i < keys; ++i) {
+            double held = seconds - std::chrono::duration<double>(kTimings[i].delay).count();
+            if (held >= 0) total += static_cast<uint64_t>(held * kTimings[i].rate) + 1;
+        }
+        return total;
+    }
+
+    bool isBoardClear(CommandQueue& queue) {
+        Device::Request request = Device::Request::getKeyboardState();
+        if (queue.execute(request) != Status::kSuccess) return false;
+        KeyboardState state = request.keyboardState();
+        uint8_t modifierKeys;
+        memcpy(&modifierKeys, &state.modifierKeys, sizeof(modifierKeys));
+        for (VirtualKeyCode key : state.regularKeys) {
+            if (key != VirtualKeyCode::kInvalid) return false;
+        }
+        return modifierKeys == 0;
+    }
+
+    void report(const char* name, uint64_t repeats, uint64_t expected, uint64_t frames, double late, bool isClear) {
+        char lateText[16] = "-";
+        if (late >= 0) std::snprintf(lateText, sizeof(lateText), "%.2f", late);
+        std::printf("%-12s  %8llu  %8llu  %8llu  %11.2f  %7s  %s\n", name, static_cast<unsigned long long>(repeats),
+                    static_cast<unsigned long long>(expected), static_cast<unsigned long long>(frames),
+                    repeats != 0 ? static_cast<double>(frames) / repeats : 0.0, lateText, isClear ? "yes" : "NO");
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t keys = 4;
+    double seconds = 3;
+    uint32_t resolution = 8000;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        const char* value = argv[i + 1];
+        if (option == "-k") keys = std::max<size_t>(1, std::min<size_t>(7, std::strtoul(value, nullptr, 10)));
+        else if (option == "-t") seconds = std::strtod(value, nullptr);
+        else if (option == "-r") resolution = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+    }
+
+    SimulatedBoard board;
+    Device device;
+    if (!board.start() || device.open(board.portName()) != Status::kSuccess) {
+        std::fprintf(stderr, "cannot start a simulated board\n");
+        return 1;
+    }
+    CommandQueue queue(device);
+    const auto held = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(seconds));
+    const uint64_t expected = expectedRepeats(keys, seconds);
+
+    std::printf("%zu keys and shift held for %g s, %u us resolution\n\n", keys, seconds, resolution);
+    std::printf("%-12s  %8s  %8s  %8s  %11s  %7s  %s\n", "", "repeats", "expected", "frames", "frames/rep", "late ms", "clear");
+
+    {
+        uint64_t frames = board.getStats().frames;
+        KeyRepeater repeater(queue, std::chrono::microseconds(resolution));
+        repeater.press(VirtualKeyCode::kShiftLeft);
+        for (size_t i = 0; i < keys; ++i) {
+            if (repeater.press(kKeys[i], kTimings[i]) != Status::kSuccess) std::fprintf(stderr, "press failed\n");
+        }
+        std::this_thread::sleep_for(held);
+        repeater.releaseAll();
+        KeyRepeater::Stats stats = repeater.getStats();
+        report("repeater", stats.repeats, expected, board.getStats().frames - frames,
+               std::chrono::duration<double, std::milli>(stats.maxLateness).count(), isBoardClear(queue));
+        std::printf("%-12s  %llu packets carried %llu transitions, %llu errors\n", "",
+                    static_cast<unsigned long long>(stats.packets), static_cast<unsigned long long>(stats.transitions),
+                    static_cast<unsigned long long>(stats.errors));
+    }
+
+    {
+        uint64_t frames = board.getStats().frames;
+        std::atomic<uint64_t> repeats{ 0 };
+        std::atomic<bool> isStopping{ false };
+        Device::Request shift = Device::Request::keyDown(VirtualKeyCode::kShiftLeft);
+        queue.execute(shift);
+
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < keys; ++i) {
+            threads.emplace_back([&, i] {
+                const auto period = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(1 / kTimings[i].rate));
+                Device::Request down = Device::Request::keyDown(kKeys[i]), up = Device::Request::keyUp(kKeys[i]);
+                queue.execute(down);
+                auto repeatAt = std::chrono::steady_clock::now() + kTimings[i].delay;
+                while (true) {
+                    std::this_thread::sleep_until(repeatAt - std::chrono::microseconds(resolution));
+                    if (isStopping) break;
+                    queue.execute(up);
+                    std::this_thread::sleep_until(repeatAt);
+                    queue.execute(down);
+                    ++repeats;
+                    repeatAt += period;
+                }
+                queue.execute(up);
+            });
+        }
+        std::this_thread::sleep_for(held);
+        isStopping = true;
+        for (std::thread& thread : threads) thread.join();
+        Device::Request release = Device::Request::keyUp(VirtualKeyCode::kShiftLeft);
+        queue.execute(release);
+        report("per key", repeats, expected, board.getStats().frames - frames, -1, isBoardClear(queue));
+    }
+    return 0;
+}
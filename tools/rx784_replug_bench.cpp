@@ -0,0 +1,87 @@
+// Unplugs and replugs a simulated board under a SupervisedDevice that keeps moving the
+// pointer, then checks that held keys, buttons and axes survived and reports how long
+// each recovery took.
+//
+//     rx784_replug_bench [cycles] [downtime ms]
+//
+// Recovery time runs from the moment the loss is noticed to the held state being back
+// on the board, so it includes the downtime itself.
+#include "../rx784_sim.hpp"
+#include "../rx784_supervise.hpp"
+#include <cstdio>
+
+int main(int argc, char** argv) {
+    using namespace RX784;
+    size_t cycles = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20;
+    std::chrono::milliseconds downtime(argc > 2 ? std::strtol(argv[2], nullptr, 10) : 10);
+
+    SimulatedBoard board;
+    board.setLinkPath("/tmp/rx784-replug-" + std::to_string(getpid()));
+    if (!board.start()) {
+        std::fprintf(stderr, "cannot start a simulated board\n");
+        return 1;
+    }
+
+    SupervisedDevice device;
+    if (device.open("/tmp/rx784-replug-" + std::to_string(getpid())) != Status::kSuccess) {
+        std::fprintf(stderr, "cannot open the simulated board\n");
+        return 1;
+    }
+    device.keyDown(VirtualKeyCode::kShiftLeft);
+    device.keyDown(VirtualKeyCode::kKeyA);
+    device.buttonDown(Button::kLeft);
+    device.initAbsSystem(1920, 1080);
+    device.moveAbs(100, 100);
+
+    std::atomic<bool> isDone(false);
+    std::thread replugger([&] {
+        for (size_t i = 0; i < cycles; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            board.stop();
+            std::this_thread::sleep_for(downtime);
+            board.start();
+        }
+        isDone = true;
+    });
+
+    int32_t x = 100, y = 100;
+    uint64_t moves = 0, failedMoves = 0;
+    while (!isDone) {
+        int16_t step = (moves / 256) % 2 ? -1 : 1;
+        if (device.moveRel(step, -step) == Status::kSuccess) {
+            x += step;
+            y -= step;
+        } else {
+            ++failedMoves;
+        }
+        ++moves;
+    }
+    replugger.join();
+
+    ButtonsState buttons{};
+    int16_t boardX = 0, boardY = 0;
+    bool isShift = false, isA = false;
+    device.getKeyState(VirtualKeyCode::kShiftLeft, isShift);
+    device.getKeyState(VirtualKeyCode::kKeyA, isA);
+    device.getButtonsState(buttons);
+    device.getPos(boardX, boardY);
+
+    SupervisedTransport::Stats stats = device.getSupervisionStats();
+    auto ms = [](std::chrono::nanoseconds value) { return value.count() / 1e6; };
+    std::printf("%zu replugs, %lld ms down each, %llu moves (%llu dropped by the motion policy)\n",
+                cycles, static_cast<long long>(downtime.count()),
+                static_cast<unsigned long long>(moves), static_cast<unsigned long long>(failedMoves));
+    std::printf("losses %llu, recoveries %llu, wrong units %llu, replayed %llu, dropped %llu\n",
+                static_cast<unsigned long long>(stats.losses), static_cast<unsigned long long>(stats.recoveries),
+                static_cast<unsigned long long>(stats.wrongUnits), static_cast<unsigned long long>(stats.replayed),
+                static_cast<unsigned long long>(stats.dropped));
+    std::printf("recovery: last %.2f ms, max %.2f ms (%.2f ms beyond the downtime)\n",
+                ms(stats.lastRecovery), ms(stats.maxRecovery), ms(stats.maxRecovery - downtime));
+    std::printf("after the last replug: shift %s, A %s, left button %s, pointer (%d, %d), expected (%d, %d)\n",
+                isShift ? "held" : "released", isA ? "held" : "released", buttons.left ? "held" : "released",
+                boardX, boardY, saturateInt16(x), saturateInt16(y));
+
+    bool isRestored = isShift && isA && buttons.left && boardX == saturateInt16(x) && boardY == saturateInt16(y);
+    std::printf("%s\n", isRestored ? "state restored" : "STATE LOST");
+    return isRestored ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+// Simplifies a synthetic 1000 Hz recording, hand-jittered strokes with pauses between
+// them, at several tolerances, offline and streaming, then plays the recording and the
+// offline segments against a simulated board on a VirtualClock.
+//
+//     rx784_simplify_bench [-n <strokes>] [-r <polling rate>] [-s <seed>]
+//
+// Deviation is what the fit reports, with the timing tolerance applied; sync is the
+// largest distance of a recorded point from the segments at exactly its own time.
+// Frames are the moveRel packets each playback sent.
+#include "../rx784_clock.hpp"
+#include "../rx784_simplify.hpp"
+#include "../rx784_sim.hpp"
+#include <cstdio>
+
+namespace {
+    using namespace RX784;
+
+    std::vector<MotionStep> record(size_t strokes, uint64_t seed) {
+        auto next = [&](int32_t range) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            return static_cast<int32_t>((seed >> 33) % static_cast<uint64_t>(range));
+        };
+
+        std::vector<MotionStep> steps;
+        int32_t atX = 0, atY = 0, lastX = 0, lastY = 0;
+        uint64_t time = 0;
+        for (size_t stroke = 0; stroke < strokes; ++stroke) {
+            int32_t x = next(1200) - 600 - atX / 2, y = next(800) - 400 - atY / 2;
+            uint32_t duration = 300 + static_cast<uint32_t>(next(600));
+            LinearPath path = { 0.3 + next(30) / 100.0, 0, 0.7, 1, next(60) / 100.0, next(60) / 100.0, 0.8, 0.9 };
+            PathSampler sampler(x, y, duration, 1000, path);
+
+            for (uint32_t tick = 1; tick <= sampler.ticks(); ++tick) {
+                int32_t posX, posY;
+                sampler.at(tick, posX, posY);
+                int32_t jitteredX = atX + posX + next(3) - 1, jitteredY = atY + posY + next(3) - 1;
+                uint64_t stamp = time + tick * 1000 + static_cast<uint64_t>(next(200));
+                if (jitteredX != lastX || jitteredY != lastY) {
+                    steps.push_back({ static_cast<int16_t>(jitteredX - lastX), static_cast<int16_t>(jitteredY - lastY), stamp });
+                    lastX = jitteredX;
+                    lastY = jitteredY;
+                }
+            }
+            atX += x;
+            atY += y;
+            time += static_cast<uint64_t>(duration) * 1000 + 50000 + static_cast<uint64_t>(next(250)) * 1000;
+        }
+        return steps;
+    }
+
+    // Largest distance of a recorded point from the segments at its own time.
+    double syncError(const std::vector<MotionStep>& steps, const std::vector<MotionSegment>& segments) {
+        double worst = 0;
+        int32_t x = 0, y = 0, fromX = 0, fromY = 0;
+        uint64_t from = 0;
+        size_t segment = 0;
+        for (const MotionStep& step : steps) {
+            x += step.x;
+            y += step.y;
+            while (segment + 1 < segments.size() && step.time > (from + segments[segment].duration) * 1000 + 500) {
+                fromX += segments[segment].x;
+                fromY += segments[segment].y;
+                from += segments[segment].duration;
+                ++segment;
+            }
+            const MotionSegment& current = segments[segment];
+            double progress = current.duration != 0
+                ? std::max(0.0, std::min(1.0, (step.time / 1000.0 - from) / current.duration)) : 1;
+            worst = std::max(worst, std::hypot(x - (fromX + current.x * progress), y - (fromY + current.y * progress)));
+        }
+        return worst;
+    }
+
+    struct Playback {
+        uint64_t frames;
+        bool isExact;
+    };
+
+    template <typename Play>
+    Playback play(SimulatedBoard& board, Device& device, int32_t totalX, int32_t totalY, Play&& body) {
+        VirtualClock clock;
+        clock.attach();
+        device.setClock(clock);
+        device.setPos(960, 540);
+        int16_t startX, startY, endX, endY, w;
+        board.getAxes(startX, startY, w);
+        uint64_t frames = board.getStats().frames;
+
+        body(clock);
+
+        board.getAxes(endX, endY, w);
+        device.setClock(steadyClock());
+        clock.detach();
+        return { board.getStats().frames - frames, endX - startX == totalX && endY - startY == totalY };
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t strokes = 40;
+    uint32_t pollingRate = 250;
+    uint64_t seed = 3;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        const char* value = argv[i + 1];
+        if (option == "-n") strokes = std::strtoul(value, nullptr, 10);
+        else if (option == "-r") pollingRate = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (option == "-s") seed = std::strtoull(value, nullptr, 10);
+    }
+
+    SimulatedBoard board;
+    Device device;
+    if (!board.start() || device.open(board.portName()) != Status::kSuccess) {
+        std::fprintf(stderr, "cannot start a simulated board\n");
+        return 1;
+    }
+    device.initAbsSystem(1920, 1080);
+
+    std::vector<MotionStep> steps = record(strokes, seed);
+    int32_t totalX = 0, totalY = 0;
+    for (const MotionStep& step : steps) {
+        totalX += step.x;
+        totalY += step.y;
+    }
+
+    Playback raw = play(board, device, totalX, totalY, [&](Clock& clock) {
+        Clock::time_point start = clock.now();
+        for (const MotionStep& step : steps) {
+            clock.sleepUntil(start + std::chrono::microseconds(step.time));
+            device.moveRel(step.x, step.y);
+        }
+    });
+    std::printf("%zu strokes, %zu steps over %.1f s; played as recorded: %llu frames, %s\n\n", strokes, steps.size(),
+                steps.empty() ? 0.0 : steps.back().time / 1e6, static_cast<unsigned long long>(raw.frames),
+                raw.isExact ? "exact" : "NOT exact");
+
+    std::printf("%-13s  %-9s  %8s  %7s  %9s  %7s  %8s  %s\n",
+                "tolerance", "fit", "segments", "ratio", "deviation", "sync", "frames", "exact");
+    const SimplifyTolerance tolerances[] = { { 0.5, 0 }, { 1, 2000 }, { 2, 4000 }, { 4, 8000 } };
+    for (const SimplifyTolerance& tolerance : tolerances) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%.1f px %u ms", tolerance.pixels, tolerance.time / 1000);
+
+        SimplifyStats stats;
+        std::vector<MotionSegment> segments = MotionSimplifier::simplify(steps.data(), steps.size(), tolerance, &stats);
+        Playback played = play(board, device, totalX, totalY, [&](Clock&) {
+            playSegments(device, segments.data(), segments.size(), pollingRate);
+        });
+        std::printf("%-13s  %-9s  %8llu  %6.1fx  %9.2f  %7.2f  %8llu  %s\n", name, "offline",
+                    static_cast<unsigned long long>(stats.segments), stats.ratio(), stats.maxDeviation,
+                    syncError(steps, segments), static_cast<unsigned long long>(played.frames),
+                    played.isExact ? "yes" : "NO");
+
+        MotionSimplifier streaming(tolerance);
+        std::vector<MotionSegment> streamed;
+        MotionSegment segment;
+        for (const MotionStep& step : steps) {
+            if (streaming.push(step, segment)) streamed.push_back(segment);
+        }
+        if (streaming.finish(segment)) streamed.push_back(segment);
+        stats = streaming.getStats();
+        std::printf("%-13s  %-9s  %8llu  %6.1fx  %9.2f  %7.2f\n", "", "streaming",
+                    static_cast<unsigned long long>(stats.segments), stats.ratio(), stats.maxDeviation,
+                    syncError(steps, streamed));
+    }
+    return 0;
+}
@@ -0,0 +1,343 @@
+// Soaks one or more boards with a weighted mix of commands from several producer
+// threads, through a CommandQueue per board, and reports every few seconds so leaks,
+// throughput decay and contention show up while it runs.
+//
+//     rx784_soak [-p <port>]... [-b <simulated boards>] [-t <producers>] [-r <commands/s>]
+//                [-c] [-m <mix>] [-d <seconds>] [-i <report seconds>]
+//
+// Without -p it runs against simulated boards. The mix is a list of command=weight,
+// e.g. "moveRel=70,getPos=10,getKeyboardState=10,scrollRel=10"; key (right shift) and
+// button (button 5) send down and up alternately, and everything is released at the
+// end. Open loop, the default, offers -r commands a second between all producers
+// whatever the boards make of them; a command whose producer has none of its entries
+// free is skipped and counted. -c closes the loop: each producer waits
+// for its command to complete, then for its next slot when -r is set. -d 0 runs until
+// interrupted.
+//
+// Each report gives completions a second, the error rate, latency percentiles from
+// submit to completion over the interval, skipped commands and the resident set.
+#include "../rx784_queue.hpp"
+#include "../rx784_sim.hpp"
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <memory>
+
+namespace {
+    using namespace RX784;
+
+    std::atomic<bool> isInterrupted(false);
+
+    void interrupt(int) { isInterrupted = true; }
+
+    enum class Kind : uint8_t {
+        kMoveRel, kMoveAbs, kScrollRel, kGetPos, kGetAxes, kGetKeyboardState, kGetButtonsState, kKey, kButton
+    };
+
+    const char* const kKindNames[] = {
+        "moveRel", "moveAbs", "scrollRel", "getPos", "getAxes", "getKeyboardState", "getButtonsState", "key", "button"
+    };
+
+    struct Mix {
+        std::vector<Kind> kinds;
+        std::vector<uint32_t> bounds;  // running total of the weights
+    };
+
+    bool parseMix(const std::string& text, Mix& mix) {
+        mix = Mix{};
+        std::stringstream stream(text);
+        std::string item;
+        while (std::getline(stream, item, ',')) {
+            size_t equals = item.find('=');
+            std::string name = item.substr(0, equals);
+            uint32_t weight = equals == std::string::npos ? 1 : static_cast<uint32_t>(std::strtoul(&item[equals + 1], nullptr, 10));
+
+            size_t kind = 0;
+            while (kind < sizeof(kKindNames) / sizeof(kKindNames[0]) && name != kKindNames[kind]) ++kind;
+            if (kind == sizeof(kKindNames) / sizeof(kKindNames[0])) return false;
+            if (weight == 0) continue;
+            mix.kinds.push_back(static_cast<Kind>(kind));
+            mix.bounds.push_back((mix.bounds.empty() ? 0 : mix.bounds.back()) + weight);
+        }
+        return !mix.kinds.empty();
+    }
+
+    struct Counters {
+        std::atomic<uint64_t> completed{ 0 };
+        std::atomic<uint64_t> errors{ 0 };
+        std::atomic<uint64_t> skipped{ 0 };
+    };
+
+    struct Slot {
+        CommandQueue::Entry entry;
+        Counters* counters;
+        std::atomic<bool> isBusy;
+    };
+
+    void count(Counters& counters, const CommandQueue::Entry& entry) {
+        bool isFailed = entry.status != Status::kSuccess ||
+                        (entry.request.responseSize == 1 && entry.request.result() != Status::kSuccess);
+        if (isFailed) ++counters.errors;
+        ++counters.completed;
+    }
+
+    void complete(CommandQueue::Entry& entry) {
+        Slot& slot = *static_cast<Slot*>(entry.context);
+        count(*slot.counters, entry);
+        slot.isBusy.store(false, std::memory_order_release);
+    }
+
+    struct Options {
+        std::vector<std::string> ports;
+        size_t boards = 1;
+        size_t producers = 4;
+        double rate = 2000;
+        bool isClosedLoop = false;
+        Mix mix;
+        double seconds = 60;
+        double interval = 5;
+    };
+
+    class Producer {
+    public:
+        static constexpr size_t kSlots = 256;
+
+        Producer(const Options& options, std::vector<std::unique_ptr<CommandQueue>>& queues, size_t index)
+            : options(options), queues(queues), index(index), seed(index * 2654435761u + 1), isKeyDown(false),
+              isButtonDown(false), slots(kSlots),
+              thread(&Producer::run, this) {}
+
+        ~Producer() { join(); }
+
+        // Returns once the producer has stopped and everything it submitted has completed.
+        void join() {
+            if (thread.joinable()) thread.join();
+        }
+
+        Counters counters;
+
+    private:
+        const Options& options;
+        std::vector<std::unique_ptr<CommandQueue>>& queues;
+        size_t index;
+        uint64_t seed;
+        bool isKeyDown;
+        bool isButtonDown;
+        std::vector<Slot> slots;
+        std::thread thread;
+
+        Device::Request pick(uint64_t serial) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            uint32_t roll = static_cast<uint32_t>((seed >> 33) % options.mix.bounds.back());
+            size_t i = 0;
+            while (roll >= options.mix.bounds[i]) ++i;
+
+            int16_t sign = serial % 2 ? -1 : 1;
+            switch (options.mix.kinds[i])
+            {
+            case Kind::kMoveRel:          return Device::Request::moveRel(sign, 0);
+            case Kind::kMoveAbs:          return Device::Request::moveAbs(static_cast<int16_t>(960 + sign), 540);
+            case Kind::kScrollRel:        return Device::Request::scrollRel(sign);
+            case Kind::kGetPos:           return Device::Request::getPos();
+            case Kind::kGetAxes:          return Device::Request::getAxes();
+            case Kind::kGetKeyboardState: return Device::Request::getKeyboardState();
+            case Kind::kGetButtonsState:  return Device::Request::getButtonsState();
+            case Kind::kKey:
+                isKeyDown = !isKeyDown;
+                return isKeyDown ? Device::Request::keyDown(VirtualKeyCode::kShiftRight) : Device::Request::keyUp(VirtualKeyCode::kShiftRight);
+            case Kind::kButton:
+            default:
+                isButtonDown = !isButtonDown;
+                return isButtonDown ? Device::Request::buttonDown(Button::kButton5) : Device::Request::buttonUp(Button::kButton5);
+            }
+        }
+
+        void run() {
+            auto period = std::chrono::duration<double>(options.producers / std::max(options.rate, 1e-9));
+            auto begin = std::chrono::steady_clock::now() +
+                         std::chrono::duration_cast<std::chrono::steady_clock::duration>(period * index / options.producers);
+            auto end = std::chrono::steady_clock::now() +
+                       std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.seconds));
+            bool isPaced = !options.isClosedLoop || options.rate > 0;
+            size_t cursor = 0;
+
+            for (uint64_t serial = 0; !isInterrupted; ++serial) {
+                auto due = begin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(period * serial);
+                if (options.seconds > 0 && (isPaced ? due : std::chrono::steady_clock::now()) >= end) break;
+                if (isPaced) std::this_thread::sleep_until(due);
+
+                CommandQueue& queue = *queues[(serial + index) % queues.size()];
+                if (options.isClosedLoop) {
+                    CommandQueue::Entry entry{};
+                    entry.request = pick(serial);
+                    entry.status = queue.execute(entry.request);
+                    count(counters, entry);
+                    continue;
+                }
+
+                // Slots mostly complete in order, so the search starts after the last one taken.
+                size_t free = 0;
+                while (free < kSlots && slots[(cursor + free) % kSlots].isBusy.load(std::memory_order_acquire)) ++free;
+                if (free == kSlots) {
+                    ++counters.skipped;
+                    continue;
+                }
+                Slot& slot = slots[(cursor + free) % kSlots];
+                cursor = (cursor + free + 1) % kSlots;
+                slot.isBusy.store(true, std::memory_order_relaxed);
+                slot.counters = &counters;
+                slot.entry.request = pick(serial);
+                slot.entry.context = &slot;
+                slot.entry.onComplete = complete;
+                queue.submit(slot.entry);
+            }
+
+            for (Slot& slot : slots) {
+                while (slot.isBusy.load(std::memory_order_acquire)) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    };
+
+    double residentMegabytes() {
+        long pages = 0, resident = 0;
+        FILE* file = std::fopen("/proc/self/statm", "r");
+        if (!file) return 0;
+        if (std::fscanf(file, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        std::fclose(file);
+        return resident * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1 << 20);
+    }
+
+    struct Totals {
+        uint64_t completed;
+        uint64_t errors;
+        uint64_t skipped;
+    };
+
+    Totals sum(const std::vector<std::unique_ptr<Producer>>& producers) {
+        Totals totals{};
+        for (const auto& producer : producers) {
+            totals.completed += producer->counters.completed;
+            totals.errors += producer->counters.errors;
+            totals.skipped += producer->counters.skipped;
+        }
+        return totals;
+    }
+
+    void report(double at, double seconds, const Totals& now, const Totals& before, const LatencyHistogram& latency) {
+        uint64_t completed = now.completed - before.completed, errors = now.errors - before.errors;
+        std::printf("%8.1f  %9.0f  %7.3f%%  %8.1f  %8.1f  %8.1f  %9.1f  %8llu  %8.1f\n", at, completed / seconds,
+                    completed != 0 ? 100.0 * errors / completed : 0.0,
+                    latency.percentile(0.5).count() / 1e3, latency.percentile(0.99).count() / 1e3,
+                    latency.percentile(0.999).count() / 1e3, latency.maximum().count() / 1e3,
+                    static_cast<unsigned long long>(now.skipped - before.skipped), residentMegabytes());
+        std::fflush(stdout);
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    parseMix("moveRel=70,getPos=10,getKeyboardState=10,scrollRel=10", options.mix);
+
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "-c") { options.isClosedLoop = true; continue; }
+        if (i + 1 >= argc) break;
+        const char* value = argv[++i];
+        if (option == "-p") options.ports.push_back(value);
+        else if (option == "-b") options.boards = std::max<size_t>(1, std::strtoul(value, nullptr, 10));
+        else if (option == "-t") options.producers = std::max<size_t>(1, std::strtoul(value, nullptr, 10));
+        else if (option == "-r") options.rate = std::strtod(value, nullptr);
+        else if (option == "-d") options.seconds = std::strtod(value, nullptr);
+        else if (option == "-i") options.interval = std::max(0.1, std::strtod(value, nullptr));
+        else if (option == "-m" && !parseMix(value, options.mix)) {
+            std::fprintf(stderr, "bad mix: %s\n", value);
+            return 1;
+        }
+    }
+    if (!options.isClosedLoop && options.rate <= 0) {
+        std::fprintf(stderr, "open loop needs a rate\n");
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<SimulatedBoard>> boards;
+    if (options.ports.empty()) {
+        for (size_t i = 0; i < options.boards; ++i) {
+            boards.emplace_back(new SimulatedBoard());
+            if (!boards.back()->start()) {
+                std::fprintf(stderr, "cannot start a simulated board\n");
+                return 1;
+            }
+            options.ports.push_back(boards.back()->portName());
+        }
+    }
+
+    std::vector<std::unique_ptr<Device>> devices;
+    std::vector<std::unique_ptr<CommandQueue>> queues;
+    for (const std::string& port : options.ports) {
+        devices.emplace_back(new Device());
+        if (devices.back()->open(port) != Status::kSuccess) {
+            std::fprintf(stderr, "cannot open %s\n", port.c_str());
+            return 1;
+        }
+        devices.back()->initAbsSystem(1920, 1080);
+        queues.emplace_back(new CommandQueue(*devices.back()));
+    }
+
+    std::signal(SIGINT, interrupt);
+    std::printf("%zu board%s, %zu producer%s, %s", queues.size(), queues.size() == 1 ? "" : "s",
+                options.producers, options.producers == 1 ? "" : "s", options.isClosedLoop ? "closed loop" : "open loop");
+    if (options.rate > 0) std::printf(" at %.0f/s", options.rate);
+    std::printf(", mix");
+    for (size_t i = 0; i < options.mix.kinds.size(); ++i) {
+        std::printf("%s%s=%u", i == 0 ? " " : ",", kKindNames[static_cast<size_t>(options.mix.kinds[i])],
+                    options.mix.bounds[i] - (i == 0 ? 0 : options.mix.bounds[i - 1]));
+    }
+    std::printf("\n\n%8s  %9s  %8s  %8s  %8s  %8s  %9s  %8s  %8s\n",
+                "s", "done/s", "errors", "p50 us", "p99 us", "p99.9 us", "max us", "skipped", "RSS MB");
+
+    using Seconds = std::chrono::duration<double>;
+    auto start = std::chrono::steady_clock::now(), last = start;
+    std::vector<std::unique_ptr<Producer>> producers;
+    for (size_t i = 0; i < options.producers; ++i) producers.emplace_back(new Producer(options, queues, i));
+
+    LatencyHistogram overall;
+    Totals before{};
+    double rssStart = residentMegabytes();
+    for (bool isRunning = true; isRunning; ) {
+        auto deadline = last + std::chrono::duration_cast<std::chrono::steady_clock::duration>(Seconds(options.interval));
+        while (isRunning && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            isRunning = !isInterrupted && (options.seconds <= 0 || std::chrono::steady_clock::now() - start < Seconds(options.seconds));
+        }
+        if (!isRunning) {
+            for (auto& producer : producers) producer->join();
+            for (auto& queue : queues) {
+                Device::Request keys = Device::Request::releaseAllKeys(), buttons = Device::Request::releaseAllButtons();
+                queue->execute(keys);
+                queue->execute(buttons);
+            }
+        }
+
+        LatencyHistogram latency;
+        for (auto& queue : queues) {
+            latency.merge(queue->latencyHistogram());
+            queue->resetLatencyHistogram();
+        }
+        overall.merge(latency);
+
+        auto now = std::chrono::steady_clock::now();
+        Totals totals = sum(producers);
+        report(Seconds(now - start).count(), Seconds(now - last).count(), totals, before, latency);
+        before = totals;
+        last = now;
+    }
+
+    double elapsed = Seconds(last - start).count();
+    std::printf("\n%llu commands in %.1f s, %.0f/s, %llu errors, %llu skipped; p50 %.1f us, p99 %.1f us, "
+                "p99.9 %.1f us, max %.1f us; RSS %.1f -> %.1f MB\n",
+                static_cast<unsigned long long>(before.completed), elapsed, before.completed / elapsed,
+                static_cast<unsigned long long>(before.errors), static_cast<unsigned long long>(before.skipped),
+                overall.percentile(0.5).count() / 1e3, overall.percentile(0.99).count() / 1e3,
+                overall.percentile(0.999).count() / 1e3, overall.maximum().count() / 1e3, rssStart, residentMegabytes());
+    return before.errors == 0 ? 0 : 2;
+}
@@ -0,0 +1,95 @@
+// Prints a wire trace written by RX784::Tracer.
+//
+//     rx784_trace <trace file>
+#include "../rx784_trace.hpp"
+#include <cinttypes>
+#include <iostream>
+
+static const char* commandName(uint8_t cmd) {
+    switch (cmd)
+    {
+    case 1:   return "Reboot";
+    case 11:  return "KeyDown";
+    case 12:  return "KeyUp";
+    case 13:  return "ReleaseAllKeys";
+    case 14:  return "GetKeyState";
+    case 15:  return "GetKeyboardLEDsState";
+    case 16:  return "GetKeyboardState";
+    case 17:  return "SendKeyboardState";
+    case 31:  return "ButtonDown";
+    case 32:  return "ButtonUp";
+    case 33:  return "ReleaseAllButtons";
+    case 34:  return "GetButtonsState";
+    case 51:  return "MoveRel";
+    case 52:  return "ScrollRel";
+    case 53:  return "GetRelMouseState";
+    case 54:  return "SendRelMouseState";
+    case 71:  return "InitAbsSystem";
+    case 72:  return "MoveAbs";
+    case 73:  return "ScrollAbs";
+    case 74:  return "GetPos";
+    case 75:  return "SetPos";
+    case 76:  return "GetWheelAxis";
+    case 77:  return "SetWheelAxis";
+    case 78:  return "GetAxes";
+    case 79:  return "SetAxes";
+    case 80:  return "GetAbsMouseState";
+    case 81:  return "SendAbsMouseState";
+    case 91:  return "GetVendorID";
+    case 92:  return "GetProductID";
+    case 93:  return "GetVersionNumber";
+    case 94:  return "GetManufacturerString";
+    case 95:  return "GetProductString";
+    case 111: return "ConfigVendorID";
+    case 112: return "ConfigProductID";
+    case 113: return "ConfigVersionNumber";
+    case 114: return "ConfigManufacturerString";
+    case 115: return "ConfigProductString";
+    case 131: return "GetDeviceID";
+    case 132: return "GetDeviceSerialNumber";
+    case 133: return "GetFirmwareVersion";
+    default:  return "?";
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::cerr << "usage: rx784_trace <trace file>\n";
+        return 2;
+    }
+
+    FILE* file = std::fopen(argv[1], "rb");
+    if (!file) {
+        std::cerr << "cannot open " << argv[1] << "\n";
+        return 1;
+    }
+
+    RX784::Tracer::FileHeader header;
+    if (std::fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, "RX784TRC", 8) != 0 || header.version != 1) {
+        std::cerr << argv[1] << " is not an RX784 trace\n";
+        return 1;
+    }
+    std::printf("# start %" PRIu64 " ns since the Unix epoch, up to %u bytes per frame\n",
+                header.startTime, header.captureSize);
+
+    RX784::Tracer::RecordHeader record;
+    uint8_t frame[256];
+    uint64_t count = 0;
+    while (std::fread(&record, sizeof(record), 1, file) == 1) {
+        if (std::fread(frame, 1, record.capturedSize, file) != record.capturedSize) break;
+
+        std::printf("%14.6f ms  ch%-3u %s %-24s %3u B%s%s ",
+                    record.timestamp / 1e6, record.channel,
+                    record.direction == RX784::Tracer::Direction::kSend ? ">>" : "<<",
+                    commandName(record.cmd), record.frameSize,
+                    record.flags & RX784::Tracer::kFailed ? " FAILED" : "",
+                    record.flags & RX784::Tracer::kTruncated ? " TRUNCATED" : "");
+        for (uint8_t i = 0; i < record.capturedSize; ++i) std::printf(" %02X", frame[i]);
+        std::printf("\n");
+        ++count;
+    }
+
+    std::printf("# %" PRIu64 " frames\n", count);
+    std::fclose(file);
+    return 0;
+}
@@ -0,0 +1,128 @@
+// Compares the io_uring transport against the plain read/write backend on simulated
+// boards: one thread per board runs moveRel/getPos exchanges over each backend in turn.
+//
+//     rx784_uring_bench [boards] [exchanges per board]
+//
+// Reports wall time per exchange, CPU time and context switches per exchange, and the
+// read/write syscalls counted by /proc/self/task/<tid>/io (io_uring_enter is not counted
+// there, so it is listed separately).
+#include "../rx784_sim.hpp"
+#include "../rx784_uring.hpp"
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+namespace {
+    struct Sample {
+        double cpuSeconds = 0;
+        uint64_t contextSwitches = 0;
+        uint64_t syscalls = 0;
+        uint64_t enters = 0;
+        uint64_t failures = 0;
+    };
+
+    struct Usage {
+        double cpuSeconds;
+        uint64_t contextSwitches;
+        uint64_t syscalls;
+    };
+
+    Usage threadUsage() {
+        rusage usage{};
+        getrusage(RUSAGE_THREAD, &usage);
+
+        uint64_t syscalls = 0;
+        std::ifstream io("/proc/self/task/" + std::to_string(syscall(SYS_gettid)) + "/io");
+        std::string key;
+        uint64_t value;
+        while (io >> key >> value) {
+            if (key == "syscr:" || key == "syscw:") syscalls += value;
+        }
+
+        return { usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6,
+                 static_cast<uint64_t>(usage.ru_nvcsw + usage.ru_nivcsw), syscalls };
+    }
+
+    void exchange(RX784::Device& device, size_t count, Sample& sample) {
+        int16_t x, y;
+        Usage before = threadUsage();
+        for (size_t i = 0; i < count; ++i) {
+            if (device.moveRel(1, -1) != RX784::Status::kSuccess) ++sample.failures;
+            if (device.getPos(x, y) != RX784::Status::kSuccess) ++sample.failures;
+        }
+        Usage after = threadUsage();
+        sample.cpuSeconds = after.cpuSeconds - before.cpuSeconds;
+        sample.contextSwitches = after.contextSwitches - before.contextSwitches;
+        sample.syscalls = after.syscalls - before.syscalls;
+    }
+
+    void runPlain(const std::string& port, size_t count, Sample& sample) {
+        RX784::Device device;
+        if (device.open(port) != RX784::Status::kSuccess) {
+            sample.failures = count * 2;
+            return;
+        }
+        exchange(device, count, sample);
+        device.close();
+    }
+
+    void runUring(const std::string& port, size_t count, Sample& sample) {
+        RX784::UringTransport link;
+        RX784::Device device;
+        if (link.open(port) != RX784::Status::kSuccess || device.open(link) != RX784::Status::kSuccess) {
+            sample.failures = count * 2;
+            return;
+        }
+        exchange(device, count, sample);
+        sample.enters = link.getStats().enters;
+        device.close();
+    }
+}
+
+int main(int argc, char** argv) {
+    using Clock = std::chrono::steady_clock;
+    size_t boardCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 8;
+    size_t count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000;
+
+    std::vector<std::unique_ptr<RX784::SimulatedBoard>> boards;
+    for (size_t i = 0; i < boardCount; ++i) {
+        boards.emplace_back(new RX784::SimulatedBoard);
+        if (!boards.back()->start()) {
+            std::fprintf(stderr, "cannot start simulated board %zu\n", i);
+            return 1;
+        }
+    }
+
+    std::printf("%zu boards, %zu exchanges each (one exchange = moveRel + getPos)\n\n", boardCount, count);
+    std::printf("%-10s  %12s  %12s  %12s  %14s  %12s  %8s\n",
+                "backend", "wall us/ex", "cpu us/ex", "csw/ex", "read+write/ex", "enters/ex", "failures");
+
+    for (int isUring = 0; isUring < 2; ++isUring) {
+        std::vector<Sample> samples(boardCount);
+        std::vector<std::thread> threads;
+
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < boardCount; ++i) {
+            threads.emplace_back(isUring ? runUring : runPlain, boards[i]->portName(), count, std::ref(samples[i]));
+        }
+        for (std::thread& thread : threads) thread.join();
+        double wall = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+        Sample total;
+        for (const Sample& sample : samples) {
+            total.cpuSeconds += sample.cpuSeconds;
+            total.contextSwitches += sample.contextSwitches;
+            total.syscalls += sample.syscalls;
+            total.enters += sample.enters;
+            total.failures += sample.failures;
+        }
+        double exchanges = static_cast<double>(boardCount * count);
+        std::printf("%-10s  %12.2f  %12.2f  %12.2f  %14.2f  %12.2f  %8llu\n",
+                    isUring ? "io_uring" : "read/write", wall / count, total.cpuSeconds * 1e6 / exchanges,
+                    total.contextSwitches / exchanges, total.syscalls / exchanges, total.enters / exchanges,
+                    static_cast<unsigned long long>(total.failures));
+    }
+    return 0;
+}
@@ -0,0 +1,350 @@
+// Owns RX784 boards so that several local processes can drive them at once through
+// RX784::ClientDevice (rx784_ipc.hpp). Linux only.
+//
+//     rx784d [-s <socket path>] [-p <spin microseconds>]
+//
+// A port is opened when its first client connects and closed after its last one leaves.
+// Requests from every client of a port meet in that port's CommandQueue, so a release
+// from one process still overtakes motion queued by another.
+#include "../rx784_ipc.hpp"
+#include "../rx784_queue.hpp"
+#include <csignal>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+namespace {
+    using namespace RX784;
+    using Clock = std::chrono::steady_clock;
+
+    volatile std::sig_atomic_t isStopping = 0;
+
+    struct Port {
+        Device device;
+        std::unique_ptr<CommandQueue> queue;
+        size_t clientCount = 0;
+    };
+
+    struct Client {
+        int socket = -1;
+        int doorbell = -1;
+        SharedRing* ring = nullptr;
+        std::map<std::string, Port>::iterator port;
+        bool hasPort = false;
+        bool isClosing = false;
+        std::atomic<bool> isFaulted{false};  // overran its completion ring
+        std::atomic<uint32_t> inFlight{0};
+        CommandQueue::Entry entries[SharedRing::kCapacity];
+        std::atomic<bool> isBusy[SharedRing::kCapacity] = {};  // entry is in the port queue
+    };
+
+    class Daemon {
+    public:
+        Daemon(int listener, std::chrono::microseconds spin)
+            : listener(listener), epoll(epoll_create1(EPOLL_CLOEXEC)), spin(spin) {
+            watch(listener);
+        }
+
+        void run() {
+            Clock::time_point lastWork = Clock::now();
+            uint32_t iteration = 0;
+
+            while (!isStopping) {
+                bool isBusy = pump();
+                reap();
+
+                // Busy or still inside the spin budget: keep polling the rings and look
+                // at the sockets only now and then.
+                if (isBusy || Clock::now() - lastWork < spin) {
+                    if (isBusy) lastWork = Clock::now();
+                    if (++iteration % 1024 == 0) dispatch(0);
+                    continue;
+                }
+
+                setIdle(1);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (!pump()) dispatch(hasClosingClients() ? 1 : -1);
+                setIdle(0);
+                lastWork = Clock::now();
+            }
+        }
+
+    private:
+        int listener;
+        int epoll;
+        std::chrono::microseconds spin;
+        std::map<std::string, Port> ports;
+        std::vector<std::unique_ptr<Client>> clients;
+
+        void watch(int fd) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+        }
+
+        void setIdle(uint32_t isIdle) {
+            for (auto& client : clients) {
+                if (client->ring) client->ring->isDaemonIdle.store(isIdle, std::memory_order_relaxed);
+            }
+        }
+
+        bool hasClosingClients() const {
+            for (auto& client : clients) if (client->isClosing) return true;
+            return false;
+        }
+
+        void dispatch(int timeout) {
+            epoll_event events[32];
+            int count = epoll_wait(epoll, events, 32, timeout);
+
+            for (int i = 0; i < count; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == listener) {
+                    accept();
+                    continue;
+                }
+
+                Client* client = findBySocket(fd);
+                if (client) {
+                    if (!client->hasPort) open(*client);
+                    else disconnect(*client);  // clients never talk after setup
+                    continue;
+                }
+
+                uint64_t value;
+                while (::read(fd, &value, sizeof(value)) == sizeof(value)) {}
+            }
+        }
+
+        Client* findBySocket(int fd) {
+            for (auto& client : clients) if (client->socket == fd && !client->isClosing) return client.get();
+            return nullptr;
+        }
+
+        void accept() {
+            int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) return;
+
+            clients.emplace_back(new Client);
+            clients.back()->socket = fd;
+            watch(fd);
+        }
+
+        void open(Client& client) {
+            DaemonOpenRequest request{};
+            DaemonOpenReply reply{ kDaemonProtocolVersion, Status::kSerialError };
+
+            if (::recv(client.socket, &request, sizeof(request), 0) != sizeof(request) ||
+                request.version != kDaemonProtocolVersion) {
+                disconnect(client);
+                return;
+            }
+            request.port[sizeof(request.port) - 1] = '\0';
+
+            auto port = ports.find(request.port);
+            if (port == ports.end()) {
+                port = ports.emplace(std::piecewise_construct, std::forward_as_tuple(request.port), std::forward_as_tuple()).first;
+                reply.status = port->second.device.open(request.port);
+                if (reply.status != Status::kSuccess) {
+                    ports.erase(port);
+                    ::send(client.socket, &reply, sizeof(reply), MSG_NOSIGNAL);
+                    disconnect(client);
+                    return;
+                }
+                port->second.queue.reset(new CommandQueue(port->second.device));
+            }
+            ++port->second.clientCount;
+            client.port = port;
+            client.hasPort = true;
+
+            int memory = memfd_create("rx784-ring", MFD_CLOEXEC);
+            void* mapping = MAP_FAILED;
+            if (memory >= 0 && ftruncate(memory, sizeof(SharedRing)) == 0) {
+                mapping = mmap(nullptr, sizeof(SharedRing), PROT_READ | PROT_WRITE, MAP_SHARED, memory, 0);
+            }
+            client.doorbell = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+            if (mapping != MAP_FAILED && client.doorbell >= 0) {
+                client.ring = new (mapping) SharedRing();
+                reply.status = Status::kSuccess;
+            }
+
+            int fds[2] = { memory, client.doorbell };
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+            iovec iov = { &reply, sizeof(reply) };
+            msghdr message{};
+            message.msg_iov = &iov;
+            message.msg_iovlen = 1;
+            if (reply.status == Status::kSuccess) {
+                message.msg_control = control;
+                message.msg_controllen = sizeof(control);
+                cmsghdr* header = CMSG_FIRSTHDR(&message);
+                header->cmsg_level = SOL_SOCKET;
+                header->cmsg_type = SCM_RIGHTS;
+                header->cmsg_len = CMSG_LEN(sizeof(fds));
+                memcpy(CMSG_DATA(header), fds, sizeof(fds));
+            }
+
+            bool isSent = sendmsg(client.socket, &message, MSG_NOSIGNAL) == sizeof(reply);
+            if (memory >= 0) ::close(memory);
+            if (mapping != MAP_FAILED && !client.ring) munmap(mapping, sizeof(SharedRing));
+
+            if (!isSent || reply.status != Status::kSuccess) {
+                disconnect(client);
+                return;
+            }
+            watch(client.doorbell);
+        }
+
+        void disconnect(Client& client) {
+            if (client.isClosing) return;
+            client.isClosing = true;
+            epoll_ctl(epoll, EPOLL_CTL_DEL, client.socket, nullptr);
+            if (client.doorbell >= 0) epoll_ctl(epoll, EPOLL_CTL_DEL, client.doorbell, nullptr);
+        }
+
+        static void complete(CommandQueue::Entry& entry) {
+            Client& client = *static_cast<Client*>(entry.context);
+            SharedRing& ring = *client.ring;
+
+            uint32_t slot = static_cast<uint32_t>(&entry - client.entries);
+            uint32_t head = ring.completeHead.load(std::memory_order_relaxed);
+
+            // A client that submits past completions it has not taken yet has no room left
+            // for this one; drop it and let the dispatcher disconnect the client.
+            if (head - ring.completeTail.load(std::memory_order_acquire) >= SharedRing::kCapacity) {
+                client.isFaulted.store(true, std::memory_order_relaxed);
+                uint64_t one = 1;
+                (void)::write(client.doorbell, &one, sizeof(one));
+            } else {
+                SharedRing::Completion& completion = ring.completions[head % SharedRing::kCapacity];
+                completion.slot = slot;
+                completion.status = entry.status;
+                completion.request = entry.request;
+                ring.completeHead.store(head + 1, std::memory_order_release);
+
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (ring.isClientWaiting.load(std::memory_order_relaxed)) futexWake(ring.completeHead);
+            }
+            client.isBusy[slot].store(false, std::memory_order_release);
+
+            // Last touch: once this drops to zero the dispatcher may free the client.
+            client.inFlight.fetch_sub(1, std::memory_order_release);
+        }
+
+        // Moves new submissions from every ring into the port queues.
+        bool pump() {
+            bool isBusy = false;
+
+            for (auto& pointer : clients) {
+                Client& client = *pointer;
+                if (client.isClosing || !client.ring) continue;
+                if (client.isFaulted.load(std::memory_order_relaxed)) {
+                    disconnect(client);
+                    continue;
+                }
+
+                SharedRing& ring = *client.ring;
+                uint32_t tail = ring.submitTail.load(std::memory_order_relaxed);
+                uint32_t head = ring.submitHead.load(std::memory_order_acquire);
+                if (head == tail) continue;
+                if (head - tail > SharedRing::kCapacity) {
+                    disconnect(client);
+                    continue;
+                }
+
+                CommandQueue& queue = *client.port->second.queue;
+                for (; tail != head; ++tail) {
+                    // A slot comes back only once its earlier entry has completed; a client
+                    // that reuses one sooner would have the queue hold the entry twice.
+                    if (client.isBusy[tail % SharedRing::kCapacity].load(std::memory_order_acquire)) {
+                        disconnect(client);
+                        break;
+                    }
+                    CommandQueue::Entry& entry = client.entries[tail % SharedRing::kCapacity];
+                    const Device::Request& submission = ring.submissions[tail % SharedRing::kCapacity];
+
+                    // The ring is writable by the client, so take nothing but the frame from it.
+                    Device::Request::relay(static_cast<uint8_t>(submission.cmd), submission.data,
+                                           std::min<size_t>(submission.dataSize, sizeof(submission.data)), entry.request);
+                    entry.context = &client;
+                    entry.onComplete = complete;
+                    entry.isPollAligned = false;
+
+                    client.isBusy[tail % SharedRing::kCapacity].store(true, std::memory_order_relaxed);
+                    client.inFlight.fetch_add(1, std::memory_order_relaxed);
+                    queue.submit(entry);
+                }
+                ring.submitTail.store(tail, std::memory_order_release);
+                isBusy = true;
+            }
+            return isBusy;
+        }
+
+        void reap() {
+            for (size_t i = 0; i < clients.size();) {
+                Client& client = *clients[i];
+                if (!client.isClosing || client.inFlight.load(std::memory_order_acquire) != 0) {
+                    ++i;
+                    continue;
+                }
+
+                if (client.ring) munmap(client.ring, sizeof(SharedRing));
+                if (client.doorbell >= 0) ::close(client.doorbell);
+                ::close(client.socket);
+
+                if (client.hasPort && --client.port->second.clientCount == 0) {
+                    client.port->second.queue.reset();
+                    client.port->second.device.close();
+                    ports.erase(client.port);
+                }
+
+                clients[i] = std::move(clients.back());
+                clients.pop_back();
+            }
+        }
+    };
+}
+
+int main(int argc, char** argv) {
+    std::string socketPath = defaultDaemonSocket();
+    long spin = 200;
+
+    for (int i = 1; i < argc; i += 2) {
+        std::string option = argv[i];
+        if (i + 1 == argc || (option != "-s" && option != "-p")) {
+            std::cerr << "usage: rx784d [-s <socket path>] [-p <spin microseconds>]\n";
+            return 2;
+        }
+        if (option == "-s") socketPath = argv[i + 1];
+        else spin = std::strtol(argv[i + 1], nullptr, 10);
+    }
+
+    sockaddr_un address{};
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "socket path too long\n";
+        return 1;
+    }
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, socketPath.data(), socketPath.size());
+
+    int listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    unlink(socketPath.c_str());
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, 16) != 0) {
+        std::cerr << "cannot listen on " << socketPath << "\n";
+        return 1;
+    }
+
+    std::signal(SIGINT,  [](int) { isStopping = 1; });
+    std::signal(SIGTERM, [](int) { isStopping = 1; });
+
+    Daemon daemon(listener, std::chrono::microseconds(spin));
+    daemon.run();
+
+    unlink(socketPath.c_str());
+    return 0;
+}